@@ -0,0 +1,92 @@
+//
+// Helpers shared by the benchmark executables.
+// Header only, include once per executable after the platform headers.
+//
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <pthread.h>
+    #include <time.h>
+#endif
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "io.h"
+
+// Thread running fn(arg), result holds its return value after joining.
+typedef struct bench_thread {
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    int (*fn)(void* arg);
+    void* arg;
+    int result;
+} bench_thread;
+
+#ifdef _WIN32
+static inline DWORD WINAPI bench_thread_main(LPVOID param)
+#else
+static inline void* bench_thread_main(void* param)
+#endif
+{
+    bench_thread* t = (bench_thread*)param;
+    t->result = t->fn(t->arg);
+    TCP_thread_cleanup();
+    return 0;
+}
+
+static inline bool bench_thread_start(bench_thread* t, int (*fn)(void* arg), void* arg)
+{
+    t->fn = fn;
+    t->arg = arg;
+    t->result = -1;
+#ifdef _WIN32
+    t->handle = CreateThread(NULL, 0, bench_thread_main, t, 0, NULL);
+    return t->handle != NULL;
+#else
+    return pthread_create(&t->handle, NULL, bench_thread_main, t) == 0;
+#endif
+}
+
+// returns the thread's result
+static inline int bench_thread_join(bench_thread* t)
+{
+#ifdef _WIN32
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+#else
+    pthread_join(t->handle, NULL);
+#endif
+    return t->result;
+}
+
+static inline double bench_now_sec(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+// qsort comparator for doubles
+static inline int bench_compare_double(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+#endif
@@ -0,0 +1,348 @@
+//
+// Frame stream benchmark.
+// Streams synthetic HD frames over 127.0.0.1 with TCP_send_frame() and
+// reports bytes on the wire and send/receive cost per frame for a few
+// kinds of frame-to-frame change, each against sending every frame whole.
+// Then sends frames as tiles in each order and reports when the first tile
+// and the centre of the frame become visible to the receiver.
+//
+// exe [frames] [keyframe_interval] [port]
+// example: frame_bench 60 30 50100
+//
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <winsock2.h>
+#else
+    #include <poll.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "bench.h"
+
+#define FRAME_W 1920
+#define FRAME_H 1080
+#define FRAME_SIZE (FRAME_W * FRAME_H * 3) // 1 frame at HD
+#define SPRITE 64
+#define TILE_SIZE 64
+
+// How each frame differs from the one before
+#define CHANGE_STATIC 0 // not at all
+#define CHANGE_SPRITE 1 // a 64x64 block moves
+#define CHANGE_REFINE 2 // 10% of pixels, scattered (progressive render pass)
+#define CHANGE_NOISE 3  // every byte
+
+typedef struct server_args {
+    socket_t listensock;
+    int frames;
+    char* frame;     // last frame received, to check against the sender's
+    double recv_sec; // time in TCP_recv_frame() once data is available
+    int order;       // tile order, -1 for whole frames
+    double first_sec, center_sec, last_sec; // tile arrival, sums over frames
+} server_args;
+
+static uint64_t rng = 88172645463325252ull;
+
+static uint64_t xorshift(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static void draw_sprite(char* frame, int x, int y, bool on)
+{
+    for (int row = y; row < y + SPRITE; row++) {
+        char* p = frame + ((size_t)row * FRAME_W + x) * 3;
+        for (int i = 0; i < SPRITE * 3; i++) p[i] = on ? (char)0xff : (char)((row + x * 3 + i) & 0x7f);
+    }
+}
+
+static void next_frame(char* frame, int change, int index)
+{
+    switch (change) {
+    case CHANGE_SPRITE: {
+        int span = FRAME_W - SPRITE;
+        if (index) draw_sprite(frame, ((index - 1) * 8) % span, FRAME_H / 2, false);
+        draw_sprite(frame, (index * 8) % span, FRAME_H / 2, true);
+        break;
+    }
+    case CHANGE_REFINE:
+        for (int i = 0; i < FRAME_W * FRAME_H / 10; i++) {
+            uint64_t r = xorshift();
+            char* p = frame + (r % (FRAME_W * FRAME_H)) * 3;
+            p[0] = (char)(r >> 32);
+            p[1] = (char)(r >> 40);
+            p[2] = (char)(r >> 48);
+        }
+        break;
+    case CHANGE_NOISE:
+        for (size_t i = 0; i + 8 <= FRAME_SIZE; i += 8) {
+            uint64_t r = xorshift();
+            memcpy(frame + i, &r, 8);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Block until socket has data, so the receive timing excludes the sender's frame generation.
+static bool wait_readable(socket_t socket)
+{
+#ifdef _WIN32
+    WSAPOLLFD pfd = { socket, POLLRDNORM, 0 };
+    return WSAPoll(&pfd, 1, -1) == 1;
+#else
+    struct pollfd pfd = { socket, POLLIN, 0 };
+    return poll(&pfd, 1, -1) == 1;
+#endif
+}
+
+// Receive frames, then acknowledge with one byte.
+static int serve(void* arg)
+{
+    server_args* args = (server_args*)arg;
+    socket_t sock = TCP_accept(args->listensock);
+    if (sock == INV_SOCKET) return -1;
+
+    net_frame_stream* stream = TCP_frame_stream_create(FRAME_SIZE, 0);
+    if (!stream) {
+        TCP_close(sock);
+        return -1;
+    }
+    args->recv_sec = 0;
+    for (int i = 0; i < args->frames; i++) {
+        if (!wait_readable(sock)) {
+            TCP_close(sock);
+            TCP_frame_stream_destroy(stream);
+            return -1;
+        }
+        double start = bench_now_sec();
+        if (TCP_recv_frame(sock, stream) != FRAME_SIZE) {
+            TCP_frame_stream_destroy(stream);
+            return -1;
+        }
+        args->recv_sec += bench_now_sec() - start;
+    }
+    memcpy(args->frame, TCP_frame_data(stream), FRAME_SIZE);
+    TCP_frame_stream_destroy(stream);
+
+    char ack = 1;
+    int ret = TCP_send(sock, &ack, 1) == 1 ? 0 : -1;
+    TCP_close(sock);
+    return ret;
+}
+
+// Stream frames with one kind of change to a local server thread.
+static int run(const char* name, int change, int frames, int keyframe_interval, const char* port, char* frame, char* received)
+{
+    net_sockopts opts;
+    TCP_sockopts_preset(&opts, NET_SOCKOPTS_DEFAULT);
+    opts.reuseaddr = true;
+    socket_t listensock = TCP_listen3(port, false, &opts, false);
+    if (listensock == INV_SOCKET) return -1;
+    server_args args = { listensock, frames, received, 0, -1, 0, 0, 0 };
+    bench_thread server;
+    if (!bench_thread_start(&server, serve, &args)) {
+        TCP_close(listensock);
+        return -1;
+    }
+
+    int ret = -1;
+    socket_t sock = TCP_connect("127.0.0.1", port);
+    net_frame_stream* stream = sock != INV_SOCKET ? TCP_frame_stream_create(FRAME_SIZE, keyframe_interval) : NULL;
+    if (stream) {
+        for (int i = 0; i < FRAME_SIZE; i++) frame[i] = (char)((i / 3 % FRAME_W + i / 3 / FRAME_W) & 0x7f);
+        double send_sec = 0;
+        ret = 0;
+        for (int i = 0; i < frames && ret == 0; i++) {
+            next_frame(frame, change, i);
+            double start = bench_now_sec();
+            if (TCP_send_frame(sock, stream, frame) == -1) ret = -1;
+            send_sec += bench_now_sec() - start;
+        }
+        char* ack = NULL;
+        if (ret == 0 && TCP_recv(sock, &ack) != 1) ret = -1;
+        free(ack);
+
+        net_frame_stats stats;
+        TCP_frame_get_stats(stream, &stats);
+        TCP_frame_stream_destroy(stream);
+        TCP_close(sock);
+        if (bench_thread_join(&server) != 0) ret = -1;
+        if (ret == 0 && memcmp(frame, received, FRAME_SIZE) != 0) {
+            fprintf(stderr, "%s: received frame differs!\n", name);
+            ret = -1;
+        }
+        if (ret == 0) {
+            printf("%-12s %10.1f KB/frame %7.2f%% of raw %4llu keyframes %8.2f ms send %8.2f ms recv\n", name,
+                (double)stats.bytes_wire / frames / 1024, 100.0 * stats.bytes_wire / stats.bytes_raw,
+                (unsigned long long)stats.keyframes, send_sec * 1e3 / frames, args.recv_sec * 1e3 / frames);
+        }
+    }
+    else {
+        if (sock != INV_SOCKET) TCP_close(sock);
+        bench_thread_join(&server);
+    }
+    TCP_close(listensock);
+    return ret;
+}
+
+typedef struct tile_times {
+    double first, center;
+} tile_times;
+
+static int on_tile(void* user, const net_tile* tile, const char* frame)
+{
+    (void)frame;
+    tile_times* t = (tile_times*)user;
+    double now = bench_now_sec();
+    if (!tile->index) t->first = now;
+    unsigned cx = tile->frame_width / 2, cy = tile->frame_height / 2;
+    if (cx >= tile->x && cx < tile->x + tile->width && cy >= tile->y && cy < tile->y + tile->height) t->center = now;
+    return 0;
+}
+
+// Receive tiled frames, acknowledging each so the next one starts on an idle connection.
+// Arrival times are relative to the sender's start time sent ahead of each frame.
+static int serve_tiles(void* arg)
+{
+    server_args* args = (server_args*)arg;
+    socket_t sock = TCP_accept(args->listensock);
+    if (sock == INV_SOCKET) return -1;
+
+    net_buffer frame, start;
+    net_buffer_init(&frame);
+    net_buffer_init(&start);
+    int ret = 0;
+    args->first_sec = args->center_sec = args->last_sec = 0;
+    for (int i = 0; i < args->frames && ret == 0; i++) {
+        tile_times t = { 0, 0 };
+        double sent;
+        if (TCP_recv_buffer(sock, &start) != sizeof(sent)) {
+            ret = -1;
+            break;
+        }
+        if (args->order < 0) {
+            // nothing to show before the last byte
+            if (TCP_recv_buffer(sock, &frame) != FRAME_SIZE) {
+                ret = -1;
+                break;
+            }
+            t.first = t.center = bench_now_sec();
+        }
+        else if (TCP_recv_tiles(sock, &frame, on_tile, &t) != FRAME_SIZE) {
+            ret = -1;
+            break;
+        }
+        memcpy(&sent, start.data, sizeof(sent));
+        args->first_sec += t.first - sent;
+        args->center_sec += t.center - sent;
+        args->last_sec += bench_now_sec() - sent;
+        char ack = 1;
+        if (TCP_send(sock, &ack, 1) != 1) ret = -1;
+    }
+    if (ret == 0) memcpy(args->frame, frame.data, FRAME_SIZE);
+    net_buffer_free(&frame);
+    net_buffer_free(&start);
+    if (ret == 0) TCP_close(sock);
+    return ret;
+}
+
+// Send frames as tiles in one order, or whole with TCP_send() (order -1) for comparison.
+static int run_tiles(const char* name, int order, int frames, const char* port, char* frame, char* received)
+{
+    net_sockopts opts;
+    TCP_sockopts_preset(&opts, NET_SOCKOPTS_DEFAULT);
+    opts.reuseaddr = true;
+    socket_t listensock = TCP_listen3(port, false, &opts, false);
+    if (listensock == INV_SOCKET) return -1;
+    server_args args = { listensock, frames, received, 0, order, 0, 0, 0 };
+    bench_thread server;
+    if (!bench_thread_start(&server, serve_tiles, &args)) {
+        TCP_close(listensock);
+        return -1;
+    }
+
+    int ret = -1;
+    socket_t sock = TCP_connect("127.0.0.1", port);
+    if (sock != INV_SOCKET) {
+        for (int i = 0; i < FRAME_SIZE; i++) frame[i] = (char)((i / 3 % FRAME_W + i / 3 / FRAME_W) & 0x7f);
+        ret = 0;
+        char* ack = NULL;
+        for (int i = 0; i < frames && ret == 0; i++) {
+            next_frame(frame, CHANGE_SPRITE, i);
+            double start = bench_now_sec();
+            if (TCP_send(sock, (const char*)&start, sizeof(start)) != sizeof(start)) ret = -1;
+            else if (order < 0) {
+                if (TCP_send(sock, frame, FRAME_SIZE) != FRAME_SIZE) ret = -1;
+            }
+            else if (TCP_send_tiles(sock, frame, FRAME_W, FRAME_H, 3, TILE_SIZE, order) != FRAME_SIZE) ret = -1;
+            if (ret == 0 && TCP_recv(sock, &ack) != 1) ret = -1;
+            free(ack);
+            ack = NULL;
+        }
+        TCP_close(sock);
+    }
+    if (bench_thread_join(&server) != 0) ret = -1;
+    TCP_close(listensock);
+    if (ret == 0 && memcmp(frame, received, FRAME_SIZE) != 0) {
+        fprintf(stderr, "%s: received frame differs!\n", name);
+        ret = -1;
+    }
+    if (ret == 0) {
+        printf("%-12s %8.3f ms first tile %8.3f ms centre %8.3f ms whole frame\n", name,
+            args.first_sec * 1e3 / frames, args.center_sec * 1e3 / frames, args.last_sec * 1e3 / frames);
+    }
+    return ret;
+}
+
+int main(int argc, char* argv[])
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 60;
+    int keyframe_interval = argc > 2 ? atoi(argv[2]) : 30;
+    const char* port = argc > 3 ? argv[3] : "50100";
+    if (frames <= 0 || keyframe_interval < 0) {
+        fprintf(stderr, "invalid arguments!\n");
+        return 1;
+    }
+
+#ifdef _WIN32
+    if (TCP_win32_init() != 0) {
+        fprintf(stderr, "Windows initialize function failed!\n");
+        return 1;
+    }
+#endif
+
+    char* frame = (char*)malloc(FRAME_SIZE);
+    char* received = (char*)malloc(FRAME_SIZE);
+    if (!frame || !received) return 1;
+
+    printf("%d frames of %d bytes over loopback, keyframe every %d, per frame averages\n", frames, FRAME_SIZE,
+        keyframe_interval);
+    int ret = 0;
+    ret |= run("static", CHANGE_STATIC, frames, keyframe_interval, port, frame, received);
+    ret |= run("sprite", CHANGE_SPRITE, frames, keyframe_interval, port, frame, received);
+    ret |= run("refine 10%", CHANGE_REFINE, frames, keyframe_interval, port, frame, received);
+    ret |= run("noise", CHANGE_NOISE, frames, keyframe_interval, port, frame, received);
+    // every frame whole, what TCP_send() costs
+    ret |= run("keyframes", CHANGE_SPRITE, frames, 1, port, frame, received);
+
+    printf("\n%d frames as %dx%d tiles, time from send start to display\n", frames, TILE_SIZE, TILE_SIZE);
+    ret |= run_tiles("whole", -1, frames, port, frame, received);
+    ret |= run_tiles("row-major", NET_TILES_ROW_MAJOR, frames, port, frame, received);
+    ret |= run_tiles("centre-out", NET_TILES_CENTER_OUT, frames, port, frame, received);
+    ret |= run_tiles("morton", NET_TILES_MORTON, frames, port, frame, received);
+
+    free(frame);
+    free(received);
+    if (ret != 0) fprintf(stderr, "benchmark failed!\n");
+    return ret != 0;
+}
@@ -0,0 +1,566 @@
+//
+// Image writer benchmark.
+// Renders a procedural corpus of raytracer-like frames and times on each
+//   bmp    write_bmp()
+//   stb    stb_image_write's PNG writer at a few compression levels (it
+//          deflates through the STBIW_ZLIB_COMPRESS hook, see io_deflate.c)
+//   png    write_png_ex(), the parallel encoder, at the same levels on
+//          -t threads (0 for one per core), once more on one thread (png1),
+//          once with the scalar row filters (png-c) and with the fast and
+//          rle deflate tiers (png-fast, png-rle)
+//   sky    smooth gradient with a sun glow, compresses well
+//   noisy  shaded spheres with per-pixel sampling noise, as early path tracing passes
+//   flat   flat-shaded test scene: checker floor and solid shapes
+// at 720p, 1080p and 4K, RGB and RGBA. Reports MB/s of raw pixels, bytes
+// per pixel on disk, and the split of a PNG write into filtering, deflate
+// (Adler-32 included) and CRC: for stb timed on a staged copy of its encoder
+// that is checked to produce the same bytes, for png as the encoder reports
+// it (summed over threads).
+// Before timing, every filter instruction set the CPU supports encodes a
+// set of odd-sized frames and must produce the same bytes as the scalar one,
+// and the CRC-32 and Adler-32 kernels must match byte-at-a-time loops.
+// With -j the results are also written as JSON, one per line, to diff
+// between releases; -m skips frames taller than max_height.
+//
+// exe [-j file.json] [-m max_height] [-n repeats] [-o dir] [-t threads]
+// example: image_bench -j image_bench.json -m 1080
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "bench.h"
+#include "stb_image_write.h"
+
+// Defined by the io library's copy of stb_image_write, not declared in its header part.
+unsigned char* stbi_write_png_to_mem(const unsigned char* pixels, int stride_bytes, int x, int y, int n, int* out_len);
+unsigned char* stbi_zlib_compress(unsigned char* data, int data_len, int* out_len, int quality);
+
+#define KIND_SKY 0
+#define KIND_NOISY 1
+#define KIND_FLAT 2
+
+static const char* kind_names[] = { "sky", "noisy", "flat" };
+
+static const int png_levels[] = { 5, 8, 16 }; // stb hash chain length, 8 is its default
+#define PNG_DEFAULT_LEVEL 8
+
+typedef struct corpus_frame {
+    int kind;
+    int width, height, channels;
+    unsigned char* pixels;
+} corpus_frame;
+
+typedef struct png_split {
+    double filter_sec, deflate_sec, crc_sec;
+    bool identical; // staged output equals stbi_write_png_to_mem()
+} png_split;
+
+static uint64_t rng;
+
+static uint32_t xorshift(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (uint32_t)(rng >> 32);
+}
+
+static unsigned char clamp_byte(double v)
+{
+    return v <= 0 ? 0 : v >= 255 ? 255 : (unsigned char)v;
+}
+
+// Diffuse-lit spheres of a flat-shaded or noisy frame, 0 if (x, y) misses.
+// returns the shade in 0..1 and the sphere index in *hit
+static double spheres(double x, double y, int* hit)
+{
+    static const double sx[] = { 0.3, 0.55, 0.78 }, sy[] = { 0.55, 0.45, 0.6 }, sr[] = { 0.16, 0.12, 0.09 };
+    for (int i = 0; i < 3; i++) {
+        double dx = (x - sx[i]) / sr[i], dy = (y - sy[i]) / sr[i];
+        double d2 = dx * dx + dy * dy;
+        if (d2 >= 1) continue;
+        double dz = 1 - d2; // light from the upper left, facing the camera
+        *hit = i;
+        double shade = -0.4 * dx - 0.5 * dy + 0.75 * dz;
+        return shade < 0.08 ? 0.08 : shade;
+    }
+    *hit = -1;
+    return 0;
+}
+
+static void render(corpus_frame* f)
+{
+    static const double palette[3][3] = { { 220, 60, 50 }, { 60, 180, 90 }, { 70, 110, 230 } };
+    rng = 88172645463325252ull + f->kind;
+    int w = f->width, h = f->height, n = f->channels;
+    for (int y = 0; y < h; y++) {
+        unsigned char* row = f->pixels + (size_t)y * w * n;
+        double v = (double)y / h;
+        for (int x = 0; x < w; x++) {
+            double u = (double)x / w, c[3];
+            // sky shared by all kinds: horizon to zenith, warmer around the sun
+            double sun = (u - 0.8) * (u - 0.8) + (v - 0.15) * (v - 0.15);
+            double glow = sun < 0.05 ? (0.05 - sun) * 20 : 0;
+            c[0] = 60 + 150 * v + 60 * glow;
+            c[1] = 110 + 110 * v + 40 * glow;
+            c[2] = 210 + 40 * v;
+            if (f->kind != KIND_SKY) {
+                int hit;
+                double shade = spheres(u, v, &hit);
+                if (hit >= 0) {
+                    for (int k = 0; k < 3; k++) {
+                        c[k] = f->kind == KIND_FLAT ? palette[hit][k] : palette[hit][k] * shade;
+                    }
+                }
+                else if (v > 0.62) {
+                    // checker floor
+                    bool odd = ((int)(u * 16) + (int)((v - 0.62) * 24)) & 1;
+                    c[0] = c[1] = c[2] = odd ? 200 : 90;
+                }
+                if (f->kind == KIND_NOISY) {
+                    // one sample per pixel worth of noise
+                    double noise = (double)(xorshift() & 63) - 32;
+                    for (int k = 0; k < 3; k++) c[k] += noise;
+                }
+            }
+            unsigned char* p = row + (size_t)x * n;
+            for (int k = 0; k < 3; k++) p[k] = clamp_byte(c[k]);
+            if (n == 4) p[3] = 255;
+        }
+    }
+}
+
+static long file_size(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) return -1;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+static uint32_t crc_table[256];
+
+static void crc_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        crc_table[i] = c;
+    }
+}
+
+// byte-at-a-time CRC, as stb's own
+static uint32_t crc32_bytes(const unsigned char* p, size_t len)
+{
+    uint32_t crc = ~0u;
+    for (size_t i = 0; i < len; i++) crc = (crc >> 8) ^ crc_table[(p[i] ^ crc) & 0xff];
+    return ~crc;
+}
+
+// byte-at-a-time Adler-32, as stb's own
+static uint32_t adler32_bytes(const unsigned char* p, size_t len)
+{
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < len; i++) {
+        a = (a + p[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return a | (b << 16);
+}
+
+static unsigned char paeth(int a, int b, int c)
+{
+    int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return (unsigned char)a;
+    if (pb <= pc) return (unsigned char)b;
+    return (unsigned char)c;
+}
+
+// Filter row y with PNG filter type into out, as stbiw__encode_png_line().
+static void filter_row(const unsigned char* pixels, int w, int y, int n, int type, signed char* out)
+{
+    int len = w * n;
+    const unsigned char* z = pixels + (size_t)y * len;
+    const unsigned char* up = z - len;
+    if (y == 0 && (type == 2 || type == 4)) type = type == 2 ? 0 : 6; // no row above
+    if (y == 0 && type == 3) type = 5;
+    int i;
+    switch (type) {
+    case 0: memcpy(out, z, len); return;
+    case 1: for (i = 0; i < n; i++) out[i] = z[i]; for (; i < len; i++) out[i] = z[i] - z[i - n]; return;
+    case 2: for (i = 0; i < len; i++) out[i] = z[i] - up[i]; return;
+    case 3:
+        for (i = 0; i < n; i++) out[i] = z[i] - (up[i] >> 1);
+        for (; i < len; i++) out[i] = z[i] - ((z[i - n] + up[i]) >> 1);
+        return;
+    case 4:
+        for (i = 0; i < n; i++) out[i] = (signed char)(z[i] - paeth(0, up[i], 0));
+        for (; i < len; i++) out[i] = z[i] - paeth(z[i - n], up[i], up[i - n]);
+        return;
+    case 5: for (i = 0; i < n; i++) out[i] = z[i]; for (; i < len; i++) out[i] = z[i] - (z[i - n] >> 1); return;
+    case 6: for (i = 0; i < n; i++) out[i] = z[i]; for (; i < len; i++) out[i] = z[i] - paeth(z[i - n], 0, 0); return;
+    }
+}
+
+static unsigned char* put_be32(unsigned char* o, uint32_t v)
+{
+    o[0] = (unsigned char)(v >> 24);
+    o[1] = (unsigned char)(v >> 16);
+    o[2] = (unsigned char)(v >> 8);
+    o[3] = (unsigned char)v;
+    return o + 4;
+}
+
+// Encode like stbi_write_png_to_mem() one stage at a time, timing each.
+// returns the PNG (free()), NULL on failure
+static unsigned char* png_staged(const corpus_frame* f, int level, int* out_len, png_split* split)
+{
+    int w = f->width, h = f->height, n = f->channels, len = w * n;
+    unsigned char* filt = (unsigned char*)malloc((size_t)(len + 1) * h);
+    signed char* line = (signed char*)malloc(len);
+    if (!filt || !line) {
+        free(filt);
+        free(line);
+        return NULL;
+    }
+
+    double start = bench_now_sec();
+    for (int y = 0; y < h; y++) {
+        // pick the filter with the smallest sum of absolute values
+        int best = 0, best_est = 0x7fffffff, type;
+        for (type = 0; type < 5; type++) {
+            filter_row(f->pixels, w, y, n, type, line);
+            int est = 0;
+            for (int i = 0; i < len; i++) est += abs(line[i]);
+            if (est < best_est) {
+                best_est = est;
+                best = type;
+            }
+        }
+        if (best != 4) filter_row(f->pixels, w, y, n, best, line);
+        filt[(size_t)y * (len + 1)] = (unsigned char)best;
+        memcpy(filt + (size_t)y * (len + 1) + 1, line, len);
+    }
+    free(line);
+    double filtered = bench_now_sec();
+
+    int zlen;
+    unsigned char* zlib = stbi_zlib_compress(filt, (len + 1) * h, &zlen, level);
+    free(filt);
+    if (!zlib) return NULL;
+    double deflated = bench_now_sec();
+
+    static const unsigned char sig[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    static const int ctype[5] = { -1, 0, 4, 2, 6 };
+    *out_len = 8 + 12 + 13 + 12 + zlen + 12;
+    unsigned char* out = (unsigned char*)malloc(*out_len);
+    if (!out) {
+        free(zlib);
+        return NULL;
+    }
+    unsigned char* o = out;
+    memcpy(o, sig, 8);
+    o = put_be32(o + 8, 13);
+    memcpy(o, "IHDR", 4);
+    o = put_be32(o + 4, w);
+    o = put_be32(o, h);
+    o[0] = 8;
+    o[1] = (unsigned char)ctype[n];
+    o[2] = o[3] = o[4] = 0;
+    o += 5;
+    double crc_sec = 0;
+    double t = bench_now_sec();
+    o = put_be32(o, TCP_crc32(0, o - 17, 17));
+    crc_sec += bench_now_sec() - t;
+    o = put_be32(o, zlen);
+    memcpy(o, "IDAT", 4);
+    memcpy(o + 4, zlib, zlen);
+    free(zlib);
+    o += 4 + zlen;
+    t = bench_now_sec();
+    o = put_be32(o, TCP_crc32(0, o - zlen - 4, zlen + 4));
+    crc_sec += bench_now_sec() - t;
+    o = put_be32(o, 0);
+    memcpy(o, "IEND", 4);
+    put_be32(o + 4, TCP_crc32(0, o, 4));
+
+    split->filter_sec = filtered - start;
+    split->deflate_sec = deflated - filtered;
+    split->crc_sec = crc_sec;
+    return out;
+}
+
+typedef struct bench_result {
+    const char* writer; // "bmp", "stb", "png", "png1", "png-c", "png-fast", "png-rle"
+    int level;          // png only
+    int threads;        // png only
+    double sec;         // best of repeats
+    long bytes;
+    png_stats stats;    // png only, of the best run
+} bench_result;
+
+// Time one writer into path, best of repeats.
+static int time_write(const corpus_frame* f, const char* path, const char* writer, int level, int threads,
+    int repeats, bench_result* r)
+{
+    bool stb = !strcmp(writer, "stb"), png = !strncmp(writer, "png", 3);
+    int simd = !strcmp(writer, "png-c") ? PNG_SIMD_SCALAR : PNG_SIMD_AUTO;
+    int deflate = !strcmp(writer, "png-fast") ? PNG_DEFLATE_FAST
+        : !strcmp(writer, "png-rle")          ? PNG_DEFLATE_RLE
+                                              : PNG_DEFLATE_LAZY;
+    memset(r, 0, sizeof(*r));
+    r->writer = writer;
+    r->level = stb || png ? level : 0;
+    for (int i = 0; i < repeats; i++) {
+        png_stats stats;
+        png_options options = { .threads = threads, .level = level, .stats = &stats, .simd = simd, .deflate = deflate };
+        if (stb) stbi_write_png_compression_level = level;
+        double start = bench_now_sec();
+        bool ok = stb ? stbi_write_png(path, f->width, f->height, f->channels, f->pixels, 0)
+                : png ? write_png_ex(path, f->pixels, f->width, f->height, f->channels, &options)
+                      : write_bmp(path, f->pixels, f->width, f->height, f->channels);
+        double sec = bench_now_sec() - start;
+        if (!ok) return -1;
+        if (i == 0 || sec < r->sec) {
+            r->sec = sec;
+            if (png) {
+                r->stats = stats;
+                r->threads = stats.threads;
+            }
+        }
+    }
+    stbi_write_png_compression_level = PNG_DEFAULT_LEVEL;
+    r->bytes = file_size(path);
+    remove(path);
+    return r->bytes < 0 ? -1 : 0;
+}
+
+// Encode odd-sized noise and gradient frames with every supported filter
+// instruction set, byte for byte against the scalar kernels.
+// returns 0, -1 on a mismatch
+static int check_simd(void)
+{
+    static const int widths[] = { 1, 2, 3, 5, 7, 11, 15, 16, 17, 31, 32, 33, 63, 65, 127, 250 };
+    static const char* names[] = { "auto", "scalar", "sse2", "avx2", "neon" };
+    int ret = 0;
+    printf("filter kernels:");
+    for (int simd = PNG_SIMD_SCALAR; simd <= PNG_SIMD_NEON; simd++) {
+        if (png_simd_supported(simd)) printf(" %s", names[simd]);
+    }
+    rng = 2463534242ull;
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        for (int n = 1; n <= 4; n++) {
+            for (int noise = 0; noise <= 1; noise++) {
+                int width = widths[w], height = 2 + (int)(w % 7);
+                unsigned char* pixels = (unsigned char*)malloc((size_t)width * height * n);
+                if (!pixels) return -1;
+                for (int i = 0; i < width * height * n; i++) {
+                    // a gradient picks different filters than noise does
+                    uint32_t r = xorshift();
+                    pixels[i] = noise ? (unsigned char)r : (unsigned char)(i / n * 3 + (r & 3));
+                }
+                png_options options = { .threads = 1, .simd = PNG_SIMD_SCALAR };
+                size_t ref_len, len;
+                unsigned char* ref = encode_png(pixels, width, height, n, &options, &ref_len);
+                for (int simd = PNG_SIMD_SSE2; simd <= PNG_SIMD_NEON && ref; simd++) {
+                    if (!png_simd_supported(simd)) continue;
+                    options.simd = simd;
+                    unsigned char* png = encode_png(pixels, width, height, n, &options, &len);
+                    if (!png || len != ref_len || memcmp(png, ref, len)) {
+                        fprintf(stderr, "%s filters differ from scalar at %dx%dx%d!\n", names[simd], width, height, n);
+                        ret = -1;
+                    }
+                    free(png);
+                }
+                if (!ref) ret = -1;
+                free(ref);
+                free(pixels);
+            }
+        }
+    }
+    printf(ret == 0 ? ", identical\n\n" : ", MISMATCH\n\n");
+    return ret;
+}
+
+// The checksum kernels against the byte-at-a-time loops on odd lengths and
+// offsets, then their speed on 16 MiB.
+static int check_checksums(void)
+{
+    static const size_t lens[] = { 0, 1, 3, 15, 16, 17, 63, 64, 65, 100, 1000, 5552, 5553, 65537 };
+    size_t big = 16 << 20;
+    unsigned char* buf = (unsigned char*)malloc(big);
+    if (!buf) return -1;
+    rng = 88172645463325252ull;
+    for (size_t i = 0; i < big; i++) buf[i] = i < big / 2 ? (unsigned char)xorshift() : 0xff; // 0xff: largest sums
+    int ret = 0;
+    for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+        for (size_t offset = 0; offset < 4; offset++) {
+            for (int half = 0; half <= 1; half++) {
+                const unsigned char* p = buf + offset + half * big / 2;
+                if (TCP_crc32(0, p, lens[l]) != crc32_bytes(p, lens[l]) ||
+                    TCP_adler32(1, p, lens[l]) != adler32_bytes(p, lens[l])) {
+                    fprintf(stderr, "checksums differ at %zu bytes, offset %zu!\n", lens[l], offset);
+                    ret = -1;
+                }
+            }
+        }
+    }
+
+    double t[5];
+    t[0] = bench_now_sec();
+    volatile uint32_t sink = TCP_crc32(0, buf, big); // keeps the reference loops
+    t[1] = bench_now_sec();
+    sink ^= crc32_bytes(buf, big);
+    t[2] = bench_now_sec();
+    sink ^= TCP_adler32(1, buf, big);
+    t[3] = bench_now_sec();
+    sink ^= adler32_bytes(buf, big);
+    t[4] = bench_now_sec();
+    free(buf);
+    const char *crc, *adler;
+    TCP_checksum_kernels(&crc, &adler);
+    printf("checksum kernels: crc32 %s %.2f GB/s (bytewise %.2f), adler32 %s %.2f GB/s (bytewise %.2f)%s\n",
+        crc, big / (t[1] - t[0]) / 1e9, big / (t[2] - t[1]) / 1e9, adler, big / (t[3] - t[2]) / 1e9,
+        big / (t[4] - t[3]) / 1e9, ret == 0 ? ", identical" : ", MISMATCH");
+    return ret;
+}
+
+static void frame_label(const corpus_frame* f, char* label, size_t size)
+{
+    snprintf(label, size, "%s %dx%dx%d", kind_names[f->kind], f->width, f->height, f->channels);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* json_path = NULL;
+    const char* dir = ".";
+    int max_height = 2160, repeats = 1, threads = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-j")) json_path = argv[i + 1];
+        else if (!strcmp(argv[i], "-m")) max_height = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-n")) repeats = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-o")) dir = argv[i + 1];
+        else if (!strcmp(argv[i], "-t")) threads = atoi(argv[i + 1]);
+        else max_height = 0;
+    }
+    if (max_height <= 0 || repeats <= 0 || threads < 0 || argc % 2 == 0) {
+        fprintf(stderr, "invalid arguments!\n");
+        return 1;
+    }
+
+    static const int sizes[][2] = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+    char bmp_path[512], png_path[512];
+    snprintf(bmp_path, sizeof(bmp_path), "%s/image_bench.tmp.bmp", dir);
+    snprintf(png_path, sizeof(png_path), "%s/image_bench.tmp.png", dir);
+    crc_init();
+
+    FILE* json = NULL;
+    if (json_path) {
+        json = fopen(json_path, "w");
+        if (!json) {
+            fprintf(stderr, "cannot open %s!\n", json_path);
+            return 1;
+        }
+        fprintf(json, "{\n  \"benchmark\": \"image_bench\",\n  \"version\": 2,\n  \"repeats\": %d,\n  \"cases\": [\n",
+            repeats);
+    }
+
+    int ret = check_checksums();
+    if (check_simd() != 0) ret = -1;
+    printf("%-24s %-8s %5s %7s %10s %8s %8s %8s %8s %8s\n", "frame", "writer", "level", "threads", "MB/s", "B/pixel",
+        "ms", "filter", "deflate", "crc");
+    bool first = true;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        if (sizes[s][1] > max_height) continue;
+        for (int kind = KIND_SKY; kind <= KIND_FLAT; kind++) {
+            for (int channels = 3; channels <= 4; channels++) {
+                corpus_frame f = { kind, sizes[s][0], sizes[s][1], channels, NULL };
+                size_t raw = (size_t)f.width * f.height * f.channels;
+                f.pixels = (unsigned char*)malloc(raw);
+                if (!f.pixels) return 1;
+                render(&f);
+                char label[64];
+                frame_label(&f, label, sizeof(label));
+
+                bench_result results[5 + 2 * sizeof(png_levels) / sizeof(png_levels[0])];
+                int count = 0;
+                if (time_write(&f, bmp_path, "bmp", 0, 0, repeats, &results[count++]) == -1) ret = -1;
+                for (size_t l = 0; l < sizeof(png_levels) / sizeof(png_levels[0]); l++) {
+                    if (time_write(&f, png_path, "stb", png_levels[l], 0, repeats, &results[count++]) == -1) ret = -1;
+                }
+                for (size_t l = 0; l < sizeof(png_levels) / sizeof(png_levels[0]); l++) {
+                    if (time_write(&f, png_path, "png", png_levels[l], threads, repeats, &results[count++]) == -1) {
+                        ret = -1;
+                    }
+                }
+                if (time_write(&f, png_path, "png1", PNG_DEFAULT_LEVEL, 1, repeats, &results[count++]) == -1) ret = -1;
+                static const char* variants[] = { "png-c", "png-fast", "png-rle" };
+                for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+                    if (time_write(&f, png_path, variants[v], PNG_DEFAULT_LEVEL, threads, repeats, &results[count++])
+                        == -1) {
+                        ret = -1;
+                    }
+                }
+
+                // stage split at the default level, checked against the library's output
+                png_split split;
+                memset(&split, 0, sizeof(split));
+                int staged_len = 0, stb_len = 0;
+                unsigned char* staged = png_staged(&f, PNG_DEFAULT_LEVEL, &staged_len, &split);
+                unsigned char* stb = stbi_write_png_to_mem(f.pixels, 0, f.width, f.height, f.channels, &stb_len);
+                split.identical = staged && stb && staged_len == stb_len && !memcmp(staged, stb, stb_len);
+                if (!split.identical) {
+                    fprintf(stderr, "%s: staged PNG differs from stb!\n", label);
+                    ret = -1;
+                }
+                free(staged);
+                free(stb);
+
+                for (int i = 0; i < count; i++) {
+                    const bench_result* r = &results[i];
+                    bool with_split = !strncmp(r->writer, "png", 3)
+                        || (!strcmp(r->writer, "stb") && r->level == PNG_DEFAULT_LEVEL);
+                    png_split own = split;
+                    if (strcmp(r->writer, "stb")) {
+                        own.filter_sec = r->stats.filter_sec;
+                        own.deflate_sec = r->stats.deflate_sec;
+                        own.crc_sec = r->stats.crc_sec;
+                    }
+                    double mbs = raw / r->sec / 1e6, bpp = (double)r->bytes / ((double)f.width * f.height);
+                    printf("%-24s %-8s %5d %7d %10.1f %8.3f %8.1f", label, r->writer, r->level, r->threads, mbs, bpp,
+                        r->sec * 1e3);
+                    if (with_split) {
+                        printf(" %8.1f %8.1f %8.1f", own.filter_sec * 1e3, own.deflate_sec * 1e3,
+                            own.crc_sec * 1e3);
+                    }
+                    printf("\n");
+                    if (!json) continue;
+                    fprintf(json,
+                        "%s    {\"kind\": \"%s\", \"width\": %d, \"height\": %d, \"channels\": %d, \"writer\": \"%s\", "
+                        "\"level\": %d, \"threads\": %d, \"mb_per_s\": %.1f, \"bytes_per_pixel\": %.4f, \"ms\": %.2f",
+                        first ? "" : ",\n", kind_names[f.kind], f.width, f.height, f.channels, r->writer, r->level,
+                        r->threads, mbs, bpp, r->sec * 1e3);
+                    if (with_split) {
+                        fprintf(json, ", \"filter_ms\": %.2f, \"deflate_ms\": %.2f, \"crc_ms\": %.2f",
+                            own.filter_sec * 1e3, own.deflate_sec * 1e3, own.crc_sec * 1e3);
+                    }
+                    fprintf(json, "}");
+                    first = false;
+                }
+                free(f.pixels);
+            }
+        }
+    }
+
+    if (json) {
+        fprintf(json, "\n  ]\n}\n");
+        fclose(json);
+    }
+    if (ret != 0) fprintf(stderr, "benchmark failed!\n");
+    return ret != 0;
+}
@@ -0,0 +1,321 @@
+//
+// Loopback network benchmark suite.
+// Runs TCP_send() / TCP_recv_buffer() over 127.0.0.1 against a server thread:
+//   sizes     ping-pong and streaming from 16 B to 64 MiB, HD/4K frames included
+//   backends  HD frame stream per transport backend
+//   presets   64 B ping-pong and HD frame stream per socket option preset
+//   checksum  HD frame stream with payload CRC-32s (TCP_set_checksum())
+// Every case reports payload MB/s (both directions for ping-pong), p50/p99
+// latency (round trip for ping-pong, one TCP_send() call for streaming) and
+// syscalls per message, counted on both ends.
+// With -j the cases are also written as JSON, one per line, to diff between
+// releases; -s scales the message counts (e.g. 0.1 for a quick run).
+//
+// exe [-j file.json] [-s scale] [port]
+// example: io_bench -j io_bench.json 50100
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "bench.h"
+
+#define HD_FRAME 6220800 // 1920x1080 RGB
+#define PING_SIZE 64
+
+// bytes per case before scaling, bounding the message count
+#define STREAM_BYTES (512u << 20)
+#define PINGPONG_BYTES (128u << 20)
+#define MIN_MESSAGES 8
+#define MAX_MESSAGES 20000
+
+#define MAX_CASES 64
+
+#define PATTERN_PINGPONG 0
+#define PATTERN_STREAM 1
+
+static const char* pattern_names[] = { "pingpong", "stream" };
+
+typedef struct bench_case {
+    const char* section;
+    const char* name;  // backend or preset
+    int backend;       // NET_BACKEND_*
+    bool fixed;        // register both buffers with io_uring
+    int preset;        // NET_SOCKOPTS_*
+    int pattern;       // PATTERN_*
+    size_t size;
+    int count;         // messages
+    bool checksum;     // TCP_set_checksum() on both ends
+} bench_case;
+
+typedef struct bench_result {
+    double mb_per_s;
+    double msgs_per_s;
+    double p50_us;
+    double p99_us;
+    double syscalls_per_msg;
+} bench_result;
+
+typedef struct server_args {
+    socket_t listensock;
+    const bench_case* c;
+    const net_sockopts* opts;
+} server_args;
+
+// Echo or drain the case's messages, acknowledging a stream with one byte.
+static int serve(void* arg)
+{
+    server_args* args = (server_args*)arg;
+    const bench_case* c = args->c;
+    socket_t sock = TCP_accept3(args->listensock, args->opts, false);
+    if (sock == INV_SOCKET) return -1;
+
+    net_buffer buf;
+    net_buffer_init(&buf);
+    if (!net_buffer_reserve(&buf, c->size)) {
+        TCP_close(sock);
+        return -1;
+    }
+    if (c->fixed) {
+        net_iovec iov = { buf.data, buf.capacity };
+        TCP_register_buffers(&iov, 1);
+    }
+
+    int ret = 0;
+    for (int i = 0; i < c->count && ret == 0; i++) {
+        if (TCP_recv_buffer(sock, &buf) != (int)c->size) ret = -1;
+        else if (c->pattern == PATTERN_PINGPONG && TCP_send(sock, buf.data, (unsigned)c->size) != (int)c->size) ret = -1;
+    }
+    char ack = 1;
+    if (ret == 0 && c->pattern == PATTERN_STREAM && TCP_send(sock, &ack, 1) != 1) ret = -1;
+
+    if (c->fixed) TCP_unregister_buffers();
+    TCP_close(sock);
+    net_buffer_free(&buf);
+    return ret;
+}
+
+// Run one case against a fresh server thread and connection.
+// returns 0, 1 if the backend is unavailable, -1 on failure
+static int run(const bench_case* c, const char* port, char* data, bench_result* result)
+{
+    if (!TCP_set_backend(c->backend)) return 1;
+    TCP_set_checksum(c->checksum);
+
+    net_sockopts opts;
+    TCP_sockopts_preset(&opts, c->preset);
+    net_sockopts listen_opts = opts;
+    listen_opts.reuseaddr = true;
+    socket_t listensock = TCP_listen3(port, false, &listen_opts, false);
+    if (listensock == INV_SOCKET) {
+        TCP_set_backend(NET_BACKEND_SOCKETS);
+        return -1;
+    }
+    server_args args = { listensock, c, &opts };
+    bench_thread server;
+    if (!bench_thread_start(&server, serve, &args)) {
+        TCP_close(listensock);
+        TCP_set_backend(NET_BACKEND_SOCKETS);
+        return -1;
+    }
+
+    double* lat = (double*)malloc(c->count * sizeof(double));
+    net_buffer buf;
+    net_buffer_init(&buf);
+    socket_t sock = TCP_connect3("127.0.0.1", port, &opts, false);
+    int ret = sock == INV_SOCKET || !lat || !net_buffer_reserve(&buf, c->size) ? -1 : 0;
+    if (ret == 0 && c->fixed) {
+        net_iovec iov = { data, c->size };
+        TCP_register_buffers(&iov, 1);
+    }
+
+    uint64_t syscalls = TCP_syscall_count();
+    double start = bench_now_sec();
+    for (int i = 0; i < c->count && ret == 0; i++) {
+        double t = bench_now_sec();
+        if (TCP_send(sock, data, (unsigned)c->size) != (int)c->size) ret = -1;
+        else if (c->pattern == PATTERN_PINGPONG && TCP_recv_buffer(sock, &buf) != (int)c->size) ret = -1;
+        lat[i] = (bench_now_sec() - t) * 1e6;
+    }
+    if (ret == 0 && c->pattern == PATTERN_STREAM && TCP_recv_buffer(sock, &buf) != 1) ret = -1;
+    double elapsed = bench_now_sec() - start;
+    syscalls = TCP_syscall_count() - syscalls;
+
+    if (c->fixed && sock != INV_SOCKET) TCP_unregister_buffers();
+    if (sock != INV_SOCKET) TCP_close(sock);
+    if (bench_thread_join(&server) != 0) ret = -1;
+    TCP_close(listensock);
+    TCP_set_backend(NET_BACKEND_SOCKETS);
+    net_buffer_free(&buf);
+
+    if (ret == 0) {
+        double moved = (double)c->size * c->count * (c->pattern == PATTERN_PINGPONG ? 2 : 1);
+        qsort(lat, c->count, sizeof(double), bench_compare_double);
+        result->mb_per_s = moved / elapsed / 1e6;
+        result->msgs_per_s = c->count / elapsed;
+        result->p50_us = lat[c->count / 2];
+        result->p99_us = lat[c->count * 99 / 100];
+        result->syscalls_per_msg = (double)syscalls / c->count;
+    }
+    free(lat);
+    return ret;
+}
+
+static int message_count(size_t size, int pattern, double scale)
+{
+    double bytes = (pattern == PATTERN_PINGPONG ? PINGPONG_BYTES : STREAM_BYTES) * scale;
+    double count = bytes / (double)size;
+    if (count > MAX_MESSAGES * scale) count = MAX_MESSAGES * scale;
+    return count < MIN_MESSAGES ? MIN_MESSAGES : (int)count;
+}
+
+static void print_result(const bench_case* c, const bench_result* r)
+{
+    printf("%-14s %-8s %10zu B %6d msgs %10.1f MB/s %10.1f msg/s %9.1f us p50 %9.1f us p99 %7.2f syscalls/msg\n",
+        c->name, pattern_names[c->pattern], c->size, c->count, r->mb_per_s, r->msgs_per_s, r->p50_us, r->p99_us,
+        r->syscalls_per_msg);
+}
+
+static void json_result(FILE* json, const bench_case* c, const bench_result* r, bool first)
+{
+    fprintf(json,
+        "%s    {\"section\": \"%s\", \"name\": \"%s\", \"pattern\": \"%s\", \"size\": %zu, \"messages\": %d, "
+        "\"mb_per_s\": %.1f, \"msgs_per_s\": %.1f, \"p50_us\": %.2f, \"p99_us\": %.2f, \"syscalls_per_msg\": %.3f}",
+        first ? "" : ",\n", c->section, c->name, pattern_names[c->pattern], c->size, c->count, r->mb_per_s,
+        r->msgs_per_s, r->p50_us, r->p99_us, r->syscalls_per_msg);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* json_path = NULL;
+    const char* port = "50100";
+    double scale = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-j") && i + 1 < argc) json_path = argv[++i];
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc) scale = atof(argv[++i]);
+        else port = argv[i];
+    }
+    if (scale <= 0) {
+        fprintf(stderr, "invalid arguments!\n");
+        return 1;
+    }
+
+#ifdef _WIN32
+    if (TCP_win32_init() != 0) {
+        fprintf(stderr, "Windows initialize function failed!\n");
+        return 1;
+    }
+#endif
+
+    static const size_t sizes[] = {
+        16, 64, 256, 1024, 4096, 16384, 65536, 262144, 1 << 20, 4 << 20,
+        6220800,  // 1920x1080 RGB
+        8294400,  // 1920x1080 RGBA
+        16 << 20,
+        24883200, // 3840x2160 RGB
+        33177600, // 3840x2160 RGBA
+        64 << 20,
+    };
+    static const struct {
+        const char* name;
+        int backend;
+        bool fixed;
+    } backends[] = {
+        { "sockets", NET_BACKEND_SOCKETS, false },
+        { "io_uring", NET_BACKEND_URING, false },
+        { "io_uring+fixed", NET_BACKEND_URING, true },
+    };
+    static const struct {
+        const char* name;
+        int preset;
+    } presets[] = {
+        { "default", NET_SOCKOPTS_DEFAULT },
+        { "low-latency", NET_SOCKOPTS_LOW_LATENCY },
+        { "bulk-frame", NET_SOCKOPTS_BULK_FRAME },
+    };
+    int nsizes = (int)(sizeof(sizes) / sizeof(sizes[0]));
+    int nbackends = (int)(sizeof(backends) / sizeof(backends[0]));
+    int npresets = (int)(sizeof(presets) / sizeof(presets[0]));
+
+    // all four sections, in order
+    bench_case cases[MAX_CASES];
+    int ncases = 0;
+    for (int i = 0; i < nsizes; i++) {
+        for (int pattern = PATTERN_PINGPONG; pattern <= PATTERN_STREAM; pattern++) {
+            bench_case c = { .section = "sizes", .name = "sockets", .backend = NET_BACKEND_SOCKETS,
+                .preset = NET_SOCKOPTS_DEFAULT, .pattern = pattern, .size = sizes[i],
+                .count = message_count(sizes[i], pattern, scale) };
+            cases[ncases++] = c;
+        }
+    }
+    for (int i = 0; i < nbackends; i++) {
+        bench_case c = { .section = "backends", .name = backends[i].name, .backend = backends[i].backend,
+            .fixed = backends[i].fixed, .preset = NET_SOCKOPTS_DEFAULT, .pattern = PATTERN_STREAM, .size = HD_FRAME,
+            .count = message_count(HD_FRAME, PATTERN_STREAM, scale) };
+        cases[ncases++] = c;
+    }
+    for (int i = 0; i < npresets; i++) {
+        bench_case ping = { .section = "presets", .name = presets[i].name, .backend = NET_BACKEND_SOCKETS,
+            .preset = presets[i].preset, .pattern = PATTERN_PINGPONG, .size = PING_SIZE,
+            .count = message_count(PING_SIZE, PATTERN_PINGPONG, scale) };
+        bench_case stream = { .section = "presets", .name = presets[i].name, .backend = NET_BACKEND_SOCKETS,
+            .preset = presets[i].preset, .pattern = PATTERN_STREAM, .size = HD_FRAME,
+            .count = message_count(HD_FRAME, PATTERN_STREAM, scale) };
+        cases[ncases++] = ping;
+        cases[ncases++] = stream;
+    }
+    bench_case checked = { .section = "checksum", .name = "crc32", .backend = NET_BACKEND_SOCKETS,
+        .preset = NET_SOCKOPTS_DEFAULT, .pattern = PATTERN_STREAM, .size = HD_FRAME,
+        .count = message_count(HD_FRAME, PATTERN_STREAM, scale), .checksum = true };
+    cases[ncases++] = checked;
+
+    size_t max_size = sizes[nsizes - 1];
+    char* data = (char*)malloc(max_size);
+    if (!data) return 1;
+    for (size_t i = 0; i < max_size; i++) data[i] = (char)i;
+
+    FILE* json = NULL;
+    if (json_path) {
+        json = fopen(json_path, "w");
+        if (!json) {
+            fprintf(stderr, "cannot open %s!\n", json_path);
+            free(data);
+            return 1;
+        }
+        fprintf(json, "{\n  \"benchmark\": \"io_bench\",\n  \"version\": 1,\n  \"scale\": %g,\n  \"cases\": [\n", scale);
+    }
+
+    printf("loopback, syscalls counted on both ends\n");
+    int ret = 0;
+    const char* section = NULL;
+    bool first = true;
+    for (int i = 0; i < ncases; i++) {
+        const bench_case* c = &cases[i];
+        if (!section || strcmp(section, c->section)) {
+            section = c->section;
+            printf("\n[%s]\n", section);
+        }
+        bench_result r;
+        int status = run(c, port, data, &r);
+        if (status == 1) printf("%-14s unavailable\n", c->name);
+        else if (status == -1) {
+            fprintf(stderr, "%s %s %zu B failed!\n", c->name, pattern_names[c->pattern], c->size);
+            ret = -1;
+        }
+        else {
+            print_result(c, &r);
+            if (json) json_result(json, c, &r, first);
+            first = false;
+        }
+    }
+
+    if (json) {
+        fprintf(json, "\n  ]\n}\n");
+        fclose(json);
+    }
+    free(data);
+    if (ret != 0) fprintf(stderr, "benchmark failed!\n");
+    return ret != 0;
+}
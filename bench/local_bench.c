@@ -0,0 +1,157 @@
+//
+// Same-host transport benchmark.
+// Compares TCP over 127.0.0.1 with the unix: and shm: transports:
+// round trips of a small message, then a stream of frames, and on shm:
+// the same stream built in place with TCP_shm_reserve() / TCP_shm_recv().
+//
+// exe [frame_kib] [frames] [port]
+// example: local_bench 8100 200 50110
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "bench.h"
+
+#define ROUND_TRIPS 20000
+#define SMALL_SIZE 64
+
+typedef struct server_args {
+    socket_t listensock;
+    size_t frame_size;
+    int frames;
+    bool in_place;
+} server_args;
+
+// Echo the round trips, drain the frames, then acknowledge with one byte.
+static int serve(void* arg)
+{
+    server_args* args = (server_args*)arg;
+    socket_t socket = TCP_accept3(args->listensock, NULL, false);
+    if (socket == INV_SOCKET) return -1;
+
+    char small[SMALL_SIZE];
+    for (int i = 0; i < ROUND_TRIPS; i++) {
+        if (TCP_recv_into(socket, small, sizeof(small), NULL) != SMALL_SIZE) return -1;
+        if (TCP_send(socket, small, SMALL_SIZE) != SMALL_SIZE) return -1;
+    }
+
+    net_buffer buf;
+    net_buffer_init(&buf);
+    int ret = 0;
+    for (int i = 0; i < args->frames && ret == 0; i++) {
+        if (args->in_place) {
+            net_header header;
+            if (!TCP_shm_recv(socket, &header) || header.length != args->frame_size) ret = -1;
+            TCP_shm_release(socket);
+        }
+        else if (TCP_recv_buffer(socket, &buf) != (int)args->frame_size) ret = -1;
+    }
+    char ack = 1;
+    if (ret == 0 && TCP_send(socket, &ack, 1) != 1) ret = -1;
+    net_buffer_free(&buf);
+    TCP_close(socket);
+    return ret;
+}
+
+static int run(const char* name, const char* addr, const char* port, bool in_place, const char* frame,
+    size_t frame_size, int frames)
+{
+    net_sockopts opts;
+    TCP_sockopts_preset(&opts, NET_SOCKOPTS_LOW_LATENCY);
+    opts.reuseaddr = true;
+    socket_t listensock = TCP_listen3(port, false, &opts, false);
+    if (listensock == INV_SOCKET) return -1;
+    server_args args = { listensock, frame_size, frames, in_place };
+    bench_thread server;
+    if (!bench_thread_start(&server, serve, &args)) {
+        TCP_close(listensock);
+        return -1;
+    }
+
+    int ret = -1;
+    double rtt = 0, elapsed = 0;
+    // in place needs a ring that holds a whole frame
+    TCP_set_shm_ring(in_place ? frame_size + 4096 : 0);
+    socket_t socket = TCP_connect3(addr, port, &opts, false);
+    if (socket != INV_SOCKET) {
+        ret = 0;
+        char small[SMALL_SIZE];
+        memset(small, 1, sizeof(small));
+        double start = bench_now_sec();
+        for (int i = 0; i < ROUND_TRIPS && ret == 0; i++) {
+            if (TCP_send(socket, small, SMALL_SIZE) != SMALL_SIZE ||
+                TCP_recv_into(socket, small, sizeof(small), NULL) != SMALL_SIZE) ret = -1;
+        }
+        rtt = (bench_now_sec() - start) / ROUND_TRIPS;
+
+        start = bench_now_sec();
+        for (int i = 0; i < frames && ret == 0; i++) {
+            if (in_place) {
+                // stand-in for rendering straight into the ring
+                char* dst = TCP_shm_reserve(socket, frame_size);
+                net_header header;
+                memset(&header, 0, sizeof(header));
+                header.length = frame_size;
+                if (!dst) ret = -1;
+                else {
+                    memcpy(dst, frame, frame_size);
+                    if (TCP_shm_commit(socket, &header) != (int64_t)frame_size) ret = -1;
+                }
+            }
+            else if (TCP_send(socket, frame, (unsigned)frame_size) != (int)frame_size) ret = -1;
+        }
+        char* ack = NULL;
+        if (ret == 0 && TCP_recv(socket, &ack) != 1) ret = -1;
+        free(ack);
+        elapsed = bench_now_sec() - start;
+        TCP_close(socket);
+    }
+    if (bench_thread_join(&server) != 0) ret = -1;
+    TCP_close(listensock);
+    if (ret == 0) {
+        printf("%-14s rtt %7.2f us %10.1f MB/s %8.3f ms/frame\n", name, rtt * 1e6,
+            (double)frame_size * frames / elapsed / 1e6, elapsed * 1e3 / frames);
+    }
+    else fprintf(stderr, "%s failed!\n", name);
+    return ret;
+}
+
+int main(int argc, char* argv[])
+{
+    int kib = argc > 1 ? atoi(argv[1]) : 8100; // one 1920x1080 RGBA frame
+    int frames = argc > 2 ? atoi(argv[2]) : 200;
+    const char* port = argc > 3 ? argv[3] : "50110";
+    if (kib <= 0 || frames <= 0) {
+        fprintf(stderr, "invalid arguments!\n");
+        return 1;
+    }
+
+#ifdef _WIN32
+    if (TCP_win32_init() != 0) {
+        fprintf(stderr, "Windows initialize function failed!\n");
+        return 1;
+    }
+#endif
+
+    size_t frame_size = (size_t)kib * 1024;
+    char* frame = (char*)malloc(frame_size);
+    if (!frame) return 1;
+    for (size_t i = 0; i < frame_size; i++) frame[i] = (char)(i * 7 + (i >> 12));
+
+    printf("%d round trips of %d B, %d frames of %d KiB\n", ROUND_TRIPS, SMALL_SIZE, frames, kib);
+    int ret = run("tcp", "127.0.0.1", port, false, frame, frame_size, frames);
+#ifndef _WIN32
+    ret |= run("unix", "unix:@io_local_bench", "unix:@io_local_bench", false, frame, frame_size, frames);
+#endif
+#ifdef __linux__
+    ret |= run("shm", "shm:@io_local_bench", "shm:@io_local_bench", false, frame, frame_size, frames);
+    ret |= run("shm in place", "shm:@io_local_bench", "shm:@io_local_bench", true, frame, frame_size, frames);
+#endif
+
+    free(frame);
+    if (ret != 0) fprintf(stderr, "benchmark failed!\n");
+    return ret != 0;
+}
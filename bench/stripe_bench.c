@@ -0,0 +1,116 @@
+//
+// Striped transfer benchmark.
+// Sends a large payload over 127.0.0.1 with TCP_stripe_send() on 1 to 8
+// parallel connections and reports throughput per stripe count.
+//
+// exe [megabytes] [transfers] [port]
+// example: stripe_bench 64 10 50100
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "bench.h"
+
+typedef struct server_args {
+    socket_t listensock;
+    int transfers;
+    const char* expected;
+    size_t size;
+} server_args;
+
+// Receive transfers, check the last one, then acknowledge with one byte.
+static int serve(void* arg)
+{
+    server_args* args = (server_args*)arg;
+    net_stripe* stripe = TCP_stripe_accept(args->listensock, NULL);
+    if (!stripe) return -1;
+
+    net_buffer buf;
+    net_buffer_init(&buf);
+    int ret = 0;
+    for (int i = 0; i < args->transfers && ret == 0; i++) {
+        if (TCP_stripe_recv(stripe, &buf) != (int64_t)args->size) ret = -1;
+    }
+    if (ret == 0 && memcmp(buf.data, args->expected, args->size) != 0) {
+        fprintf(stderr, "received data differs!\n");
+        ret = -1;
+    }
+    char ack = 1;
+    if (ret == 0 && TCP_stripe_send(stripe, &ack, 1, 0) != 1) ret = -1;
+    net_buffer_free(&buf);
+    TCP_stripe_close(stripe);
+    return ret;
+}
+
+static int run(int count, int transfers, const char* port, const char* data, size_t size)
+{
+    net_sockopts opts;
+    TCP_sockopts_preset(&opts, NET_SOCKOPTS_DEFAULT);
+    opts.reuseaddr = true;
+    socket_t listensock = TCP_listen3(port, false, &opts, false);
+    if (listensock == INV_SOCKET) return -1;
+    server_args args = { listensock, transfers, data, size };
+    bench_thread server;
+    if (!bench_thread_start(&server, serve, &args)) {
+        TCP_close(listensock);
+        return -1;
+    }
+
+    int ret = -1;
+    double elapsed = 0;
+    net_stripe* stripe = TCP_stripe_connect("127.0.0.1", port, count, NULL);
+    if (stripe) {
+        net_buffer ack;
+        net_buffer_init(&ack);
+        double start = bench_now_sec();
+        ret = 0;
+        for (int i = 0; i < transfers && ret == 0; i++) {
+            if (TCP_stripe_send(stripe, data, size, 0) != (int64_t)size) ret = -1;
+        }
+        if (ret == 0 && TCP_stripe_recv(stripe, &ack) != 1) ret = -1;
+        elapsed = bench_now_sec() - start;
+        net_buffer_free(&ack);
+        TCP_stripe_close(stripe);
+    }
+    if (bench_thread_join(&server) != 0) ret = -1;
+    TCP_close(listensock);
+    if (ret == 0) {
+        printf("%2d stripes %10.1f MB/s %8.2f ms/transfer\n", count, (double)size * transfers / elapsed / 1e6,
+            elapsed * 1e3 / transfers);
+    }
+    return ret;
+}
+
+int main(int argc, char* argv[])
+{
+    int megabytes = argc > 1 ? atoi(argv[1]) : 64;
+    int transfers = argc > 2 ? atoi(argv[2]) : 10;
+    const char* port = argc > 3 ? argv[3] : "50100";
+    if (megabytes <= 0 || transfers <= 0) {
+        fprintf(stderr, "invalid arguments!\n");
+        return 1;
+    }
+
+#ifdef _WIN32
+    if (TCP_win32_init() != 0) {
+        fprintf(stderr, "Windows initialize function failed!\n");
+        return 1;
+    }
+#endif
+
+    size_t size = (size_t)megabytes * 1024 * 1024;
+    char* data = (char*)malloc(size);
+    if (!data) return 1;
+    for (size_t i = 0; i < size; i++) data[i] = (char)(i * 7 + (i >> 12));
+
+    printf("%d transfers of %d MiB over loopback, 1 MiB chunks\n", transfers, megabytes);
+    int ret = 0;
+    for (int count = 1; count <= 8; count *= 2) ret |= run(count, transfers, port, data, size);
+
+    free(data);
+    if (ret != 0) fprintf(stderr, "benchmark failed!\n");
+    return ret != 0;
+}
@@ -10,6 +10,10 @@
 
 #define _CRT_SECURE_NO_WARNINGS 1
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE 1 // MSG_MORE, sendfile
+#endif
+
 #ifdef _WIN32
     #define WIN32_LEAN_AND_MEAN
     #include <windows.h>
@@ -19,55 +23,107 @@
     #pragma comment(lib, "ws2_32.lib")
 #else
     #include <unistd.h>
+    #include <fcntl.h>
     #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/uio.h>
     #include <netdb.h>
     #include <errno.h>
 #endif
+#ifdef __linux__
+    #include <sys/sendfile.h>
+    #include <linux/errqueue.h>
+    #include <netinet/in.h>
+    #include <poll.h>
+#endif
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION 1
-#include "stb_image_write.h"
-
 #include "io.h"
+#include "io_internal.h"
 
-#ifndef MIN
-#define MIN(a, b) ((a) < (b) ? (a) : (b))
-#endif
-
-#ifndef MAX
-#define MAX(a, b) ((a) > (b) ? (a) : (b))
-#endif
+// stb's PNG writers deflate with io_deflate.c and checksum with io_checksum.c
+#define STBIW_ZLIB_COMPRESS img_zlib_compress
+#define STBIW_CRC32(buffer, len) TCP_crc32(0, buffer, (size_t)(len))
+#define STB_IMAGE_WRITE_IMPLEMENTATION 1
+#include "stb_image_write.h"
 
 bool write_bmp(const char* filename, const void* data, int width, int height, int channels) {
     return stbi_write_bmp(filename, width, height, channels, data);
 }
 
 bool write_png(const char* filename, const void* data, int width, int height, int channels) {
-    return stbi_write_png(filename, width, height, channels, data, 0);
+    return write_png_ex(filename, data, width, height, channels, NULL);
 }
 
-#define NET_TIMEOUT 30
-#define NET_MAXINIT 11 // max size of init message
+#define NET_MAXIOV 64 // fragments per vectored send syscall
+#define NET_FILE_CHUNK (256 * 1024) // read/send fallback chunk for file sends
+#define NET_MAXSYSCALL ((uint64_t)0x40000000) // max bytes per send/recv call
 
-#ifdef _WIN32
-#define TCP_ERRNO WSAGetLastError()
+#if defined(__linux__) && defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+#define NET_HAVE_ZEROCOPY 1
+#endif
+
+#ifdef MSG_MORE
+#define NET_MSG_MORE MSG_MORE // hint that payload follows the header
 #else
-#define TCP_ERRNO errno
+#define NET_MSG_MORE 0
 #endif
 
 /*
     protocol:
-    init: total_size
+    header: net_header (NET_HEADER_SIZE bytes, little-endian)
+    data: data
+
+    legacy protocol:
+    init: total_size (decimal string, NET_MAXINIT bytes)
     data: data
-    ack: ACK_YES
 */
 
+static int net_framing = NET_FRAMING_BINARY;
+static uint32_t net_seq = 0;
+void TCP_set_framing(int framing)
+{
+    net_framing = framing;
+}
+
+uint64_t net_max_message = NET_MAX_MESSAGE;
+void TCP_set_max_message(uint64_t max_size)
+{
+    net_max_message = max_size ? max_size : NET_MAX_MESSAGE;
+}
+
+uint32_t net_next_seq(void)
+{
+#if defined(__GNUC__)
+    return __atomic_fetch_add(&net_seq, 1, __ATOMIC_RELAXED);
+#elif defined(_WIN32)
+    return (uint32_t)InterlockedIncrement((volatile LONG*)&net_seq) - 1;
+#else
+    return net_seq++;
+#endif
+}
+
+static void encode_header(unsigned char* buf, const net_header* header)
+{
+    put_le32(buf, NET_MAGIC);
+    buf[4] = NET_VERSION;
+    buf[5] = header->type;
+    put_le16(buf + 6, header->flags);
+    put_le32(buf + 8, header->seq);
+    put_le32(buf + 12, header->flags & NET_FLAG_CHECKSUM ? header->checksum : 0);
+    put_le64(buf + 16, header->length);
+}
+
 void TCP_close(socket_t socket)
 {
     if (socket != INV_SOCKET) {
+        net_stats_release(socket);
+#ifdef __linux__
+        if (__atomic_load_n(&net_shm_count, __ATOMIC_RELAXED)) net_shm_close(socket);
+#endif
 #ifdef _WIN32
         closesocket(socket);
 #else
@@ -78,6 +134,11 @@ void TCP_close(socket_t socket)
 
 void TCP_wrshutdown(socket_t socket)
 {
+    net_shm* shm = net_shm_get(socket);
+    if (shm) {
+        net_shm_shutdown(shm);
+        return;
+    }
 #ifdef _WIN32
     int ret = shutdown(socket, SD_SEND);
 #else
@@ -93,38 +154,135 @@ void TCP_wrshutdown(socket_t socket)
 }
 
 // TCP send loop
-// size should be in range (0B, 2GiB)
+// size may exceed 2GiB, each syscall sends at most NET_MAXSYSCALL bytes
 // returns total byte send, -1 for error (with socket cleanup)
-int send_data(socket_t socket, const char* data, unsigned total_size, const char* log_name) {
-    unsigned send_left = total_size;
+int64_t send_data(socket_t socket, const char* data, uint64_t total_size, const char* log_name) {
+    net_shm* shm = net_shm_get(socket);
+    if (shm) {
+        net_iovec iov = { data, (size_t)total_size };
+        return net_shm_sendv(shm, &iov, 1, log_name);
+    }
+#ifdef NET_HAVE_URING
+    if (net_uring_active()) {
+        net_iovec iov = { data, (size_t)total_size };
+        return net_uring_sendv(socket, &iov, 1, 0, log_name);
+    }
+#endif
+    net_stats* stats = net_stats_find(socket);
+    uint64_t send_left = total_size;
     while(true) {
-        int send_byte = send(socket, data+total_size-send_left, send_left, 0);
+        net_count_syscall(stats);
+        int send_byte = send(socket, data+total_size-send_left, (int)MIN(send_left, NET_MAXSYSCALL), 0);
         if (send_byte == -1) {
             fprintf(stderr, "ERROR: %s message send failed with err %d\n", log_name, TCP_ERRNO);
             TCP_close(socket);
             return -1;
         }
+        net_count_bytes(stats, false, send_byte, MIN(send_left, NET_MAXSYSCALL));
         send_left -= send_byte;
-        //printf("send %s msg of size: %d, left: %u\n", log_name, send_byte, send_left); // test
-        if (!send_left) return total_size;
+        //printf("send %s msg of size: %d, left: %llu\n", log_name, send_byte, send_left); // test
+        if (!send_left) return (int64_t)total_size;
+    }
+}
+
+// TCP vectored send loop
+// sends all fragments in order, NET_MAXIOV at a time, resuming after partial sends
+// returns total byte send, -1 for error (with socket cleanup)
+int64_t sendv_data(socket_t socket, const net_iovec* iov, int iovcnt, int flags, const char* log_name)
+{
+    net_shm* shm = net_shm_get(socket);
+    if (shm) return net_shm_sendv(shm, iov, iovcnt, log_name);
+#ifdef NET_HAVE_URING
+    if (net_uring_active()) return net_uring_sendv(socket, iov, iovcnt, flags, log_name);
+#endif
+    net_stats* stats = net_stats_find(socket);
+    int64_t total_size = 0;
+    int index = 0;
+    size_t offset = 0; // bytes of iov[index] already sent
+    while (true) {
+        // skip empty and completed fragments
+        while (index < iovcnt && offset == iov[index].len) {
+            index++;
+            offset = 0;
+        }
+        if (index == iovcnt) return total_size;
+
+#ifdef _WIN32
+        WSABUF bufs[NET_MAXIOV];
+        DWORD count = 0;
+        uint64_t asked = 0;
+        for (int i = index; i < iovcnt && count < NET_MAXIOV; i++) {
+            size_t skip = i == index ? offset : 0;
+            bufs[count].buf = (char*)iov[i].base + skip;
+            bufs[count].len = (ULONG)MIN(iov[i].len - skip, 0x7fffffff);
+            asked += bufs[count].len;
+            count++;
+        }
+        DWORD sent = 0;
+        net_count_syscall(stats);
+        int64_t send_byte = WSASend(socket, bufs, count, &sent, flags, NULL, NULL) == 0 ? (int64_t)sent : -1;
+#else
+        struct iovec bufs[NET_MAXIOV];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        uint64_t asked = 0;
+        for (int i = index; i < iovcnt && msg.msg_iovlen < NET_MAXIOV; i++) {
+            size_t skip = i == index ? offset : 0;
+            bufs[msg.msg_iovlen].iov_base = (char*)iov[i].base + skip;
+            bufs[msg.msg_iovlen].iov_len = iov[i].len - skip;
+            asked += bufs[msg.msg_iovlen].iov_len;
+            msg.msg_iovlen++;
+        }
+        msg.msg_iov = bufs;
+        net_count_syscall(stats);
+        int64_t send_byte = sendmsg(socket, &msg, flags);
+#endif
+        if (send_byte == -1) {
+            fprintf(stderr, "ERROR: %s message send failed with err %d\n", log_name, TCP_ERRNO);
+            TCP_close(socket);
+            return -1;
+        }
+        net_count_bytes(stats, false, send_byte, asked);
+        total_size += send_byte;
+
+        // advance past sent bytes
+        while (send_byte > 0) {
+            size_t step = (size_t)MIN((int64_t)(iov[index].len - offset), send_byte);
+            offset += step;
+            send_byte -= step;
+            if (offset == iov[index].len) {
+                index++;
+                offset = 0;
+            }
+        }
     }
 }
 
 
 // TCP recv loop
+// size may exceed 2GiB, each syscall receives at most NET_MAXSYSCALL bytes
 // returns total byte recv, -1 for error (with socket cleanup); data (pre allocated)
-int recv_data(socket_t socket, char* data, unsigned total_size, const char* log_name) {
-    unsigned recv_left = total_size;
+int64_t recv_data(socket_t socket, char* data, uint64_t total_size, const char* log_name) {
+    net_shm* shm = net_shm_get(socket);
+    if (shm) return net_shm_recv(shm, data, total_size, false, log_name);
+#ifdef NET_HAVE_URING
+    if (net_uring_active()) return net_uring_recv(socket, data, total_size, log_name);
+#endif
+    net_stats* stats = net_stats_find(socket);
+    uint64_t recv_left = total_size;
     while(true) {
-        int recv_byte = recv(socket, data+total_size-recv_left, recv_left, 0);
-        if (recv_byte == -1) {
-            fprintf(stderr, "ERROR: %s message receive failed with err %d\n", log_name, TCP_ERRNO);
+        net_count_syscall(stats);
+        int recv_byte = recv(socket, data+total_size-recv_left, (int)MIN(recv_left, NET_MAXSYSCALL), 0);
+        if (recv_byte <= 0) {
+            if (recv_byte == 0) fprintf(stderr, "ERROR: %s message receive failed, connection closed\n", log_name);
+            else fprintf(stderr, "ERROR: %s message receive failed with err %d\n", log_name, TCP_ERRNO);
             TCP_close(socket);
             return -1;
         }
+        net_count_bytes(stats, true, recv_byte, MIN(recv_left, NET_MAXSYSCALL));
         recv_left -= recv_byte;
-        //printf("send %s msg of size: %d, left: %u\n", log_name, recv_byte, recv_left); // test
-        if (!recv_left) return total_size;
+        //printf("recv %s msg of size: %d, left: %llu\n", log_name, recv_byte, recv_left); // test
+        if (!recv_left) return (int64_t)total_size;
     }
 }
 
@@ -160,34 +318,44 @@ int TCP_win32_init()
 }
 #endif
 
-socket_t TCP_connect2(const char* addr, const char* port, bool verbose)
+// Resolve addr, port for connecting.
+// returns 0, -1 for error; *server_info (freeaddrinfo)
+int net_resolve(const char* addr, const char* port, struct addrinfo** server_info)
 {
     // parse
     if (!addr || !port || strlen(addr) >= NET_MAX_STRING || strlen(port) >= NET_MAX_STRING) {
         fprintf(stderr, "ERROR: Invalid input!\n");
-        return INV_SOCKET;
+        return -1;
     }
 
-    struct addrinfo hints, * server_info, * p;
+    struct addrinfo hints;
     memset(&hints, 0, sizeof(hints));
     hints.ai_family = AF_UNSPEC; // ipv4 & ipv6
     hints.ai_socktype = SOCK_STREAM;
-    if (getaddrinfo(addr, port, &hints, &server_info) != 0) {
+    if (getaddrinfo(addr, port, &hints, server_info) != 0) {
         fprintf(stderr, "ERROR: Invalid addrinfo!\n");
-        return INV_SOCKET;
+        return -1;
     }
+    return 0;
+}
 
+// Connect to the first reachable resolved address.
+// opts (optional) are set before connecting so buffer sizes shape the handshake.
+// returns new socket (INV_SOCKET on failure)
+socket_t net_connect_addrinfo(const struct addrinfo* server_info, const net_sockopts* opts, bool verbose)
+{
     // connect
     socket_t client_socket;
+    const struct addrinfo* p;
     for (p = server_info; p != NULL; p = p->ai_next) {
         client_socket = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
         if (client_socket == INV_SOCKET) continue;
+        if (opts) TCP_set_sockopts(client_socket, opts);
         if (connect(client_socket, p->ai_addr, (socklen_t)p->ai_addrlen) != -1) break;
         TCP_close(client_socket);
     }
     if (p == NULL) {
         fprintf(stderr, "ERROR: Connection failed!\n");
-        freeaddrinfo(server_info);
         return INV_SOCKET;
     }
 
@@ -201,8 +369,6 @@ socket_t TCP_connect2(const char* addr, const char* port, bool verbose)
         else fprintf(stderr, "WARNING: server getnameinfo failed with err %d!\n", err);    
     }
 
-    freeaddrinfo(server_info);
-
     // inactivity timer
     struct timeval timer = { NET_TIMEOUT, 0 };
     if (setsockopt(client_socket, SOL_SOCKET, SO_SNDTIMEO, (char*)&timer, sizeof(timer)) == -1) {
@@ -212,6 +378,163 @@ socket_t TCP_connect2(const char* addr, const char* port, bool verbose)
     return client_socket;
 }
 
+socket_t TCP_connect3(const char* addr, const char* port, const net_sockopts* opts, bool verbose)
+{
+    if (net_local_scheme(addr) != NET_LOCAL_NONE) return net_local_connect(addr, opts, verbose);
+    struct addrinfo* server_info;
+    if (net_resolve(addr, port, &server_info) == -1) return INV_SOCKET;
+    socket_t client_socket = net_connect_addrinfo(server_info, opts, verbose);
+    freeaddrinfo(server_info);
+    return client_socket;
+}
+
+// Encode header in the current framing.
+// returns header size, -1 if the header cannot be sent in legacy framing
+int net_encode_frame(char* buffer, const net_header* header)
+{
+    if (net_framing == NET_FRAMING_LEGACY) {
+        if (header->type != NET_MSG_DATA || header->flags || !header->length ||
+            (header->length & ~(uint64_t)0x7fffffff)) {
+            fprintf(stderr, "ERROR: Message not representable in legacy framing!\n");
+            return -1;
+        }
+        memset(buffer, 0, NET_MAXINIT);
+        sprintf(buffer, "%u", (unsigned)header->length);
+        return NET_MAXINIT;
+    }
+    encode_header((unsigned char*)buffer, header);
+    return NET_HEADER_SIZE;
+}
+
+// Send header (binary or legacy framing) followed by payload fragments,
+// in one syscall where the socket buffer allows, checksummed if net_checksummed().
+// header->length must equal the total fragment size.
+// returns payload size, -1 for error (with socket cleanup)
+// trailer (NET_TRACE_SIZE bytes, NULL for none) goes out in the same syscall
+// as the payload, its send_end stamped just before.
+static int64_t sendv_msg(socket_t socket, const net_header* header, const net_iovec* iov, int iovcnt,
+    unsigned char* trailer)
+{
+    uint64_t start_ns = net_now_ns();
+    net_header checked;
+    if (net_checksummed(header->flags)) {
+        checked = *header;
+        checked.flags |= NET_FLAG_CHECKSUM;
+        checked.checksum = net_checksum_iov(iov, iovcnt);
+        header = &checked;
+    }
+    net_iovec bufs[2 + NET_MAXIOV];
+    net_iovec* frags = bufs;
+    if (iovcnt > NET_MAXIOV) {
+        frags = (net_iovec*)malloc((2 + iovcnt) * sizeof(net_iovec));
+        if (!frags) {
+            fprintf(stderr, "ERROR: Out of memory!\n");
+            return -1;
+        }
+    }
+
+    char buffer[NET_MAXHEADER];
+    int size = net_encode_frame(buffer, header);
+    if (size == -1) {
+        if (frags != bufs) free(frags);
+        return -1;
+    }
+    frags[0].len = size;
+    frags[0].base = buffer;
+    memcpy(frags + 1, iov, iovcnt * sizeof(net_iovec));
+    int count = 1 + iovcnt;
+    if (trailer) {
+        frags[count].base = (const char*)trailer;
+        frags[count++].len = NET_TRACE_SIZE;
+        put_le64(trailer + 24, net_now_ns()); // send_end
+    }
+
+    int64_t ret = sendv_data(socket, frags, count, 0, "Data");
+    if (frags != bufs) free(frags);
+    if (ret == -1) return -1;
+    net_count_msg(net_stats_find(socket), false, header->length, start_ns);
+    return (int64_t)header->length;
+}
+
+bool net_compressible(uint64_t len)
+{
+    return net_compress_min && len >= net_compress_min && net_framing == NET_FRAMING_BINARY;
+}
+
+bool net_checksummed(uint16_t flags)
+{
+    return (net_checksum_on || (flags & NET_FLAG_CHECKSUM)) && net_framing == NET_FRAMING_BINARY;
+}
+
+int net_send_msg(socket_t socket, const net_header* header, const char* data, unsigned char* trailer)
+{
+    if (net_compressible(header->length) && !(header->flags & NET_FLAG_COMPRESSED)) {
+        char* packed = (char*)malloc((size_t)header->length);
+        int64_t packed_len = packed ? net_compress(data, (size_t)header->length, packed) : -1;
+        if (packed_len != -1) {
+            net_header h = *header;
+            h.flags |= NET_FLAG_COMPRESSED;
+            h.length = (uint64_t)packed_len;
+            net_iovec iov = { packed, (size_t)packed_len };
+            int64_t ret = sendv_msg(socket, &h, &iov, 1, trailer);
+            free(packed);
+            return ret == -1 ? -1 : (int)header->length;
+        }
+        // incompressible (or out of memory), send as is
+        free(packed);
+    }
+    net_iovec iov = { data, (size_t)header->length };
+    return (int)sendv_msg(socket, header, &iov, header->length ? 1 : 0, trailer);
+}
+
+// Sum of fragment sizes, -1 if invalid
+static int64_t iov_size(const net_iovec* iov, int iovcnt)
+{
+    if (iovcnt < 0 || (iovcnt && !iov)) return -1;
+    int64_t total_size = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        if (iov[i].len && !iov[i].base) return -1;
+        total_size += iov[i].len;
+    }
+    return total_size;
+}
+
+int TCP_sendv_msg(socket_t socket, const net_header* header, const net_iovec* iov, int iovcnt)
+{
+    int64_t total_size = iov_size(iov, iovcnt);
+    if (!header || total_size < 0 || (total_size & ~(int64_t)0x7fffffff)) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    net_header h = *header;
+    h.length = (uint64_t)total_size;
+    return (int)sendv_msg(socket, &h, iov, iovcnt, NULL);
+}
+
+int TCP_sendv(socket_t socket, const net_iovec* iov, int iovcnt)
+{
+    int64_t total_size = iov_size(iov, iovcnt);
+    if (total_size <= 0 || (total_size & ~(int64_t)0x7fffffff)) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    net_header header;
+    memset(&header, 0, sizeof(header));
+    header.type = NET_MSG_DATA;
+    header.seq = net_next_seq();
+    header.length = (uint64_t)total_size;
+    return (int)sendv_msg(socket, &header, iov, iovcnt, NULL);
+}
+
+int TCP_send_msg(socket_t socket, const net_header* header, const char* data)
+{
+    if (!header || (header->length & ~(uint64_t)0x7fffffff) || (header->length && !data)) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    return net_send_msg(socket, header, data, NULL);
+}
+
 int TCP_send2(socket_t socket, const char* data, unsigned total_size, bool verbose) {
     
     if (!total_size || (total_size & 0x80000000) || !data) {
@@ -222,15 +545,12 @@ int TCP_send2(socket_t socket, const char* data, unsigned total_size, bool verbo
     if (verbose) 
         printf("MESSAGE: Send start.\n");
 
-    // size of data
-    char buffer[NET_MAXINIT];
-    memset(buffer, 0, NET_MAXINIT);
-    sprintf(buffer, "%u", total_size);
-    if (send_data(socket, buffer, NET_MAXINIT, "Initial") == -1) {
-        return -1;
-    }  
-    // data msg
-    if (send_data(socket, data, total_size, "Data") == -1) {
+    net_header header;
+    memset(&header, 0, sizeof(header));
+    header.type = NET_MSG_DATA;
+    header.seq = net_next_seq();
+    header.length = total_size;
+    if (net_send_msg(socket, &header, data, NULL) == -1) {
         return -1;
     }
 
@@ -240,8 +560,320 @@ int TCP_send2(socket_t socket, const char* data, unsigned total_size, bool verbo
     return total_size;
 }
 
-socket_t TCP_listen2(const char* port, bool ipv6, bool verbose)
+// Files are CRT streams on Windows (the fd API lives in <io.h>,
+// which this library's own header shadows) and descriptors elsewhere.
+#ifdef _WIN32
+typedef FILE* net_file;
+#else
+typedef int net_file;
+#endif
+
+static int64_t file_size(net_file file)
+{
+#ifdef _WIN32
+    if (_fseeki64(file, 0, SEEK_END) != 0) return -1;
+    return _ftelli64(file);
+#else
+    struct stat st;
+    if (fstat(file, &st) != 0) return -1;
+    return (int64_t)st.st_size;
+#endif
+}
+
+// Stream length bytes of file from offset with read/send.
+// returns 0, -1 for error (with socket cleanup)
+static int send_file_chunked(socket_t socket, net_file file, uint64_t offset, uint64_t length)
+{
+    char* chunk = (char*)malloc(NET_FILE_CHUNK);
+    if (!chunk) {
+        fprintf(stderr, "ERROR: Out of memory!\n");
+        TCP_close(socket);
+        return -1;
+    }
+#ifdef _WIN32
+    if (_fseeki64(file, (__int64)offset, SEEK_SET) != 0) {
+#else
+    if (lseek(file, (off_t)offset, SEEK_SET) == (off_t)-1) {
+#endif
+        fprintf(stderr, "ERROR: File seek failed!\n");
+        free(chunk);
+        TCP_close(socket);
+        return -1;
+    }
+    while (length) {
+        unsigned want = (unsigned)MIN(length, (uint64_t)NET_FILE_CHUNK);
+#ifdef _WIN32
+        int got = (int)fread(chunk, 1, want, file);
+#else
+        int got = (int)read(file, chunk, want);
+#endif
+        if (got <= 0) {
+            fprintf(stderr, "ERROR: File read failed!\n");
+            free(chunk);
+            TCP_close(socket);
+            return -1;
+        }
+        if (send_data(socket, chunk, got, "File") == -1) {
+            free(chunk);
+            return -1;
+        }
+        length -= got;
+    }
+    free(chunk);
+    return 0;
+}
+
+static int64_t send_file(socket_t socket, net_file file, uint64_t offset, uint64_t length)
 {
+    int64_t size = file_size(file);
+    if (size < 0) {
+        fprintf(stderr, "ERROR: File stat failed!\n");
+        return -1;
+    }
+    if (offset > (uint64_t)size) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    if (!length) length = size - offset;
+    if (!length || length > size - offset) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+
+    uint64_t start_ns = net_now_ns();
+    net_header header;
+    memset(&header, 0, sizeof(header));
+    header.type = NET_MSG_DATA;
+    header.seq = net_next_seq();
+    header.length = length;
+    char buffer[NET_MAXHEADER];
+    int header_len = net_encode_frame(buffer, &header);
+    if (header_len == -1) return -1;
+    net_iovec iov = { buffer, (size_t)header_len };
+    if (sendv_data(socket, &iov, 1, NET_MSG_MORE, "Header") == -1) return -1;
+
+#ifdef __linux__
+    // kernel copies straight from the page cache, no user-space buffer
+    net_stats* stats = net_stats_find(socket);
+    off_t pos = (off_t)offset;
+    uint64_t left = length;
+    while (left) {
+        net_count_syscall(stats);
+        ssize_t send_byte = sendfile(socket, file, &pos, (size_t)MIN(left, (uint64_t)0x7ffff000));
+        if (send_byte == -1 && (errno == EINVAL || errno == ENOSYS) && left == length) {
+            // file type not supported by sendfile
+            if (send_file_chunked(socket, file, offset, length) == -1) return -1;
+            break;
+        }
+        if (send_byte <= 0) {
+            if (send_byte == 0) fprintf(stderr, "ERROR: File message send failed, file truncated\n");
+            else fprintf(stderr, "ERROR: File message send failed with err %d\n", TCP_ERRNO);
+            TCP_close(socket);
+            return -1;
+        }
+        net_count_bytes(stats, false, send_byte, MIN(left, (uint64_t)0x7ffff000));
+        left -= send_byte;
+    }
+#else
+    if (send_file_chunked(socket, file, offset, length) == -1) return -1;
+#endif
+
+    net_count_msg(net_stats_find(socket), false, length, start_ns);
+    return (int64_t)length;
+}
+
+#ifndef _WIN32
+int64_t TCP_send_fd(socket_t socket, int fd, uint64_t offset, uint64_t length)
+{
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    return send_file(socket, fd, offset, length);
+}
+#endif
+
+int64_t TCP_send_file(socket_t socket, const char* path, uint64_t offset, uint64_t length)
+{
+    if (!path) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+#ifdef _WIN32
+    net_file file = fopen(path, "rb");
+    if (!file) {
+#else
+    net_file file = open(path, O_RDONLY);
+    if (file < 0) {
+#endif
+        fprintf(stderr, "ERROR: File %s not accessible!\n", path);
+        return -1;
+    }
+    int64_t ret = send_file(socket, file, offset, length);
+#ifdef _WIN32
+    fclose(file);
+#else
+    close(file);
+#endif
+    return ret;
+}
+
+bool TCP_zerocopy_init(net_zerocopy* zc, socket_t socket, size_t threshold)
+{
+    memset(zc, 0, sizeof(*zc));
+    zc->socket = socket;
+    zc->threshold = threshold;
+#ifdef NET_HAVE_ZEROCOPY
+    int one = 1;
+    zc->enabled = setsockopt(socket, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+    if (!zc->enabled)
+        fprintf(stderr, "WARNING: SO_ZEROCOPY failed with err %d, sends will copy!\n", TCP_ERRNO);
+#endif
+    return zc->enabled;
+}
+
+// ids are 32-bit and wrap, compare by distance
+static bool zc_id_reached(uint32_t done_id, uint32_t id)
+{
+    return (int32_t)(done_id - id) >= 0;
+}
+
+int TCP_zerocopy_reap(net_zerocopy* zc, bool wait)
+{
+#ifdef NET_HAVE_ZEROCOPY
+    int reaped = 0;
+    while (zc->done_id != zc->next_id) {
+        if (wait && !reaped) {
+            // completions are signalled as POLLERR
+            struct pollfd pfd = { zc->socket, 0, 0 };
+            int ret = poll(&pfd, 1, NET_TIMEOUT * 1000);
+            if (ret <= 0) {
+                fprintf(stderr, "ERROR: Zerocopy completion wait failed with err %d\n", ret ? TCP_ERRNO : 0);
+                return -1;
+            }
+        }
+
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(zc->socket, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return reaped;
+            fprintf(stderr, "ERROR: Zerocopy completion read failed with err %d\n", TCP_ERRNO);
+            return -1;
+        }
+
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                  (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) continue;
+            struct sock_extended_err* err = (struct sock_extended_err*)CMSG_DATA(cm);
+            if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY || err->ee_errno != 0) continue;
+
+            // range [lo, hi] of completed ids, reported in order for TCP
+            uint32_t lo = err->ee_info, hi = err->ee_data;
+            bool copied = (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+            for (uint32_t id = lo; id != hi + 1; id++) {
+                uint32_t len = zc->pending_len[id % NET_ZC_RING];
+                if (copied) zc->bytes_copied += len;
+                else zc->bytes_zerocopy += len;
+                reaped++;
+            }
+            if (zc_id_reached(hi + 1, zc->done_id)) zc->done_id = hi + 1;
+        }
+    }
+    return reaped;
+#else
+    (void)zc;
+    (void)wait;
+    return 0;
+#endif
+}
+
+bool TCP_zerocopy_done(const net_zerocopy* zc, uint32_t ticket)
+{
+    return zc_id_reached(zc->done_id, ticket);
+}
+
+int TCP_zerocopy_wait(net_zerocopy* zc, uint32_t ticket)
+{
+    while (!TCP_zerocopy_done(zc, ticket)) {
+        if (TCP_zerocopy_reap(zc, true) == -1) return -1;
+    }
+    return 0;
+}
+
+int TCP_send_zerocopy(net_zerocopy* zc, const char* data, unsigned total_size, uint32_t* ticket)
+{
+    if (!zc || !total_size || (total_size & 0x80000000) || !data) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+
+    net_header header;
+    memset(&header, 0, sizeof(header));
+    header.type = NET_MSG_DATA;
+    header.seq = net_next_seq();
+    header.length = total_size;
+
+    if (!zc->enabled || total_size < zc->threshold) {
+        // pinning pages costs more than copying small payloads
+        if (net_send_msg(zc->socket, &header, data, NULL) == -1) return -1;
+        zc->bytes_small += total_size;
+        if (ticket) *ticket = zc->next_id;
+        return total_size;
+    }
+
+#ifdef NET_HAVE_ZEROCOPY
+    uint64_t start_ns = net_now_ns();
+    char buffer[NET_MAXHEADER];
+    int header_len = net_encode_frame(buffer, &header);
+    if (header_len == -1) return -1;
+    net_iovec iov = { buffer, (size_t)header_len };
+    if (sendv_data(zc->socket, &iov, 1, NET_MSG_MORE, "Header") == -1) return -1;
+
+    net_stats* stats = net_stats_find(zc->socket);
+
+    unsigned send_left = total_size;
+    while (send_left) {
+        if (zc->next_id - zc->done_id >= NET_ZC_RING && TCP_zerocopy_reap(zc, true) == -1) {
+            TCP_close(zc->socket);
+            return -1;
+        }
+        net_count_syscall(stats);
+        ssize_t send_byte = send(zc->socket, data + total_size - send_left, send_left, MSG_ZEROCOPY);
+        if (send_byte == -1 && errno == ENOBUFS) {
+            // out of optmem for pinned pages: let completions drain, else copy
+            int reaped = TCP_zerocopy_reap(zc, zc->done_id != zc->next_id);
+            if (reaped > 0) continue;
+            if (reaped == 0) {
+                if (send_data(zc->socket, data + total_size - send_left, send_left, "Data") == -1) return -1;
+                zc->bytes_small += send_left;
+                break;
+            }
+        }
+        if (send_byte == -1) {
+            fprintf(stderr, "ERROR: Data message send failed with err %d\n", TCP_ERRNO);
+            TCP_close(zc->socket);
+            return -1;
+        }
+        net_count_bytes(stats, false, send_byte, send_left);
+        zc->pending_len[zc->next_id % NET_ZC_RING] = (uint32_t)send_byte;
+        zc->next_id++;
+        send_left -= (unsigned)send_byte;
+    }
+    net_count_msg(stats, false, total_size, start_ns);
+    if (ticket) *ticket = zc->next_id;
+    return total_size;
+#else
+    return -1;
+#endif
+}
+
+socket_t TCP_listen3(const char* port, bool ipv6, const net_sockopts* opts, bool verbose)
+{
+    if (net_local_scheme(port) != NET_LOCAL_NONE) return net_local_listen(port, opts, verbose);
+
     // parse
     if (strlen(port) >= NET_MAX_STRING) {
         fprintf(stderr, "ERROR: Invalid input!\n");
@@ -264,6 +896,8 @@ socket_t TCP_listen2(const char* port, bool ipv6, bool verbose)
     for (p = server_info; p != NULL; p = p->ai_next) {
         server_socket = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
         if (server_socket == INV_SOCKET) continue;
+        // before bind for SO_REUSEADDR, before listen so accepted sockets inherit buffer sizes
+        if (opts) TCP_set_sockopts(server_socket, opts);
         if (bind(server_socket, p->ai_addr, (socklen_t)p->ai_addrlen) != -1) break;
         TCP_close(server_socket);
     }
@@ -272,7 +906,7 @@ socket_t TCP_listen2(const char* port, bool ipv6, bool verbose)
         freeaddrinfo(server_info);
         return INV_SOCKET;
     }
-    if (listen(server_socket, 4) == -1) {
+    if (listen(server_socket, SOMAXCONN) == -1) {
         fprintf(stderr, "ERROR: Listen failed!\n");
         TCP_close(server_socket);
         freeaddrinfo(server_info);
@@ -294,7 +928,7 @@ socket_t TCP_listen2(const char* port, bool ipv6, bool verbose)
     return server_socket;
 }
 
-socket_t TCP_accept2(socket_t socket, bool verbose)
+socket_t TCP_accept3(socket_t socket, const net_sockopts* opts, bool verbose)
 {
     struct timeval timer = { NET_TIMEOUT, 0 };
 
@@ -307,7 +941,8 @@ socket_t TCP_accept2(socket_t socket, bool verbose)
         fprintf(stderr, "ERROR: Accept failed!\n");
         return INV_SOCKET;
     }
-    if (verbose) {
+    if (verbose && client_addr.ss_family == AF_UNIX) printf("MESSAGE: Accepted local connection.\n");
+    else if (verbose) {
         char host[NI_MAXHOST];
         char service[NI_MAXSERV];
         int err = getnameinfo((struct sockaddr*)&client_addr, sizeof(struct sockaddr_storage), host,
@@ -321,8 +956,456 @@ socket_t TCP_accept2(socket_t socket, bool verbose)
     if (setsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, (char*)&timer, sizeof(timer)) == -1) {
         fprintf(stderr, "WARNING: Accept inactivity timer failed with err %d!\n", TCP_ERRNO);
     }
+    if (opts) TCP_set_sockopts(client_socket, opts);
 
-    return client_socket;
+    return net_local_accepted(socket, client_socket);
+}
+
+int net_frame_header_size(void)
+{
+    return net_framing == NET_FRAMING_LEGACY ? NET_MAXINIT : NET_HEADER_SIZE;
+}
+
+// Size of the header starting with these NET_MAXINIT bytes.
+// Both framings are at least NET_MAXINIT long.
+int net_header_size(const unsigned char* buffer)
+{
+    return get_le32(buffer) == NET_MAGIC ? NET_HEADER_SIZE : NET_MAXINIT;
+}
+
+// Parse a complete header of net_header_size() bytes.
+// returns 0, -1 if malformed
+int net_decode_header(unsigned char* buffer, net_header* header)
+{
+    memset(header, 0, sizeof(*header));
+
+    if (get_le32(buffer) != NET_MAGIC) {
+        // legacy: NUL padded decimal string
+        buffer[NET_MAXINIT - 1] = 0;
+        header->length = strtoul((const char*)buffer, NULL, 10);
+        if (!header->length) {
+            fprintf(stderr, "ERROR: Initial message parse failed!\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    if (buffer[4] != NET_VERSION) {
+        fprintf(stderr, "ERROR: Unsupported protocol version %d!\n", buffer[4]);
+        return -1;
+    }
+    header->version = buffer[4];
+    header->type = buffer[5];
+    header->flags = get_le16(buffer + 6);
+    header->seq = get_le32(buffer + 8);
+    header->checksum = get_le32(buffer + 12);
+    header->length = get_le64(buffer + 16);
+    return 0;
+}
+
+// Receive header, detecting binary or legacy framing from the first bytes.
+// returns 0, -1 for error (with socket cleanup)
+int recv_header(socket_t socket, net_header* header)
+{
+    unsigned char buffer[NET_MAXHEADER];
+    if (recv_data(socket, (char*)buffer, NET_MAXINIT, "Header") == -1) return -1;
+    int size = net_header_size(buffer);
+    if (size > NET_MAXINIT &&
+        recv_data(socket, (char*)buffer + NET_MAXINIT, size - NET_MAXINIT, "Header") == -1) return -1;
+    if (net_decode_header(buffer, header) == -1) {
+        TCP_close(socket);
+        return -1;
+    }
+    return 0;
+}
+
+int recv_raw_size(socket_t socket, net_header* header, uint64_t* wire)
+{
+    *wire = 0;
+    if (!(header->flags & NET_FLAG_COMPRESSED)) return 0;
+    unsigned char prefix[NET_COMPRESS_PREFIX];
+    if (header->length < NET_COMPRESS_PREFIX || (header->length & ~(uint64_t)0x7fffffff)) {
+        fprintf(stderr, "ERROR: Malformed compressed message!\n");
+        TCP_close(socket);
+        return -1;
+    }
+    if (recv_data(socket, (char*)prefix, NET_COMPRESS_PREFIX, "Data") == -1) return -1;
+    int64_t raw = net_inflated_size((const char*)prefix, (size_t)header->length);
+    if (raw == -1) {
+        fprintf(stderr, "ERROR: Malformed compressed message!\n");
+        TCP_close(socket);
+        return -1;
+    }
+    *wire = header->length - NET_COMPRESS_PREFIX;
+    header->length = (uint64_t)raw;
+    return 0;
+}
+
+int recv_payload(socket_t socket, const net_header* header, uint64_t wire, char* data)
+{
+    uint64_t start_ns = net_now_ns();
+    if (!(header->flags & NET_FLAG_COMPRESSED)) {
+        if (header->length && recv_data(socket, data, header->length, "Data") == -1) return -1;
+        if (!net_checksum_ok(header, data, (size_t)header->length)) {
+            TCP_close(socket);
+            return -1;
+        }
+        net_count_msg(net_stats_find(socket), true, header->length, start_ns);
+        return header->flags & NET_FLAG_TRACED ? net_trace_recv(socket, header, start_ns) : 0;
+    }
+    // net_inflate() wants the prefix back in front
+    char* packed = (char*)malloc((size_t)wire + NET_COMPRESS_PREFIX);
+    if (!packed) {
+        fprintf(stderr, "ERROR: Out of memory!\n");
+        TCP_close(socket);
+        return -1;
+    }
+    put_le32((unsigned char*)packed, (uint32_t)header->length);
+    if (wire && recv_data(socket, packed + NET_COMPRESS_PREFIX, wire, "Data") == -1) {
+        free(packed);
+        return -1;
+    }
+    if (!net_checksum_ok(header, packed, (size_t)wire + NET_COMPRESS_PREFIX)) {
+        free(packed);
+        TCP_close(socket);
+        return -1;
+    }
+    int ret = net_inflate(packed, (size_t)wire + NET_COMPRESS_PREFIX, data, (size_t)header->length);
+    free(packed);
+    if (ret == -1) {
+        fprintf(stderr, "ERROR: Malformed compressed message!\n");
+        TCP_close(socket);
+        return -1;
+    }
+    net_count_msg(net_stats_find(socket), true, header->length, start_ns);
+    return header->flags & NET_FLAG_TRACED ? net_trace_recv(socket, header, start_ns) : 0;
+}
+
+// TCP peek loop, waits until size bytes are queued without consuming them.
+// returns 0, -1 for error (with socket cleanup)
+static int peek_data(socket_t socket, char* data, int size, const char* log_name)
+{
+    net_shm* shm = net_shm_get(socket);
+    if (shm) return net_shm_recv(shm, data, size, true, log_name) == -1 ? -1 : 0;
+    net_stats* stats = net_stats_find(socket);
+    while (true) {
+#ifdef _WIN32
+        // winsock rejects MSG_PEEK | MSG_WAITALL, wait for data in WSAPoll instead
+        if (net_poll_socket(socket, NET_POLL_IN, -1) == -1) {
+            fprintf(stderr, "ERROR: %s message peek failed with err %d\n", log_name, TCP_ERRNO);
+            TCP_close(socket);
+            return -1;
+        }
+        net_count_syscall(stats);
+        int recv_byte = recv(socket, data, size, MSG_PEEK);
+#else
+        net_count_syscall(stats);
+        int recv_byte = recv(socket, data, size, MSG_PEEK | MSG_WAITALL);
+#endif
+        if (recv_byte <= 0) {
+            if (recv_byte == 0) fprintf(stderr, "ERROR: %s message peek failed, connection closed\n", log_name);
+            else fprintf(stderr, "ERROR: %s message peek failed with err %d\n", log_name, TCP_ERRNO);
+            TCP_close(socket);
+            return -1;
+        }
+        if (recv_byte == size) return 0;
+#ifdef _WIN32
+        // the bytes already there keep the socket readable, so wait a tick
+        // for the rest instead of spinning on the poll
+        Sleep(1);
+#endif
+    }
+}
+
+int TCP_recv_into(socket_t socket, char* buf, size_t capacity, size_t* needed)
+{
+    if (!buf && capacity) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+
+    // peek the header so nothing is consumed if the buffer is too small
+    unsigned char buffer[NET_MAXHEADER];
+    if (peek_data(socket, (char*)buffer, NET_MAXINIT, "Header") == -1) return -1;
+    int size = net_header_size(buffer);
+    if (size > NET_MAXINIT && peek_data(socket, (char*)buffer, size, "Header") == -1) return -1;
+    net_header header;
+    if (net_decode_header(buffer, &header) == -1) {
+        TCP_close(socket);
+        return -1;
+    }
+    if (header.length & ~(uint64_t)0x7fffffff) {
+        fprintf(stderr, "ERROR: Message of %llu bytes too large!\n", (unsigned long long)header.length);
+        TCP_close(socket);
+        return -1;
+    }
+    size_t raw = (size_t)header.length;
+    if (header.flags & NET_FLAG_COMPRESSED) {
+        // the raw size follows the header
+        unsigned char peeked[NET_MAXHEADER + NET_COMPRESS_PREFIX];
+        int64_t inflated = -1;
+        if (header.length >= NET_COMPRESS_PREFIX) {
+            if (peek_data(socket, (char*)peeked, size + NET_COMPRESS_PREFIX, "Header") == -1) return -1;
+            inflated = net_inflated_size((const char*)peeked + size, (size_t)header.length);
+        }
+        if (inflated == -1) {
+            fprintf(stderr, "ERROR: Malformed compressed message!\n");
+            TCP_close(socket);
+            return -1;
+        }
+        raw = (size_t)inflated;
+    }
+    if (needed) *needed = raw;
+    if (raw > capacity) return NET_ERR_SPACE;
+
+    if (recv_data(socket, (char*)buffer, size, "Header") == -1) return -1;
+    uint64_t wire;
+    if (recv_raw_size(socket, &header, &wire) == -1) return -1;
+    if (recv_payload(socket, &header, wire, buf) == -1) return -1;
+    return (int)header.length;
+}
+
+void net_buffer_init(net_buffer* buf)
+{
+    memset(buf, 0, sizeof(*buf));
+}
+
+void net_buffer_free(net_buffer* buf)
+{
+    free(buf->data);
+    net_buffer_init(buf);
+}
+
+bool net_buffer_reserve(net_buffer* buf, size_t capacity)
+{
+    if (capacity <= buf->capacity) return true;
+    // grow geometrically so slowly increasing sizes settle quickly
+    size_t new_capacity = MAX(capacity, buf->capacity + buf->capacity / 2);
+    char* data = (char*)realloc(buf->data, new_capacity);
+    if (!data) return false;
+    buf->data = data;
+    buf->capacity = new_capacity;
+    return true;
+}
+
+int TCP_recv_buffer(socket_t socket, net_buffer* buf)
+{
+    if (!buf) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    buf->size = 0;
+
+    uint64_t wire;
+    if (recv_header(socket, &buf->header) == -1) return -1;
+    if (recv_raw_size(socket, &buf->header, &wire) == -1) return -1;
+    if (buf->header.length & ~(uint64_t)0x7fffffff) {
+        fprintf(stderr, "ERROR: Message of %llu bytes too large!\n", (unsigned long long)buf->header.length);
+        TCP_close(socket);
+        return -1;
+    }
+    if (!net_buffer_reserve(buf, (size_t)buf->header.length)) {
+        fprintf(stderr, "ERROR: Out of memory!\n");
+        TCP_close(socket);
+        return -1;
+    }
+    if (recv_payload(socket, &buf->header, wire, buf->data) == -1) return -1;
+    buf->size = (size_t)buf->header.length;
+    return (int)buf->size;
+}
+
+int TCP_recv_msg(socket_t socket, net_header* header, char** data_ptr)
+{
+    if (!header || !data_ptr) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    *data_ptr = NULL;
+
+    uint64_t wire;
+    if (recv_header(socket, header) == -1) return -1;
+    if (recv_raw_size(socket, header, &wire) == -1) return -1;
+    if (header->length & ~(uint64_t)0x7fffffff) {
+        fprintf(stderr, "ERROR: Message of %llu bytes too large!\n", (unsigned long long)header->length);
+        TCP_close(socket);
+        return -1;
+    }
+    if (!header->length && !wire) return 0;
+
+    unsigned total_size = (unsigned)header->length;
+    char* data = (char*)malloc(total_size ? total_size : 1);
+    if (!data) {
+        fprintf(stderr, "ERROR: Out of memory!\n");
+        TCP_close(socket);
+        return -1;
+    }
+    if (recv_payload(socket, header, wire, data) == -1) {
+        free(data);
+        return -1;
+    }
+    if (!total_size) {
+        free(data);
+        return 0;
+    }
+
+    *data_ptr = data;
+    return total_size;
+}
+
+int64_t TCP_recv64(socket_t socket, net_header* header, char** data_ptr)
+{
+    if (!data_ptr) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    *data_ptr = NULL;
+
+    net_header h;
+    uint64_t wire;
+    if (!header) header = &h;
+    if (recv_header(socket, header) == -1) return -1;
+    if (recv_raw_size(socket, header, &wire) == -1) return -1;
+    if (header->length > (uint64_t)(SIZE_MAX >> 1)) {
+        fprintf(stderr, "ERROR: Message of %llu bytes too large for address space!\n", (unsigned long long)header->length);
+        TCP_close(socket);
+        return -1;
+    }
+    if (!header->length && !wire) return 0;
+
+    char* data = (char*)malloc(header->length ? (size_t)header->length : 1);
+    if (!data) {
+        fprintf(stderr, "ERROR: Out of memory!\n");
+        TCP_close(socket);
+        return -1;
+    }
+    if (recv_payload(socket, header, wire, data) == -1) {
+        free(data);
+        return -1;
+    }
+    if (!header->length) {
+        free(data);
+        return 0;
+    }
+
+    *data_ptr = data;
+    return (int64_t)header->length;
+}
+
+int64_t TCP_recv_chunked(socket_t socket, char* chunk, size_t chunk_size, net_chunk_fn on_chunk, void* user, net_header* header)
+{
+    if (!chunk || !chunk_size || !on_chunk) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+
+    net_header h;
+    uint64_t wire;
+    if (!header) header = &h;
+    if (recv_header(socket, header) == -1) return -1;
+    if (recv_raw_size(socket, header, &wire) == -1) return -1;
+    if (header->flags & NET_FLAG_COMPRESSED) {
+        // inflate whole (at most 2 GiB), then hand it out chunk by chunk
+        char* data = (char*)malloc(header->length ? (size_t)header->length : 1);
+        if (!data) {
+            fprintf(stderr, "ERROR: Out of memory!\n");
+            TCP_close(socket);
+            return -1;
+        }
+        if (recv_payload(socket, header, wire, data) == -1) {
+            free(data);
+            return -1;
+        }
+        for (uint64_t offset = 0; offset < header->length; offset += chunk_size) {
+            size_t len = (size_t)MIN(header->length - offset, (uint64_t)chunk_size);
+            memcpy(chunk, data + offset, len);
+            if (on_chunk(user, chunk, len, offset, header->length) != 0) {
+                fprintf(stderr, "ERROR: Chunk callback aborted receive!\n");
+                free(data);
+                TCP_close(socket);
+                return -1;
+            }
+        }
+        free(data);
+        return (int64_t)header->length;
+    }
+
+    uint64_t start_ns = net_now_ns();
+    uint64_t offset = 0;
+    uint32_t crc = 0;
+    while (offset < header->length) {
+        size_t len = (size_t)MIN(header->length - offset, (uint64_t)chunk_size);
+        if (recv_data(socket, chunk, len, "Data") == -1) return -1;
+        if (header->flags & NET_FLAG_CHECKSUM) crc = TCP_crc32(crc, chunk, len);
+        if (on_chunk(user, chunk, len, offset, header->length) != 0) {
+            // rest of the message is still queued, the stream is unusable
+            fprintf(stderr, "ERROR: Chunk callback aborted receive!\n");
+            TCP_close(socket);
+            return -1;
+        }
+        offset += len;
+    }
+    if ((header->flags & NET_FLAG_CHECKSUM) && crc != header->checksum) {
+        // the chunks are already handed out, but the caller learns of it
+        fprintf(stderr, "ERROR: Payload checksum mismatch!\n");
+        TCP_close(socket);
+        return -1;
+    }
+    net_count_msg(net_stats_find(socket), true, header->length, start_ns);
+    if ((header->flags & NET_FLAG_TRACED) && net_trace_recv(socket, header, start_ns) == -1) return -1;
+    return (int64_t)header->length;
+}
+
+int64_t TCP_send64(socket_t socket, const char* data, uint64_t total_size)
+{
+    if (!total_size || !data || total_size > (uint64_t)(SIZE_MAX >> 1)) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    net_header header;
+    memset(&header, 0, sizeof(header));
+    header.type = NET_MSG_DATA;
+    header.seq = net_next_seq();
+    header.length = total_size;
+    net_iovec iov = { data, (size_t)total_size };
+    return sendv_msg(socket, &header, &iov, 1, NULL);
+}
+
+int64_t TCP_send_chunked(socket_t socket, uint64_t total_size, char* chunk, size_t chunk_size, net_fill_fn fill, void* user)
+{
+    if (!total_size || !chunk || !chunk_size || !fill) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+
+    uint64_t start_ns = net_now_ns();
+    net_header header;
+    memset(&header, 0, sizeof(header));
+    header.type = NET_MSG_DATA;
+    header.seq = net_next_seq();
+    header.length = total_size;
+    char buffer[NET_MAXHEADER];
+    int header_len = net_encode_frame(buffer, &header);
+    if (header_len == -1) return -1;
+
+    // header rides along with the first chunk
+    net_iovec iov[2] = { { buffer, (size_t)header_len }, { chunk, 0 } };
+    uint64_t offset = 0;
+    while (offset < total_size) {
+        size_t len = (size_t)MIN(total_size - offset, (uint64_t)chunk_size);
+        if (fill(user, chunk, len, offset, total_size) != 0) {
+            fprintf(stderr, "ERROR: Chunk callback aborted send!\n");
+            // nothing sent yet, the connection is still usable; otherwise
+            // the receiver expects the full length and the stream is lost
+            if (offset) TCP_close(socket);
+            return -1;
+        }
+        iov[1].len = len;
+        int first = offset ? 1 : 0;
+        if (sendv_data(socket, iov + first, 2 - first, 0, "Data") == -1) return -1;
+        offset += len;
+    }
+    net_count_msg(net_stats_find(socket), false, total_size, start_ns);
+    return (int64_t)total_size;
 }
 
 int TCP_recv2(socket_t socket, char** data_ptr, bool verbose) 
@@ -336,28 +1419,18 @@ int TCP_recv2(socket_t socket, char** data_ptr, bool verbose)
     if (verbose) 
         printf("MESSAGE: Receive start.\n");
 
-    // size of data
-    char buffer[NET_MAXINIT];
-    memset(buffer, 0, NET_MAXINIT);
-    if (recv_data(socket, buffer, NET_MAXINIT, "Initial") == -1) return -1;
-    unsigned total_size = atoi(buffer);
+    net_header header;
+    int total_size = TCP_recv_msg(socket, &header, data_ptr);
+    if (total_size == -1) return -1;
     if (!total_size) {
-        fprintf(stderr, "ERROR: Initial message parse failed!\n");
+        fprintf(stderr, "ERROR: Received empty message!\n");
         TCP_close(socket);
         return -1;
     }
 
-    // data
-    char* data = (char*)malloc(total_size);  
-    if (recv_data(socket, data, total_size, "Data") == -1) {
-        free(data);
-        return -1;
-    }
-
     if (verbose) 
         printf("MESSAGE: Received %d bytes\n", total_size);
 
-    *data_ptr = data;
     return total_size;
 }
 
@@ -373,6 +1446,18 @@ socket_t TCP_accept(socket_t socket) {
     return TCP_accept2(socket, false);
 }
 
+socket_t TCP_connect2(const char* addr, const char* port, bool verbose) {
+    return TCP_connect3(addr, port, NULL, verbose);
+}
+
+socket_t TCP_listen2(const char* port, bool ipv6, bool verbose) {
+    return TCP_listen3(port, ipv6, NULL, verbose);
+}
+
+socket_t TCP_accept2(socket_t socket, bool verbose) {
+    return TCP_accept3(socket, NULL, verbose);
+}
+
 int TCP_send(socket_t socket, const char* data, unsigned total_size) {
     return TCP_send2(socket, data, total_size, false);
 }
@@ -7,6 +7,8 @@
 #define IO_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,10 +20,57 @@ bool write_bmp(const char* filename, const void* data, int width, int height, in
 
 // Write .png. Slower to write but produces smaller files.
 // Channels = 3 for RGB, 4 for RGBA.
+// Encodes on one thread per core with lazy matching, see write_png_ex().
 bool write_png(const char* filename, const void* data, int width, int height, int channels);
 
+// Where a PNG encode spent its time. Stage times are summed over threads.
+typedef struct png_stats {
+    double filter_sec;
+    double deflate_sec; // Adler-32 included
+    double crc_sec;
+    double wall_sec;    // whole encode
+    int threads;
+    int bands;          // row bands deflated independently
+    size_t bytes;       // encoded size
+} png_stats;
+
+// Instruction sets for the PNG row filters, see png_options.simd.
+#define PNG_SIMD_AUTO 0 // best the CPU supports
+#define PNG_SIMD_SCALAR 1
+#define PNG_SIMD_SSE2 2
+#define PNG_SIMD_AVX2 3
+#define PNG_SIMD_NEON 4 // when built for it (-mfpu=neon, AArch64)
+
+// Deflate tiers, see png_options.deflate. All use dynamic Huffman codes.
+#define PNG_DEFLATE_LAZY 0 // lazy matching, best ratio (default)
+#define PNG_DEFLATE_FAST 1 // greedy matching, for preview sequences
+#define PNG_DEFLATE_RLE 2  // runs of one byte only, fastest; suits sky-heavy frames
+
+typedef struct png_options {
+    int threads;      // 0 for one per core
+    int level;        // match search effort, hash chains 2*level (lazy) or level/2 (fast) deep, 0 for 8
+    png_stats* stats; // optional, filled in on success
+    int simd;         // PNG_SIMD_*, every choice encodes the same bytes
+    int deflate;      // PNG_DEFLATE_*
+} png_options;
+
+// Whether the row filters can run with PNG_SIMD_* simd here.
+bool png_simd_supported(int simd);
+
+// Write .png with the parallel encoder: row bands are filtered and deflated
+// on their own threads and joined into one standard PNG.
+// options may be NULL for defaults.
+bool write_png_ex(const char* filename, const void* data, int width, int height, int channels,
+    const png_options* options);
+
+// Encode .png into memory as write_png_ex(). Channels 1 to 4.
+// Returns the file image (free()) of *out_len bytes, NULL on failure.
+unsigned char* encode_png(const void* data, int width, int height, int channels, const png_options* options,
+    size_t* out_len);
+
 
 #define NET_MAX_STRING 40 // max input string, for security
+#define NET_MAX_MESSAGE (256ull << 20) // default payload cap, see TCP_set_max_message()
 
 // Define these types manually to avoid including
 // noisy Windows headers that mess up C++ compile
@@ -38,6 +87,243 @@ typedef int socket_t;
 #define INV_SOCKET (-1)
 #endif
 
+// Wire framing.
+// Every message starts with a fixed 24-byte little-endian header:
+//   magic(4) version(1) type(1) flags(2) seq(4) checksum(4) length(8)
+// Legacy framing is the original 11-byte ASCII decimal size prefix.
+// Receivers accept both, senders use the binary header unless legacy is selected.
+// Messages flagged NET_FLAG_TRACED are followed by NET_TRACE_SIZE bytes of
+// sender timestamps (not counted in length), see TCP_send_traced().
+// checksum is the CRC-32 of the payload as sent (compressed, if it is) for
+// messages flagged NET_FLAG_CHECKSUM and 0 otherwise, see TCP_set_checksum().
+#define NET_MAGIC 0x31545246u // "FRT1" on the wire
+#define NET_VERSION 1
+#define NET_HEADER_SIZE 24
+#define NET_TRACE_SIZE 32
+
+#define NET_FRAMING_BINARY 0
+#define NET_FRAMING_LEGACY 1 // for HPS builds that predate the binary header
+
+// Message types
+#define NET_MSG_DATA 0 // plain payload, what TCP_send() sends
+#define NET_MSG_FRAME_KEY 1   // whole frame, see TCP_send_frame()
+#define NET_MSG_FRAME_DELTA 2 // changes since the previous frame
+#define NET_MSG_TILE 3        // one tile of a frame, see TCP_send_tiles()
+#define NET_MSG_STRIPE_HELLO 4 // joins a connection to a stripe group, see TCP_stripe_connect()
+#define NET_MSG_STRIPE 5       // one connection's share of a striped transfer
+#define NET_MSG_CLOCK 6        // clock offset probe, see TCP_clock_sync()
+
+// Header flags
+#define NET_FLAG_COMPRESSED 0x0001 // payload is LZ compressed, see TCP_set_compression()
+#define NET_FLAG_TRACED 0x0002     // sender timestamps follow the payload, see TCP_send_traced()
+#define NET_FLAG_CHECKSUM 0x0004   // header carries the payload CRC-32, see TCP_set_checksum()
+
+typedef struct net_header {
+    uint8_t version;   // NET_VERSION, 0 if received with legacy framing
+    uint8_t type;      // NET_MSG_*
+    uint16_t flags;    // NET_FLAG_*
+    uint32_t seq;      // sender sequence id
+    uint32_t checksum; // payload CRC-32 with NET_FLAG_CHECKSUM
+    uint64_t length;   // payload size in bytes (after inflating, for received messages)
+} net_header;
+
+// Returned by TCP_recv_into() when the message does not fit.
+#define NET_ERR_SPACE (-2)
+
+// Reusable receive buffer.
+// Grows only when a message does not fit, so steady-state
+// reception of same-sized frames does no heap work.
+typedef struct net_buffer {
+    char* data;
+    size_t size;       // payload size of the last message
+    size_t capacity;   // allocated size of data
+    net_header header; // header of the last message
+} net_buffer;
+
+// Payload fragment for vectored sends.
+typedef struct net_iovec {
+    const void* base;
+    size_t len;
+} net_iovec;
+
+#define NET_ZC_RING 256 // in-flight zero-copy sends tracked per socket
+
+// Zero-copy send state for one socket (MSG_ZEROCOPY on Linux).
+// Payload pages are pinned instead of copied, so a buffer must not be
+// modified until its send completes, see TCP_zerocopy_done().
+typedef struct net_zerocopy {
+    socket_t socket;
+    size_t threshold;   // payloads below this are copied normally
+    bool enabled;       // kernel accepted SO_ZEROCOPY
+    uint32_t next_id;   // notification id of the next zero-copy syscall
+    uint32_t done_id;   // all ids below this have completed
+    uint32_t pending_len[NET_ZC_RING]; // bytes per in-flight id
+    uint64_t bytes_zerocopy; // completed without a copy
+    uint64_t bytes_copied;   // completed, but the kernel copied anyway (e.g. loopback)
+    uint64_t bytes_small;    // copied because below threshold or unsupported
+} net_zerocopy;
+
+// Chunked receive callback, see TCP_recv_chunked().
+// chunk holds len payload bytes starting at offset of total.
+// Return 0 to continue, nonzero to abort (closes the socket).
+typedef int (*net_chunk_fn)(void* user, const char* chunk, size_t len, uint64_t offset, uint64_t total);
+
+// Chunked send callback, see TCP_send_chunked().
+// Fill chunk with len payload bytes starting at offset of total.
+// Return 0 to continue, nonzero to abort (closes the socket unless offset is 0).
+typedef int (*net_fill_fn)(void* user, char* chunk, size_t len, uint64_t offset, uint64_t total);
+
+// Non-blocking multi-client server, see TCP_server_create().
+typedef struct net_server net_server;
+typedef struct net_conn net_conn;
+
+typedef struct net_server_callbacks {
+    // New client accepted (optional). Return false to reject it.
+    bool (*on_accept)(net_server* server, net_conn* conn, void* user);
+    // Complete message received. data is only valid during the call.
+    void (*on_message)(net_server* server, net_conn* conn, const net_header* header, const char* data, void* user);
+    // Connection closed by peer, error or TCP_server_close() (optional).
+    // conn is freed after this returns.
+    void (*on_close)(net_server* server, net_conn* conn, void* user);
+} net_server_callbacks;
+
+// Asynchronous socket operations, see TCP_reactor_create().
+typedef struct net_reactor net_reactor;
+typedef struct net_async net_async; // operation handle
+
+// Operation status
+#define NET_ASYNC_PENDING 0
+#define NET_ASYNC_DONE 1
+#define NET_ASYNC_FAILED 2 // result is -1
+
+// Completion callback, runs inside TCP_reactor_poll().
+// op is released after this returns.
+typedef void (*net_async_fn)(net_reactor* reactor, net_async* op, void* user);
+
+// Client connection pool, see TCP_pool_create().
+typedef struct net_pool net_pool;
+
+typedef struct net_pool_stats {
+    uint64_t connects; // new connections made
+    uint64_t reuses;   // idle connections handed out again
+    uint64_t stale;    // idle connections found closed or expired
+    uint64_t retries;  // exchanges repeated after a reused connection failed
+} net_pool_stats;
+
+// Socket tuning, see TCP_set_sockopts().
+// Zero/false fields leave the system default in place.
+typedef struct net_sockopts {
+    bool nodelay;       // TCP_NODELAY: no Nagle delay for small or trailing segments
+    bool quickack;      // TCP_QUICKACK: ACK right away (Linux, the kernel may fall back to delayed ACKs)
+    bool cork;          // TCP_CORK/TCP_NOPUSH: send only full segments until TCP_flush()
+    bool reuseaddr;     // SO_REUSEADDR: listen sockets can rebind while old connections linger
+    int sndbuf;         // SO_SNDBUF bytes (the kernel may clamp or double it)
+    int rcvbuf;         // SO_RCVBUF bytes
+    int notsent_lowat;  // TCP_NOTSENT_LOWAT bytes: limit unsent data queued in the kernel
+    int busy_poll;      // SO_BUSY_POLL microseconds: spin on the device queue when receiving (Linux)
+} net_sockopts;
+
+// Delta-encoded frame stream, see TCP_frame_stream_create().
+typedef struct net_frame_stream net_frame_stream;
+
+typedef struct net_frame_stats {
+    uint64_t frames;     // frames sent / received
+    uint64_t keyframes;  // of which sent whole
+    uint64_t bytes_raw;  // frame bytes
+    uint64_t bytes_wire; // message bytes, headers included (before TCP_set_compression())
+} net_frame_stats;
+
+// Tile orders for TCP_send_tiles()
+#define NET_TILES_ROW_MAJOR 0  // left to right, top to bottom
+#define NET_TILES_CENTER_OUT 1 // nearest the frame centre first
+#define NET_TILES_MORTON 2     // Z-order, fills the frame in growing square blocks
+
+typedef struct net_tile {
+    unsigned frame_width, frame_height, channels;
+    unsigned x, y;          // top-left pixel of the tile
+    unsigned width, height; // smaller at the right and bottom edges
+    uint32_t index;         // position in sending order
+    uint32_t count;         // tiles in the frame
+} net_tile;
+
+// Tile callback, see TCP_recv_tiles().
+// frame holds every tile received so far, tile is the one that just landed.
+// Return 0 to continue, nonzero to abort (closes the socket).
+typedef int (*net_tile_fn)(void* user, const net_tile* tile, const char* frame);
+
+// Group of parallel connections for striped transfers, see TCP_stripe_connect().
+typedef struct net_stripe net_stripe;
+
+#define NET_STRIPE_MAX 16 // connections per group
+
+#define NET_HIST_BUCKETS 32
+#define NET_STATS_SOCKETS 256 // sockets with their own counters, the rest count in the totals only
+
+// One direction of net_stats.
+// Histograms are log2-bucketed: bucket i counts messages with a value in
+// [2^i, 2^(i+1)), bucket 0 also those below 1. See TCP_hist_percentile().
+typedef struct net_dir_stats {
+    uint64_t bytes;    // moved by send/recv calls, headers included
+    uint64_t messages; // complete messages (TCP_server_send(): queued)
+    uint64_t partial;  // calls that moved some but not all of the bytes asked
+    // per message: sends from the call to the last byte handed over,
+    // receives from the header to the last byte
+    uint64_t latency_us[NET_HIST_BUCKETS];
+    uint64_t throughput_mbs[NET_HIST_BUCKETS]; // payload bytes per microsecond over that time
+} net_dir_stats;
+
+// Transfer statistics, see TCP_get_stats().
+typedef struct net_stats {
+    uint64_t syscalls; // send/recv-family syscalls (per socket: io_uring operations, totals: io_uring_enter)
+    net_dir_stats send;
+    net_dir_stats recv;
+} net_stats;
+
+#define NET_TRACE_LOG 64 // traced messages remembered per socket
+
+// Timestamps of one traced message in ns of TCP_clock_ns(), see TCP_trace_get().
+// Sender stamps are shifted to the receiver's clock once TCP_clock_sync()
+// ran on the connection; until then they are on the sender's clock and only
+// comparable with each other.
+typedef struct net_trace {
+    uint32_t seq;   // header seq
+    uint8_t type;   // NET_MSG_*
+    bool synced;    // sender stamps are on the receiver's clock
+    uint64_t length; // payload size (after inflating)
+    // sender
+    int64_t capture;    // frame captured or rendered
+    int64_t encode;     // frame encoded
+    int64_t send_start; // send called
+    int64_t send_end;   // message built, handed to the transport in one write
+    // receiver
+    int64_t arrival;  // header received
+    int64_t received; // last byte received
+    int64_t consumed; // TCP_trace_consume(), 0 until then
+} net_trace;
+
+// Where the time of a traced message went, in ns, -1 if not known
+// (stages across machines need TCP_clock_sync(), consume TCP_trace_consume()).
+// The stages are back to back, so they add up to total.
+typedef struct net_latency {
+    int64_t encode;  // capture to encode
+    int64_t queue;   // encode to send start
+    int64_t send;    // send start to send end (compression, checksum)
+    int64_t network; // send end to last byte received
+    int64_t consume; // last byte received to consumed
+    int64_t total;   // capture to consumed
+} net_latency;
+
+// Presets for TCP_sockopts_preset()
+#define NET_SOCKOPTS_DEFAULT 0     // system defaults
+#define NET_SOCKOPTS_LOW_LATENCY 1 // small control messages and round trips
+#define NET_SOCKOPTS_BULK_FRAME 2  // streaming whole frames
+
+// Transport backends, see TCP_set_backend().
+#define NET_BACKEND_SOCKETS 0 // blocking send/recv syscalls (default)
+#define NET_BACKEND_URING 1   // io_uring (Linux 5.6+, multishot server needs 6.0+)
+
+#define NET_URING_MAXFIXED 16 // max registered buffers per thread
+
 #ifdef _WIN32
 // Initialize TCP on Windows.
 // Must only be called once ever unless it fails.
@@ -84,6 +370,527 @@ void TCP_wrshutdown(socket_t socket);
 void TCP_close(socket_t socket);
 
 
+// Select framing used by all following sends (process-wide).
+// NET_FRAMING_BINARY (default) or NET_FRAMING_LEGACY.
+void TCP_set_framing(int framing);
+
+// Largest payload (raw size for compressed messages) accepted by
+// TCP_recv_async() and TCP_server_create() connections (process-wide,
+// 0 restores the NET_MAX_MESSAGE default). Larger messages fail the
+// receive or close that server connection before anything is allocated.
+void TCP_set_max_message(uint64_t max_size);
+
+// Compress payloads of at least min_size bytes sent with TCP_send(),
+// TCP_send_msg() and TCP_server_send() (process-wide, 0 disables, the default).
+// Uses a fast in-tree LZ codec and only when it shrinks the payload; such
+// messages carry NET_FLAG_COMPRESSED. Worth it on links slower than about
+// 1 Gbit. Scatter-gather, file, zerocopy and async sends are never compressed.
+// Receivers always inflate compressed messages, header->length is the raw size.
+// Not available with legacy framing.
+void TCP_set_compression(unsigned min_size);
+
+// Attach a CRC-32 of the payload to messages sent with TCP_send(),
+// TCP_send_msg(), TCP_sendv() and TCP_server_send() (process-wide, off by
+// default). Such messages carry NET_FLAG_CHECKSUM; setting the flag on a
+// header asks for a checksum on that message only. File, chunked, zerocopy,
+// async and shm sends go without. Receivers check every flagged message and
+// fail the receive (closing the socket) on a mismatch. TCP's 16-bit checksum
+// lets some corruption through on long frame streams.
+// Not available with legacy framing.
+void TCP_set_checksum(bool enable);
+
+// Running CRC-32 (as zlib and PNG, start with 0) and Adler-32 (as zlib,
+// start with 1) of len bytes. Folded with PCLMULQDQ or the ARMv8 CRC
+// instructions and vectorized with AVX2/SSSE3/NEON where available, with
+// slice-by-8 and scalar fallbacks that give the same values.
+uint32_t TCP_crc32(uint32_t crc, const void* data, size_t len);
+uint32_t TCP_adler32(uint32_t adler, const void* data, size_t len);
+
+// Names of the CRC-32 and Adler-32 kernels picked for this CPU, e.g. "pclmul" and "avx2".
+void TCP_checksum_kernels(const char** crc, const char** adler);
+
+// Client/Server: Send a message with explicit header fields.
+// header->length is the payload size; magic and version are filled in.
+// Zero-length payloads are allowed (data may be NULL).
+// Legacy framing can only carry NET_MSG_DATA without flags.
+// Returns send data size (-1 for failure)
+// Closes socket on failure.
+int TCP_send_msg(socket_t socket, const net_header* header, const char* data);
+
+// Client/Server: Send one message whose payload is the fragments in order.
+// The header and all fragments go out in as few syscalls as possible
+// (sendmsg/WSASend), so several arrays can be sent without concatenating them.
+// Total size must be in range (0B, 2GiB).
+// Returns send data size (-1 for failure)
+// Closes socket on failure.
+int TCP_sendv(socket_t socket, const net_iovec* iov, int iovcnt);
+
+// TCP_sendv() with explicit header fields; header->length is computed.
+int TCP_sendv_msg(socket_t socket, const net_header* header, const net_iovec* iov, int iovcnt);
+
+// Client/Server: TCP_send() for payloads of any size, including >2GiB.
+// Returns send data size (-1 for failure)
+// Closes socket on failure.
+int64_t TCP_send64(socket_t socket, const char* data, uint64_t total_size);
+
+// Client/Server: Send a total_size message produced chunk by chunk.
+// fill is called with consecutive regions of at most chunk_size bytes,
+// written into the caller's chunk buffer, so the payload never has to
+// exist in one contiguous allocation.
+// Returns send data size (-1 for failure)
+// Closes socket on failure, except when fill aborts before anything was sent.
+int64_t TCP_send_chunked(socket_t socket, uint64_t total_size, char* chunk, size_t chunk_size, net_fill_fn fill, void* user);
+
+// Client/Server: Send a file region as one message.
+// length 0 sends from offset to end of file.
+// The body is streamed with sendfile(2) where available, else read/send
+// in fixed chunks, so memory use does not depend on file size.
+// Returns send data size (-1 for failure)
+// Closes socket on send failure.
+int64_t TCP_send_file(socket_t socket, const char* path, uint64_t offset, uint64_t length);
+
+#ifndef _WIN32
+// TCP_send_file() from an open file descriptor.
+// The file position is unspecified afterwards.
+int64_t TCP_send_fd(socket_t socket, int fd, uint64_t offset, uint64_t length);
+#endif
+
+// Enable zero-copy sends on socket.
+// Returns false if unsupported; sends through zc then fall back to copying.
+bool TCP_zerocopy_init(net_zerocopy* zc, socket_t socket, size_t threshold);
+
+// Client/Server: TCP_send() without copying the payload into the kernel.
+// *ticket (optional) becomes done once this and all earlier sends completed;
+// data must stay untouched until then. Small payloads are copied and
+// complete immediately.
+// Returns send data size (-1 for failure)
+// Closes socket on failure.
+int TCP_send_zerocopy(net_zerocopy* zc, const char* data, unsigned total_size, uint32_t* ticket);
+
+// Process pending completion notifications, blocking for at least one if wait.
+// Returns number of completed sends (-1 for failure).
+int TCP_zerocopy_reap(net_zerocopy* zc, bool wait);
+
+// Whether the buffer of the send that returned ticket can be reused.
+// Only reflects notifications already reaped.
+bool TCP_zerocopy_done(const net_zerocopy* zc, uint32_t ticket);
+
+// Block until ticket is done. Returns 0 (-1 for failure).
+int TCP_zerocopy_wait(net_zerocopy* zc, uint32_t ticket);
+
+// Client/Server: Receive a message and its header.
+// Returns recv data size (-1 for failure); data ptr (malloc, NULL if empty)
+// Closes socket on failure.
+int TCP_recv_msg(socket_t socket, net_header* header, char** data_ptr);
+
+// Client/Server: Receive data into a caller-owned buffer.
+// *needed (optional) is set to the payload size of the next message.
+// If it exceeds capacity, nothing is consumed and NET_ERR_SPACE is returned;
+// call again with a larger buffer.
+// Returns recv data size (-1 for failure)
+// Closes socket on failure.
+int TCP_recv_into(socket_t socket, char* buf, size_t capacity, size_t* needed);
+
+// Client/Server: Receive data into a reusable buffer, growing it if needed.
+// Returns recv data size (-1 for failure); buf->data holds the payload.
+// Closes socket on failure.
+int TCP_recv_buffer(socket_t socket, net_buffer* buf);
+
+// Initialize an empty receive buffer.
+void net_buffer_init(net_buffer* buf);
+
+// Release the buffer memory. The buffer can be reused after this.
+void net_buffer_free(net_buffer* buf);
+
+// Grow buffer to hold at least capacity bytes.
+// Returns false if out of memory (buffer is left unchanged).
+bool net_buffer_reserve(net_buffer* buf, size_t capacity);
+
+// Client/Server: TCP_recv_msg() for payloads of any size, including >2GiB.
+// header may be NULL.
+// Returns recv data size (-1 for failure); data ptr (malloc, NULL if empty)
+// Closes socket on failure.
+int64_t TCP_recv64(socket_t socket, net_header* header, char** data_ptr);
+
+// Client/Server: Receive a message of any size chunk by chunk.
+// Each at most chunk_size piece is received into the caller's chunk
+// buffer and handed to on_chunk as it lands. header may be NULL.
+// Returns recv data size (-1 for failure)
+// Closes socket on failure.
+int64_t TCP_recv_chunked(socket_t socket, char* chunk, size_t chunk_size, net_chunk_fn on_chunk, void* user, net_header* header);
+
+
+// Server: Serve many clients from one thread.
+// Makes listen_socket non-blocking and polls it and all accepted connections
+// (epoll on Linux, poll elsewhere). Partial headers and payloads are
+// reassembled per connection and delivered through callbacks.
+// The listen socket stays owned by the caller.
+// Returns NULL on failure.
+net_server* TCP_server_create(socket_t listen_socket, const net_server_callbacks* callbacks, void* user);
+
+// Wait up to timeout_ms (-1 forever) and handle ready sockets once.
+// Returns number of events handled (-1 for failure).
+int TCP_server_poll(net_server* server, int timeout_ms);
+
+// Call TCP_server_poll() until TCP_server_stop(). Returns 0 (-1 for failure).
+int TCP_server_run(net_server* server);
+
+// Make TCP_server_run() return. Safe to call from callbacks.
+void TCP_server_stop(net_server* server);
+
+// Close all connections and free the server.
+void TCP_server_destroy(net_server* server);
+
+// Queue a message to conn, sending what the socket accepts right away.
+// The payload is copied. Returns payload size (-1 for failure).
+int TCP_server_send(net_server* server, net_conn* conn, const net_header* header, const char* data);
+
+// Close conn. on_close runs immediately, memory is released after the current poll.
+void TCP_server_close(net_server* server, net_conn* conn);
+
+// Connection accessors.
+socket_t TCP_conn_socket(const net_conn* conn);
+void* TCP_conn_user(const net_conn* conn);
+void TCP_conn_set_user(net_conn* conn, void* user);
+
+// Bytes queued by TCP_server_send() not yet accepted by the socket.
+// Use to throttle slow clients.
+size_t TCP_conn_pending(const net_conn* conn);
+
+
+// Async: Drive non-blocking connects, accepts, sends and receives from the calling thread.
+// Operations advance in TCP_reactor_poll() (and right away where the socket
+// allows), so a sender can compute the next frame while the last one drains.
+// Sockets stay in blocking mode for other TCP_* calls once their operations finish.
+// Returns NULL on failure.
+net_reactor* TCP_reactor_create(void);
+
+// Free the reactor and all operations, pending ones are abandoned
+// mid-message and their sockets should be closed.
+void TCP_reactor_destroy(net_reactor* reactor);
+
+// Wait up to timeout_ms (-1 forever) for sockets to become ready, advance
+// operations and run completion callbacks.
+// Returns number of operations completed (-1 for failure).
+int TCP_reactor_poll(net_reactor* reactor, int timeout_ms);
+
+// Number of operations not yet completed or whose callback has not run.
+int TCP_reactor_pending(const net_reactor* reactor);
+
+// Pop the oldest completed operation that has no callback (NULL if none).
+// Free it with TCP_async_release().
+net_async* TCP_reactor_next(net_reactor* reactor);
+
+// Async: Start connecting to server listening at addr, port.
+// Name resolution blocks, pass numeric addresses to avoid it.
+// The result is the new socket, in blocking mode like TCP_connect().
+// Returns operation handle (NULL for failure).
+net_async* TCP_connect_async(net_reactor* reactor, const char* addr, const char* port, net_async_fn cb, void* user);
+
+// Async: Accept a pending connection at this listening socket.
+// The listen socket is non-blocking while accepts are pending.
+// The result is the new socket, in blocking mode like TCP_accept().
+// A failed accept does not close the listen socket.
+// Returns operation handle (NULL for failure).
+net_async* TCP_accept_async(net_reactor* reactor, socket_t socket, net_async_fn cb, void* user);
+
+// Async: Start sending data as one message. Zero-length payloads are allowed.
+// data must stay untouched until the operation completes.
+// Operations on one socket complete in the order they were started.
+// cb (optional) reports completion; without it the finished operation
+// is queued for TCP_reactor_next() or TCP_async_wait().
+// Returns operation handle (NULL for failure).
+// Closes socket on failure, failing its other operations.
+net_async* TCP_send_async(net_reactor* reactor, socket_t socket, const char* data, uint64_t total_size, net_async_fn cb, void* user);
+
+// Async: Start receiving one message into buf, growing it if needed.
+// buf must stay valid until the operation completes; then buf->data,
+// buf->size and buf->header describe the message.
+// Returns operation handle (NULL for failure).
+// Closes socket on failure, failing its other operations.
+net_async* TCP_recv_async(net_reactor* reactor, socket_t socket, net_buffer* buf, net_async_fn cb, void* user);
+
+// Operation accessors.
+int TCP_async_status(const net_async* op); // NET_ASYNC_*
+int64_t TCP_async_result(const net_async* op); // payload size or new socket, -1 if pending or failed
+socket_t TCP_async_socket(const net_async* op);
+void* TCP_async_user(const net_async* op);
+
+// Poll until op completes, then release it. op must not have a callback
+// or have been popped by TCP_reactor_next().
+// Returns TCP_async_result() (-1 for failure).
+int64_t TCP_async_wait(net_reactor* reactor, net_async* op);
+
+// Free an operation returned by TCP_reactor_next().
+void TCP_async_release(net_async* op);
+
+
+// Client: Pool of persistent connections keyed by addr and port.
+// Keeps up to max_idle idle connections per server for at most
+// idle_timeout seconds (keep it below the server's NET_TIMEOUT of 30s).
+// Addresses are resolved once per server. Not thread-safe.
+// Returns NULL on failure.
+net_pool* TCP_pool_create(int max_idle, int idle_timeout);
+
+// Close idle connections and free the pool.
+// Sockets still acquired stay open and belong to the caller.
+void TCP_pool_destroy(net_pool* pool);
+
+// Client: Get a connection to addr, port.
+// Reuses the most recent idle connection that is still open and has no
+// unread data, else connects.
+// Returns socket (INV_SOCKET on failure).
+socket_t TCP_pool_acquire(net_pool* pool, const char* addr, const char* port);
+
+// Hand an acquired socket back after a complete exchange.
+// reusable false (e.g. the message stream is out of sync) closes it.
+void TCP_pool_release(net_pool* pool, socket_t socket, bool reusable);
+
+// Forget an acquired socket that a failed TCP_* call already closed.
+void TCP_pool_discard(net_pool* pool, socket_t socket);
+
+// Client: Send one request and receive its response on a pooled connection.
+// A failure on a reused connection is retried once on a new one,
+// so requests must be safe to repeat.
+// Returns response size (-1 for failure); response->data holds it.
+int TCP_pool_exchange(net_pool* pool, const char* addr, const char* port, const char* data, unsigned total_size, net_buffer* response);
+
+// Connection counters since creation.
+void TCP_pool_get_stats(const net_pool* pool, net_pool_stats* stats);
+
+// Connections made by the pool from now on use opts (NULL for defaults).
+void TCP_pool_set_sockopts(net_pool* pool, const net_sockopts* opts);
+
+
+// Select the transport used by the TCP_* calls and TCP_server (process-wide).
+// NET_BACKEND_URING submits each send/recv loop as a single io_uring
+// operation that the kernel completes in full, so a frame typically costs
+// one syscall. Each thread gets its own ring on first use; switching back
+// to NET_BACKEND_SOCKETS releases the calling thread's ring.
+// Returns false (and keeps sockets) if io_uring is unavailable.
+bool TCP_set_backend(int backend);
+
+// Current backend, NET_BACKEND_*.
+int TCP_get_backend(void);
+
+// Release the calling thread's io_uring, if any.
+// Call before exiting threads that made TCP_* calls with the io_uring backend.
+void TCP_thread_cleanup(void);
+
+// Register frame buffers with the calling thread's io_uring.
+// Sends/receives that fall entirely inside one of them use the
+// pre-pinned fixed-buffer path. Replaces earlier registrations.
+// Returns false if unavailable.
+bool TCP_register_buffers(const net_iovec* bufs, int count);
+
+// Drop buffers registered on the calling thread.
+void TCP_unregister_buffers(void);
+
+// Number of send/recv-family syscalls (io_uring_enter included)
+// issued by this library so far, process-wide.
+// Same as the syscalls of the TCP_get_stats() totals.
+uint64_t TCP_syscall_count(void);
+
+// Copy the transfer statistics of socket, or the process-wide totals for
+// INV_SOCKET. Counting is always on and costs a few relaxed atomic adds per
+// call; this can run while other threads transfer, counters are read one
+// by one so they may be a message apart.
+// A socket's counters start when it first transfers and end at TCP_close().
+// Returns 0, -1 if the socket has none (no transfer yet, or more than
+// NET_STATS_SOCKETS sockets were open).
+int TCP_get_stats(socket_t socket, net_stats* stats);
+
+// Zero the counters of socket, or the totals for INV_SOCKET.
+void TCP_reset_stats(socket_t socket);
+
+// Upper bucket bound (2^(i+1)) at or below which fraction p (0..1) of a
+// net_dir_stats histogram's messages fall, 0 if it is empty.
+uint64_t TCP_hist_percentile(const uint64_t* hist, double p);
+
+// Monotonic clock used for trace stamps, in ns.
+uint64_t TCP_clock_ns(void);
+
+// Estimate the offset between this end's TCP_clock_ns() and the peer's, so
+// traced messages received on socket line up with the sender's stamps.
+// One end calls it with rounds > 0 probes (the lowest round trip wins),
+// the other with rounds 0 to answer them; both learn the offset.
+// Nothing else may be in flight on the connection meanwhile.
+// offset_ns (optional) receives peer clock minus local clock.
+// Returns 0 (-1 for failure)
+// Closes socket on failure.
+int TCP_clock_sync(socket_t socket, int rounds, int64_t* offset_ns);
+
+// Send like TCP_send_msg() with NET_FLAG_TRACED: capture_ns and encode_ns
+// (TCP_clock_ns(), 0 for now) and the send start and end stamps follow the
+// payload, and the receiver records them with its own arrival and completion
+// stamps. Any TCP_recv* call, TCP_server and TCP_async receive traced messages.
+// Needs binary framing, not for TCP_shm_commit().
+// Returns payload size (-1 for failure)
+// Closes socket on failure.
+int TCP_send_traced(socket_t socket, const net_header* header, const char* data, uint64_t capture_ns, uint64_t encode_ns);
+
+// Trace of message seq among the last NET_TRACE_LOG traced messages received
+// on socket, or of the last one with TCP_trace_last().
+// Returns 0, -1 if not found.
+int TCP_trace_get(socket_t socket, uint32_t seq, net_trace* trace);
+int TCP_trace_last(socket_t socket, net_trace* trace);
+
+// Stamp message seq as consumed now, e.g. after it was shown or written to disk.
+// Returns 0, -1 if not found.
+int TCP_trace_consume(socket_t socket, uint32_t seq);
+
+// Split a trace into back-to-back stages.
+void TCP_trace_breakdown(const net_trace* trace, net_latency* latency);
+
+
+// Fill opts with a NET_SOCKOPTS_* preset.
+void TCP_sockopts_preset(net_sockopts* opts, int preset);
+
+// Apply socket options. Options the platform lacks are skipped.
+// Returns 0, -1 if any option was rejected (the rest are still applied, socket stays open).
+int TCP_set_sockopts(socket_t socket, const net_sockopts* opts);
+
+// Push out data held back by the cork option. No-op without it.
+void TCP_flush(socket_t socket);
+
+// TCP_connect() with socket options (optional) applied before connecting.
+// addr "unix:<path>" or "shm:<path>" picks a same-host transport (port unused),
+// see TCP_shm_reserve().
+socket_t TCP_connect3(const char* addr, const char* port, const net_sockopts* opts, bool verbose);
+
+// TCP_listen() with socket options (optional) applied before binding.
+// Accepted sockets inherit most of them.
+// port "unix:<path>" or "shm:<path>" listens for same-host connections instead
+// (ipv6 unused). reuseaddr removes a socket file left at path.
+socket_t TCP_listen3(const char* port, bool ipv6, const net_sockopts* opts, bool verbose);
+
+// TCP_accept() with socket options (optional) applied to the new socket.
+socket_t TCP_accept3(socket_t socket, const net_sockopts* opts, bool verbose);
+
+
+// Client/Server: Frame stream state for one direction of one connection.
+// Both ends keep the previous frame of frame_size bytes. Frames after the
+// first go out as the runs of bytes that changed since then, so mostly
+// static frames (e.g. a progressive preview) cost a fraction of the
+// full frame on the wire. Every keyframe_interval-th frame is sent whole
+// (0 only when needed). Needs binary framing.
+// Returns NULL on failure.
+net_frame_stream* TCP_frame_stream_create(size_t frame_size, int keyframe_interval);
+
+void TCP_frame_stream_destroy(net_frame_stream* stream);
+
+// Send the next frame whole, e.g. after reconnecting.
+void TCP_frame_stream_reset(net_frame_stream* stream);
+
+// Send frame (frame_size bytes) as a keyframe or delta.
+// A delta that would not be smaller than the frame is sent as a keyframe.
+// Returns payload size on the wire (-1 for failure)
+// Closes socket on failure.
+int64_t TCP_send_frame(socket_t socket, net_frame_stream* stream, const char* frame);
+
+// Trace the next TCP_send_frame() (see TCP_send_traced()): the frame was
+// captured at capture_ns (TCP_clock_ns()), its encode stamp is taken once
+// the delta is built.
+void TCP_frame_stream_trace(net_frame_stream* stream, uint64_t capture_ns);
+
+// Receive the next frame and rebuild it in place, see TCP_frame_data().
+// Returns frame size (-1 for failure)
+// Closes socket on failure.
+int64_t TCP_recv_frame(socket_t socket, net_frame_stream* stream);
+
+// Last frame sent / received, NULL before the first one.
+// Valid until the next call on the stream.
+const char* TCP_frame_data(const net_frame_stream* stream);
+
+// Frame counters since creation.
+void TCP_frame_get_stats(const net_frame_stream* stream, net_frame_stats* stats);
+
+
+// Client/Server: Send a frame of width x height pixels (channels bytes each,
+// rows packed) as tiles of tile_size square in NET_TILES_* order.
+// Each tile is its own message carrying its coordinates.
+// Returns frame size (-1 for failure)
+// Closes socket on failure.
+int64_t TCP_send_tiles(socket_t socket, const char* frame, int width, int height, int channels, int tile_size, int order);
+
+// Client/Server: Receive a frame sent with TCP_send_tiles() into frame.
+// on_tile (optional) runs after each tile is copied into place, so partial
+// frames can be shown while the rest is in flight.
+// Returns frame size (-1 for failure)
+// Closes socket on failure.
+int64_t TCP_recv_tiles(socket_t socket, net_buffer* frame, net_tile_fn on_tile, void* user);
+
+
+// Client: Open count (up to NET_STRIPE_MAX) parallel connections to addr, port
+// as one stripe group, socket options (optional) applied to each.
+// Striping pays off when one connection cannot fill the link: high latency,
+// or a per-flow CPU limit (each connection gets its own thread).
+// Returns NULL on failure.
+net_stripe* TCP_stripe_connect(const char* addr, const char* port, int count, const net_sockopts* opts);
+
+// Server: Accept the connections of one stripe group. Blocks until all of
+// them arrived; connections not belonging to the first group are closed.
+// Returns NULL on failure.
+net_stripe* TCP_stripe_accept(socket_t listen_socket, const net_sockopts* opts);
+
+// Close all connections of the group and free it.
+void TCP_stripe_close(net_stripe* stripe);
+
+// Connections in the group, 0 after a failed transfer.
+int TCP_stripe_count(const net_stripe* stripe);
+
+// Send total_size bytes dealt round-robin in chunk_size pieces (0 for 1 MiB)
+// over the group's connections, one thread each.
+// Returns send data size (-1 for failure)
+// Closes all connections on failure.
+int64_t TCP_stripe_send(net_stripe* stripe, const char* data, uint64_t total_size, size_t chunk_size);
+
+// Receive one striped transfer into buf, each chunk straight at its offset.
+// Returns received data size (-1 for failure)
+// Closes all connections on failure.
+int64_t TCP_stripe_recv(net_stripe* stripe, net_buffer* buf);
+
+
+// Same-host transports, chosen by the address given to TCP_connect3() / TCP_listen3():
+//   unix:<path>  Unix domain socket, unix:@<name> for a Linux abstract socket.
+//                Works with every call that takes a socket.
+//   shm:<path>   Linux only. Messages go through two shared-memory rings (one
+//                per direction) set up over a Unix socket at path; sending and
+//                receiving are a memcpy each and sleep on a futex only when
+//                a ring is full or empty. Works with the blocking send/recv
+//                calls; not with TCP_async_*, TCP_server_*, TCP_send_file
+//                or zero-copy sends, which need a kernel socket.
+
+// Ring size per direction for shm: connections made from now on, rounded up
+// to pages (0 for the default of 1 MiB, at most 1 GiB). Set on the connecting
+// side, the accepting side follows. Messages built in place (TCP_shm_reserve())
+// or received in place must fit, so raise it to a frame for that; copies run
+// fastest with a ring that stays in cache.
+void TCP_set_shm_ring(size_t size);
+
+// shm: only: Reserve room for a payload of up to size bytes straight in the
+// send ring, so it can be rendered or encoded in place. Blocks until the ring
+// has room. Nothing else may be sent until TCP_shm_commit().
+// Returns the payload buffer, NULL on failure (closes socket if it was a transfer error).
+char* TCP_shm_reserve(socket_t socket, size_t size);
+
+// shm: only: Send the reserved payload as one message, header->length bytes of it
+// (at most the reserved size).
+// Returns payload size (-1 for failure)
+// Closes socket on failure.
+int64_t TCP_shm_commit(socket_t socket, const net_header* header);
+
+// shm: only: Receive the next message and return its payload where it lies in
+// the receive ring, header filled in. Valid until TCP_shm_release() or the next
+// receive, which releases it. The message must fit in the ring.
+// Returns NULL on failure.
+// Closes socket on failure.
+const char* TCP_shm_recv(socket_t socket, net_header* header);
+
+// Hand the message returned by TCP_shm_recv() back to the sender.
+void TCP_shm_release(socket_t socket);
+
+
 // TCP_connect() with optional verbose mode.
 socket_t TCP_connect2(const char* addr, const char* port, bool verbose);
 
@@ -111,48 +918,31 @@ int main(int argc, char *argv[]) {
         return -1;
     }
 
-    // read from file
-    FILE* fd;
-    fd = fopen(argv[3], "rb");
-    if (!fd) {
-        fprintf(stderr, "file not accessible!\n");
-        return -1;
-    }
-    fseek(fd, 0, SEEK_END);
-    unsigned total_size = ftell(fd);
-    fseek(fd, 0, SEEK_SET);
-	byte* data = (byte*)malloc(total_size);
-    fread((void*) data, 1, total_size, fd);
-    fclose(fd);
-
-    printf("read filename: %s\n", argv[3]);
-    printf("read size: %d\n", total_size);
-
     int init = TCP_win32_init();
     if (init != 0) {
-        free(data);
         fprintf(stderr, "Windows initialize function failed!\n");
         exit(1);
     }
 
     socket_t socket = TCP_connect(argv[1], argv[2]);
     if (socket == INV_SOCKET) {
-        free(data);
         fprintf(stderr, "Connect to server failed!\n");
         exit(1);
     }
 
-    if (TCP_send(socket, data, total_size) != total_size) {
-        free(data);
-        TCP_close(socket);
+    // streams the file, no full-size buffer needed
+    int64_t total_size = TCP_send_file(socket, argv[3], 0, 0);
+    if (total_size == -1) {
         fprintf(stderr, "Failed to send data!\n");
         exit(1);
     }
 
+    printf("sent filename: %s\n", argv[3]);
+    printf("sent size: %lld\n", (long long)total_size);
+
     char* resp;
     int nrecv = TCP_recv(socket, &resp);
     if (nrecv < 0) {
-        free(data);
         TCP_close(socket);
         fprintf(stderr, "Failed to receive response!\n");
         exit(1);
@@ -160,7 +950,6 @@ int main(int argc, char *argv[]) {
 
     printf("received %d bytes\n", nrecv);
 
-    free(data);
     free(resp);
     TCP_close(socket);
 
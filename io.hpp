@@ -0,0 +1,294 @@
+//
+// C++20 coroutine front-end for the socket layer.
+// Awaitable connect, accept, send_frame and recv_frame on top of the
+// TCP_*_async reactor, so one thread can run many sessions as
+// sequential code without per-connection threads.
+//
+
+#ifndef IO_HPP
+#define IO_HPP
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <span>
+#include <utility>
+
+#include "io.h"
+
+namespace io {
+
+// Move-only owner of a socket, closed on destruction.
+class socket {
+public:
+    socket() noexcept = default;
+    explicit socket(socket_t fd) noexcept : fd_(fd) {}
+    socket(socket&& other) noexcept : fd_(other.release()) {}
+    socket& operator=(socket&& other) noexcept
+    {
+        if (this != &other) reset(other.release());
+        return *this;
+    }
+    socket(const socket&) = delete;
+    socket& operator=(const socket&) = delete;
+    ~socket() { reset(); }
+
+    socket_t get() const noexcept { return fd_; }
+    explicit operator bool() const noexcept { return fd_ != INV_SOCKET; }
+
+    // Give up ownership without closing.
+    socket_t release() noexcept { return std::exchange(fd_, INV_SOCKET); }
+
+    // Close the owned socket and take fd instead.
+    void reset(socket_t fd = INV_SOCKET) noexcept
+    {
+        if (fd_ != INV_SOCKET) TCP_close(fd_);
+        fd_ = fd;
+    }
+
+private:
+    socket_t fd_ = INV_SOCKET;
+};
+
+// Reusable receive buffer, see net_buffer.
+class buffer {
+public:
+    buffer() noexcept { net_buffer_init(&buf_); }
+    buffer(buffer&& other) noexcept : buf_(other.buf_) { net_buffer_init(&other.buf_); }
+    buffer& operator=(buffer&& other) noexcept
+    {
+        if (this != &other) {
+            net_buffer_free(&buf_);
+            buf_ = other.buf_;
+            net_buffer_init(&other.buf_);
+        }
+        return *this;
+    }
+    buffer(const buffer&) = delete;
+    buffer& operator=(const buffer&) = delete;
+    ~buffer() { net_buffer_free(&buf_); }
+
+    // Payload of the last received message.
+    const char* data() const noexcept { return buf_.data; }
+    size_t size() const noexcept { return buf_.size; }
+    std::span<const char> view() const noexcept { return { buf_.data, buf_.size }; }
+    const net_header& header() const noexcept { return buf_.header; }
+
+    bool reserve(size_t capacity) noexcept { return net_buffer_reserve(&buf_, capacity); }
+    net_buffer* get() noexcept { return &buf_; }
+
+private:
+    net_buffer buf_;
+};
+
+// Owns a net_reactor. Operations on it must be awaited on the thread that polls it.
+// Coroutines still suspended when it is destroyed are never resumed.
+class reactor {
+public:
+    reactor() noexcept : reactor_(TCP_reactor_create()) {}
+    reactor(const reactor&) = delete;
+    reactor& operator=(const reactor&) = delete;
+    ~reactor() { TCP_reactor_destroy(reactor_); }
+
+    explicit operator bool() const noexcept { return reactor_ != nullptr; }
+    net_reactor* get() const noexcept { return reactor_; }
+
+    // Wait up to timeout_ms (-1 forever) and resume coroutines whose operations completed.
+    // Returns number of operations completed (-1 for failure).
+    int poll(int timeout_ms = -1) noexcept { return TCP_reactor_poll(reactor_, timeout_ms); }
+
+    // Poll until no operation is left. Returns 0 (-1 for failure).
+    int run() noexcept
+    {
+        while (TCP_reactor_pending(reactor_)) {
+            if (poll() == -1) return -1;
+        }
+        return 0;
+    }
+
+private:
+    net_reactor* reactor_;
+};
+
+// Detached coroutine for one session.
+// Starts right away, runs until its first co_await and frees itself once done.
+struct task {
+    struct promise_type {
+        task get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+namespace detail {
+
+// One reactor operation, resumed from its completion callback.
+// Callbacks only run inside TCP_reactor_poll(), never before await_suspend() returns.
+class operation {
+public:
+    bool await_ready() const noexcept { return false; }
+
+protected:
+    explicit operation(reactor& r) noexcept : reactor_(r.get()) {}
+
+    // Suspend unless the operation could not be started.
+    bool suspend(std::coroutine_handle<> handle, net_async* op) noexcept
+    {
+        handle_ = handle;
+        started_ = op != nullptr;
+        return started_;
+    }
+
+    static void complete(net_reactor*, net_async* op, void* user)
+    {
+        operation* self = static_cast<operation*>(user);
+        self->result_ = TCP_async_result(op);
+        self->handle_.resume();
+    }
+
+    net_reactor* reactor_;
+    std::coroutine_handle<> handle_;
+    int64_t result_ = -1;
+    bool started_ = false;
+};
+
+class connect_op : public operation {
+public:
+    connect_op(reactor& r, const char* addr, const char* port) noexcept : operation(r), addr_(addr), port_(port) {}
+    bool await_suspend(std::coroutine_handle<> handle) noexcept
+    {
+        return suspend(handle, TCP_connect_async(reactor_, addr_, port_, complete, this));
+    }
+    io::socket await_resume() noexcept { return io::socket(result_ == -1 ? INV_SOCKET : (socket_t)result_); }
+
+private:
+    const char* addr_;
+    const char* port_;
+};
+
+class accept_op : public operation {
+public:
+    accept_op(reactor& r, const io::socket& listener) noexcept : operation(r), listener_(listener.get()) {}
+    bool await_suspend(std::coroutine_handle<> handle) noexcept
+    {
+        return suspend(handle, TCP_accept_async(reactor_, listener_, complete, this));
+    }
+    io::socket await_resume() noexcept { return io::socket(result_ == -1 ? INV_SOCKET : (socket_t)result_); }
+
+private:
+    socket_t listener_;
+};
+
+// Failed transfers close the socket in the C layer, so ownership is dropped.
+class send_op : public operation {
+public:
+    send_op(reactor& r, io::socket& sock, const char* data, uint64_t size) noexcept
+        : operation(r), socket_(sock), data_(data), size_(size) {}
+    bool await_suspend(std::coroutine_handle<> handle) noexcept
+    {
+        return suspend(handle, TCP_send_async(reactor_, socket_.get(), data_, size_, complete, this));
+    }
+    int64_t await_resume() noexcept
+    {
+        if (started_ && result_ == -1) socket_.release();
+        return result_;
+    }
+
+private:
+    io::socket& socket_;
+    const char* data_;
+    uint64_t size_;
+};
+
+class recv_op : public operation {
+public:
+    recv_op(reactor& r, io::socket& sock, buffer& buf) noexcept : operation(r), socket_(sock), buffer_(buf) {}
+    bool await_suspend(std::coroutine_handle<> handle) noexcept
+    {
+        return suspend(handle, TCP_recv_async(reactor_, socket_.get(), buffer_.get(), complete, this));
+    }
+    int64_t await_resume() noexcept
+    {
+        if (started_ && result_ == -1) socket_.release();
+        return result_;
+    }
+
+private:
+    io::socket& socket_;
+    buffer& buffer_;
+};
+
+} // namespace detail
+
+// Server: Start listening for all connections at this port, see TCP_listen().
+inline socket listen(const char* port, bool ipv6 = false) noexcept
+{
+    return socket(TCP_listen(port, ipv6));
+}
+
+// Client: co_await connect(...) yields the connected socket (empty on failure).
+inline detail::connect_op connect(reactor& r, const char* addr, const char* port) noexcept
+{
+    return detail::connect_op(r, addr, port);
+}
+
+// Server: co_await accept(...) yields the next client socket (empty on failure).
+inline detail::accept_op accept(reactor& r, const socket& listener) noexcept
+{
+    return detail::accept_op(r, listener);
+}
+
+// co_await send_frame(...) yields the payload size (-1 for failure, socket closed).
+// data is sent in place and must stay untouched until the await returns.
+inline detail::send_op send_frame(reactor& r, socket& sock, const void* data, uint64_t size) noexcept
+{
+    return detail::send_op(r, sock, static_cast<const char*>(data), size);
+}
+
+template <class T, size_t N>
+inline detail::send_op send_frame(reactor& r, socket& sock, std::span<T, N> data) noexcept
+{
+    return detail::send_op(r, sock, reinterpret_cast<const char*>(data.data()), data.size_bytes());
+}
+
+// co_await recv_frame(...) yields the payload size (-1 for failure, socket closed).
+// The message is received straight into buf.
+inline detail::recv_op recv_frame(reactor& r, socket& sock, buffer& buf) noexcept
+{
+    return detail::recv_op(r, sock, buf);
+}
+
+} // namespace io
+
+
+// Example
+// Render server and client sessions on one thread.
+/*
+io::task serve(io::reactor& r, io::socket sock) {
+    io::buffer request;
+    std::vector<char> frame(6220800); // 1 frame at HD
+    while (co_await io::recv_frame(r, sock, request) >= 0) {
+        render(request.view(), frame);
+        if (co_await io::send_frame(r, sock, std::span(frame)) < 0) break;
+    }
+}
+
+io::task listen_loop(io::reactor& r, io::socket& listener) {
+    while (true) {
+        io::socket sock = co_await io::accept(r, listener);
+        if (sock) serve(r, std::move(sock));
+    }
+}
+
+int main() {
+    io::reactor r;
+    io::socket listener = io::listen("50000");
+    listen_loop(r, listener);
+    r.run();
+}
+*/
+
+#endif
@@ -0,0 +1,725 @@
+//
+// Asynchronous connects, accepts, message sends and receives.
+// A reactor polls the sockets with pending operations (net_poller) and
+// advances each one with non-blocking syscalls, so the caller's thread
+// is free between polls. Operations on one socket run in order.
+//
+
+#if defined(__MINGW32__) && !defined(_WIN32_WINNT)
+// mingw bug. for ws2tcpip.h
+#define _WIN32_WINNT 0x501
+#endif
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <unistd.h>
+    #include <sys/socket.h>
+    #include <sys/uio.h>
+    #include <netdb.h>
+    #include <errno.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+#define NET_ASYNC_EVENTS 64
+#define NET_ASYNC_MAXSYSCALL ((uint64_t)0x40000000) // max bytes per send/recv call
+
+#ifdef _WIN32
+#define NET_DONTWAIT 0 // sockets are switched to non-blocking mode instead
+#else
+#define NET_DONTWAIT MSG_DONTWAIT // leaves the socket blocking for other TCP_* calls
+#endif
+
+enum { ASYNC_SEND, ASYNC_RECV, ASYNC_ACCEPT, ASYNC_CONNECT };
+
+typedef struct net_watch net_watch;
+
+struct net_async {
+    net_reactor* reactor;
+    socket_t socket;
+    int kind;
+    int status;         // NET_ASYNC_*
+    int64_t result;
+    net_async_fn cb;
+    void* user;
+    net_async* prev;    // completion queue only
+    net_async* next;    // socket queue, then ready list or completion queue
+
+    char header[NET_MAXHEADER];
+    int header_len;     // send: encoded size, recv: bytes needed so far
+    int header_have;    // bytes of header transferred
+    const char* data;   // send payload
+    net_buffer* buf;    // recv destination
+    uint64_t size;      // payload size
+    uint64_t have;      // payload bytes transferred
+    uint64_t start_ns;  // send: first step, recv: header complete
+
+    struct addrinfo* addrs;      // connect candidates
+    struct addrinfo* addr_next;  // next one to try
+};
+
+// Sockets with pending operations
+struct net_watch {
+    socket_t socket;
+    unsigned events;    // registered NET_POLL_*, 0 if not registered
+    bool nonblocking;   // switched to non-blocking mode, restored when freed
+    net_async* sends;
+    net_async* sends_tail;
+    net_async* recvs;
+    net_async* recvs_tail;
+    net_watch* prev;
+    net_watch* next;
+};
+
+struct net_reactor {
+    net_poller* poller;
+    net_watch* watches;
+    int pending;        // operations not yet completed or delivered
+    int finished;       // completions since the last poll returned
+
+    // finished operations with a callback, delivered by the next poll
+    net_async* ready;
+    net_async* ready_tail;
+
+    // finished operations without a callback, for TCP_reactor_next()
+    net_async* queue;
+    net_async* queue_tail;
+};
+
+net_reactor* TCP_reactor_create(void)
+{
+    net_reactor* reactor = (net_reactor*)calloc(1, sizeof(net_reactor));
+    if (!reactor) {
+        fprintf(stderr, "ERROR: Out of memory!\n");
+        return NULL;
+    }
+    reactor->poller = net_poller_create();
+    if (!reactor->poller) {
+        free(reactor);
+        return NULL;
+    }
+    return reactor;
+}
+
+static void op_free(net_async* op)
+{
+    if (op->addrs) freeaddrinfo(op->addrs);
+    free(op);
+}
+
+static void free_list(net_async* op)
+{
+    while (op) {
+        net_async* next = op->next;
+        op_free(op);
+        op = next;
+    }
+}
+
+static void watch_free(net_reactor* reactor, net_watch* watch)
+{
+    if (watch->events) net_poller_del(reactor->poller, watch->socket);
+    if (watch->nonblocking) net_set_nonblocking(watch->socket, false);
+    if (watch->prev) watch->prev->next = watch->next;
+    else reactor->watches = watch->next;
+    if (watch->next) watch->next->prev = watch->prev;
+    free(watch);
+}
+
+void TCP_reactor_destroy(net_reactor* reactor)
+{
+    if (!reactor) return;
+    while (reactor->watches) {
+        net_watch* watch = reactor->watches;
+        free_list(watch->sends);
+        free_list(watch->recvs);
+        watch_free(reactor, watch);
+    }
+    free_list(reactor->ready);
+    free_list(reactor->queue);
+    net_poller_destroy(reactor->poller);
+    free(reactor);
+}
+
+// Switch the socket to non-blocking mode until the watch is freed.
+// returns 0, -1 for error (watch freed)
+static int watch_nonblocking(net_reactor* reactor, net_watch* watch)
+{
+    if (watch->nonblocking) return 0;
+    if (net_set_nonblocking(watch->socket, true) == -1) {
+        fprintf(stderr, "ERROR: Async socket setup failed with err %d!\n", TCP_ERRNO);
+        if (!watch->sends && !watch->recvs) watch_free(reactor, watch);
+        return -1;
+    }
+    watch->nonblocking = true;
+    return 0;
+}
+
+static net_watch* watch_get(net_reactor* reactor, socket_t socket)
+{
+    for (net_watch* watch = reactor->watches; watch; watch = watch->next) {
+        if (watch->socket == socket) return watch;
+    }
+    net_watch* watch = (net_watch*)calloc(1, sizeof(net_watch));
+    if (!watch) {
+        fprintf(stderr, "ERROR: Out of memory!\n");
+        return NULL;
+    }
+    watch->socket = socket;
+    net_set_nosigpipe(socket);
+    watch->next = reactor->watches;
+    if (reactor->watches) reactor->watches->prev = watch;
+    reactor->watches = watch;
+#ifdef _WIN32
+    if (watch_nonblocking(reactor, watch) == -1) return NULL;
+#endif
+    return watch;
+}
+
+// Register for what the queued operations wait on, free the watch once idle.
+// returns 0, -1 for error
+static int watch_update(net_reactor* reactor, net_watch* watch)
+{
+    unsigned events = (watch->sends ? NET_POLL_OUT : 0) | (watch->recvs ? NET_POLL_IN : 0);
+    if (!events) {
+        watch_free(reactor, watch);
+        return 0;
+    }
+    if (events == watch->events) return 0;
+    int ret = watch->events ? net_poller_mod(reactor->poller, watch->socket, events, watch)
+                            : net_poller_add(reactor->poller, watch->socket, events, watch);
+    if (ret == -1) return -1;
+    watch->events = events;
+    return 0;
+}
+
+static void op_finish(net_reactor* reactor, net_async* op, int64_t result)
+{
+    op->status = result == -1 ? NET_ASYNC_FAILED : NET_ASYNC_DONE;
+    op->result = result;
+    op->next = NULL;
+    if (op->addrs) {
+        freeaddrinfo(op->addrs);
+        op->addrs = op->addr_next = NULL;
+    }
+    reactor->finished++;
+    if (op->cb) {
+        if (reactor->ready_tail) reactor->ready_tail->next = op;
+        else reactor->ready = op;
+        reactor->ready_tail = op;
+        return;
+    }
+    reactor->pending--;
+    op->prev = reactor->queue_tail;
+    if (reactor->queue_tail) reactor->queue_tail->next = op;
+    else reactor->queue = op;
+    reactor->queue_tail = op;
+}
+
+static void queue_unlink(net_reactor* reactor, net_async* op)
+{
+    if (op->prev) op->prev->next = op->next;
+    else reactor->queue = op->next;
+    if (op->next) op->next->prev = op->prev;
+    else reactor->queue_tail = op->prev;
+}
+
+// Fail everything queued on a broken socket and close it.
+static void watch_fail(net_reactor* reactor, net_watch* watch)
+{
+    socket_t socket = watch->socket;
+    net_async* lists[2] = { watch->sends, watch->recvs };
+    watch->sends = watch->sends_tail = watch->recvs = watch->recvs_tail = NULL;
+    watch_free(reactor, watch);
+    TCP_close(socket);
+    for (int i = 0; i < 2; i++) {
+        net_async* op = lists[i];
+        while (op) {
+            net_async* next = op->next;
+            op_finish(reactor, op, -1);
+            op = next;
+        }
+    }
+}
+
+// Advance the head send.
+// returns 1 if complete, 0 if the socket is full, -1 for error
+static int send_step(net_async* op)
+{
+    net_stats* stats = net_stats_find(op->socket);
+    if (!op->start_ns) op->start_ns = net_now_ns();
+    while (op->header_have != op->header_len || op->have != op->size) {
+        // header remainder and payload in one syscall
+        uint64_t left = MIN(op->size - op->have, NET_ASYNC_MAXSYSCALL);
+        int64_t send_byte;
+#ifdef _WIN32
+        WSABUF bufs[2];
+        DWORD count = 0;
+        if (op->header_have != op->header_len) {
+            bufs[count].buf = op->header + op->header_have;
+            bufs[count].len = (ULONG)(op->header_len - op->header_have);
+            count++;
+        }
+        if (left) {
+            bufs[count].buf = (char*)op->data + op->have;
+            bufs[count].len = (ULONG)left;
+            count++;
+        }
+        DWORD sent = 0;
+        net_count_syscall(stats);
+        send_byte = WSASend(op->socket, bufs, count, &sent, 0, NULL, NULL) == 0 ? (int64_t)sent : -1;
+#else
+        struct iovec bufs[2];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        if (op->header_have != op->header_len) {
+            bufs[msg.msg_iovlen].iov_base = op->header + op->header_have;
+            bufs[msg.msg_iovlen].iov_len = op->header_len - op->header_have;
+            msg.msg_iovlen++;
+        }
+        if (left) {
+            bufs[msg.msg_iovlen].iov_base = (char*)op->data + op->have;
+            bufs[msg.msg_iovlen].iov_len = (size_t)left;
+            msg.msg_iovlen++;
+        }
+        msg.msg_iov = bufs;
+        net_count_syscall(stats);
+        send_byte = sendmsg(op->socket, &msg, NET_DONTWAIT | NET_NOSIGNAL);
+#endif
+        if (send_byte == -1) {
+            int err = TCP_ERRNO;
+            if (TCP_WOULDBLOCK(err)) return 0;
+            fprintf(stderr, "ERROR: Async send failed with err %d\n", err);
+            return -1;
+        }
+        net_count_bytes(stats, false, send_byte, op->header_len - op->header_have + left);
+        int header_step = (int)MIN((int64_t)(op->header_len - op->header_have), send_byte);
+        op->header_have += header_step;
+        op->have += (uint64_t)(send_byte - header_step);
+    }
+    net_count_msg(stats, false, op->size, op->start_ns);
+    return 1;
+}
+
+// Receive up to len bytes.
+// returns bytes received, 0 if none are ready, -1 for error
+static int64_t recv_some(socket_t socket, net_stats* stats, char* data, uint64_t len)
+{
+    net_count_syscall(stats);
+    int recv_byte = recv(socket, data, (int)MIN(len, NET_ASYNC_MAXSYSCALL), NET_DONTWAIT);
+    net_count_bytes(stats, true, recv_byte, MIN(len, NET_ASYNC_MAXSYSCALL));
+    if (recv_byte > 0) return recv_byte;
+    if (recv_byte == 0) {
+        fprintf(stderr, "ERROR: Async receive failed, connection closed\n");
+        return -1;
+    }
+    int err = TCP_ERRNO;
+    if (TCP_WOULDBLOCK(err)) return 0;
+    fprintf(stderr, "ERROR: Async receive failed with err %d\n", err);
+    return -1;
+}
+
+// Advance the head receive.
+// The header is read exactly, so following messages stay in the socket.
+// returns 1 if complete, 0 if no data is ready, -1 for error
+static int recv_step(net_async* op)
+{
+    net_stats* stats = net_stats_find(op->socket);
+    while (op->header_have != op->header_len) {
+        int64_t n = recv_some(op->socket, stats, op->header + op->header_have, op->header_len - op->header_have);
+        if (n <= 0) return (int)n;
+        bool sized = op->header_have >= NET_MAXINIT;
+        op->header_have += (int)n;
+        if (!sized && op->header_have == NET_MAXINIT) {
+            // first bytes tell binary from legacy framing
+            op->header_len = net_header_size((unsigned char*)op->header);
+        }
+        if (op->header_have != op->header_len) continue;
+
+        net_header header;
+        if (net_decode_header((unsigned char*)op->header, &header) == -1 ||
+            header.length > (uint64_t)(SIZE_MAX >> 1) ||
+            header.length > net_max_message ||
+            !net_buffer_reserve(op->buf, (size_t)header.length + net_trailer_size(header.flags))) {
+            fprintf(stderr, "ERROR: Async receive rejected message header!\n");
+            return -1;
+        }
+        op->buf->header = header;
+        op->size = header.length + net_trailer_size(header.flags);
+        op->start_ns = net_now_ns();
+    }
+    while (op->have != op->size) {
+        int64_t n = recv_some(op->socket, stats, op->buf->data + op->have, op->size - op->have);
+        if (n <= 0) return (int)n;
+        op->have += (uint64_t)n;
+    }
+    op->buf->size = (size_t)op->buf->header.length;
+    unsigned char trailer[NET_TRACE_SIZE];
+    bool traced = op->buf->header.flags & NET_FLAG_TRACED;
+    if (traced) memcpy(trailer, op->buf->data + op->buf->size, NET_TRACE_SIZE);
+    if (!net_checksum_ok(&op->buf->header, op->buf->data, op->buf->size)) return -1;
+    if (op->buf->header.flags & NET_FLAG_COMPRESSED) {
+        if (net_buffer_inflate(op->buf) == -1) {
+            fprintf(stderr, "ERROR: Malformed compressed message!\n");
+            return -1;
+        }
+    }
+    op->size = op->buf->size;
+    net_count_msg(stats, true, op->size, op->start_ns);
+    if (traced) net_trace_record(op->socket, &op->buf->header, trailer, op->start_ns, net_now_ns());
+    return 1;
+}
+
+static int watch_progress(net_reactor* reactor, net_watch* watch, unsigned events);
+
+// Accept one pending connection. Accept errors only fail this operation.
+// returns 1 if complete, 0 if none is pending
+static int accept_step(net_async* op)
+{
+    socket_t client_socket = accept(op->socket, NULL, NULL);
+    if (client_socket == INV_SOCKET) {
+        int err = TCP_ERRNO;
+        if (TCP_WOULDBLOCK(err)) return 0;
+        fprintf(stderr, "ERROR: Accept failed with err %d!\n", err);
+        op->result = -1;
+        return 1;
+    }
+#ifdef _WIN32
+    net_set_nonblocking(client_socket, false); // inherited from the listen socket
+#endif
+
+    // inactivity timer, as TCP_accept()
+    struct timeval timer = { NET_TIMEOUT, 0 };
+    if (setsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, (char*)&timer, sizeof(timer)) == -1) {
+        fprintf(stderr, "WARNING: Accept inactivity timer failed with err %d!\n", TCP_ERRNO);
+    }
+    op->result = (int64_t)client_socket;
+    return 1;
+}
+
+static void connect_ready(net_reactor* reactor, net_async* op, socket_t socket)
+{
+    // inactivity timer, as TCP_connect()
+    struct timeval timer = { NET_TIMEOUT, 0 };
+    if (setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (char*)&timer, sizeof(timer)) == -1) {
+        fprintf(stderr, "WARNING: Connect inactivity timer failed with err %d!\n", TCP_ERRNO);
+    }
+    op->socket = socket;
+    op_finish(reactor, op, (int64_t)socket);
+}
+
+// Start connecting to the next candidate address, finishing op if none is left.
+static void connect_next(net_reactor* reactor, net_async* op)
+{
+    while (op->addr_next) {
+        struct addrinfo* p = op->addr_next;
+        op->addr_next = p->ai_next;
+        socket_t client_socket = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+        if (client_socket == INV_SOCKET) continue;
+        net_watch* watch = watch_get(reactor, client_socket);
+        if (!watch || watch_nonblocking(reactor, watch) == -1) {
+            TCP_close(client_socket);
+            continue;
+        }
+
+        if (connect(client_socket, p->ai_addr, (socklen_t)p->ai_addrlen) == 0) {
+            watch_free(reactor, watch);
+            connect_ready(reactor, op, client_socket);
+            return;
+        }
+        int err = TCP_ERRNO;
+#ifdef _WIN32
+        bool started = err == WSAEWOULDBLOCK;
+#else
+        bool started = err == EINPROGRESS;
+#endif
+        if (started) {
+            op->socket = client_socket;
+            watch->sends = watch->sends_tail = op;
+            if (watch_update(reactor, watch) == 0) return;
+            watch->sends = watch->sends_tail = NULL;
+        }
+        watch_free(reactor, watch);
+        TCP_close(client_socket);
+    }
+    fprintf(stderr, "ERROR: Connection failed!\n");
+    op->socket = INV_SOCKET;
+    op_finish(reactor, op, -1);
+}
+
+// Connect in progress became writable: done or try the next address.
+static void connect_done(net_reactor* reactor, net_watch* watch)
+{
+    net_async* op = watch->sends;
+    socket_t socket = watch->socket;
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(socket, SOL_SOCKET, SO_ERROR, (char*)&err, &len) == -1) err = TCP_ERRNO;
+    watch->sends = op->next;
+    if (!watch->sends) watch->sends_tail = NULL;
+    if (err == 0) {
+        connect_ready(reactor, op, socket);
+        watch_progress(reactor, watch, NET_POLL_OUT); // back to blocking mode once idle
+        return;
+    }
+    watch_fail(reactor, watch); // fails operations queued behind the connect
+    connect_next(reactor, op);
+}
+
+// Run queued operations until the socket would block.
+// returns 0, -1 if the socket failed (watch freed)
+static int watch_progress(net_reactor* reactor, net_watch* watch, unsigned events)
+{
+    if (watch->sends && watch->sends->kind == ASYNC_CONNECT) {
+        if (events) connect_done(reactor, watch);
+        else if (watch_update(reactor, watch) == -1) watch_fail(reactor, watch);
+        return 0;
+    }
+    if (events & (NET_POLL_OUT | NET_POLL_ERR)) {
+        while (watch->sends) {
+            net_async* op = watch->sends;
+            int ret = send_step(op);
+            if (ret == 0) break;
+            if (ret == -1) {
+                watch_fail(reactor, watch);
+                return -1;
+            }
+            watch->sends = op->next;
+            if (!watch->sends) watch->sends_tail = NULL;
+            op_finish(reactor, op, (int64_t)op->size);
+        }
+    }
+    if (events & (NET_POLL_IN | NET_POLL_ERR)) {
+        while (watch->recvs) {
+            net_async* op = watch->recvs;
+            int ret = op->kind == ASYNC_ACCEPT ? accept_step(op) : recv_step(op);
+            if (ret == 0) break;
+            if (ret == -1) {
+                watch_fail(reactor, watch);
+                return -1;
+            }
+            watch->recvs = op->next;
+            if (!watch->recvs) watch->recvs_tail = NULL;
+            op_finish(reactor, op, op->kind == ASYNC_ACCEPT ? op->result : (int64_t)op->size);
+        }
+    }
+    if (watch_update(reactor, watch) == -1) {
+        fprintf(stderr, "ERROR: Async poll registration failed with err %d\n", TCP_ERRNO);
+        watch_fail(reactor, watch);
+        return -1;
+    }
+    return 0;
+}
+
+static net_async* op_create(net_reactor* reactor, socket_t socket, int kind, net_async_fn cb, void* user)
+{
+    net_async* op = (net_async*)calloc(1, sizeof(net_async));
+    if (!op) {
+        fprintf(stderr, "ERROR: Out of memory!\n");
+        return NULL;
+    }
+    op->reactor = reactor;
+    op->socket = socket;
+    op->kind = kind;
+    op->status = NET_ASYNC_PENDING;
+    op->result = -1;
+    op->cb = cb;
+    op->user = user;
+    return op;
+}
+
+net_async* TCP_connect_async(net_reactor* reactor, const char* addr, const char* port, net_async_fn cb, void* user)
+{
+    if (!reactor) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return NULL;
+    }
+    struct addrinfo* server_info;
+    if (net_resolve(addr, port, &server_info) == -1) return NULL;
+    net_async* op = op_create(reactor, INV_SOCKET, ASYNC_CONNECT, cb, user);
+    if (!op) {
+        freeaddrinfo(server_info);
+        return NULL;
+    }
+    op->addrs = op->addr_next = server_info;
+    reactor->pending++;
+    connect_next(reactor, op);
+    return op;
+}
+
+net_async* TCP_accept_async(net_reactor* reactor, socket_t socket, net_async_fn cb, void* user)
+{
+    if (!reactor || socket == INV_SOCKET) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return NULL;
+    }
+    net_async* op = op_create(reactor, socket, ASYNC_ACCEPT, cb, user);
+    if (!op) return NULL;
+    net_watch* watch = watch_get(reactor, socket);
+    if (!watch || watch_nonblocking(reactor, watch) == -1) {
+        free(op);
+        return NULL;
+    }
+
+    if (watch->recvs_tail) watch->recvs_tail->next = op;
+    else watch->recvs = op;
+    watch->recvs_tail = op;
+    reactor->pending++;
+    watch_progress(reactor, watch, 0);
+    return op;
+}
+
+net_async* TCP_send_async(net_reactor* reactor, socket_t socket, const char* data, uint64_t total_size, net_async_fn cb, void* user)
+{
+    if (!reactor || socket == INV_SOCKET || (total_size && !data)) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return NULL;
+    }
+    net_async* op = op_create(reactor, socket, ASYNC_SEND, cb, user);
+    if (!op) return NULL;
+
+    net_header header;
+    memset(&header, 0, sizeof(header));
+    header.type = NET_MSG_DATA;
+    header.seq = net_next_seq();
+    header.length = total_size;
+    op->header_len = net_encode_frame(op->header, &header);
+    op->data = data;
+    op->size = total_size;
+    net_watch* watch = op->header_len == -1 ? NULL : watch_get(reactor, socket);
+    if (!watch) {
+        free(op);
+        return NULL;
+    }
+
+    bool idle = !watch->sends;
+    if (watch->sends_tail) watch->sends_tail->next = op;
+    else watch->sends = op;
+    watch->sends_tail = op;
+    reactor->pending++;
+
+    // start right away, like a blocking send would
+    watch_progress(reactor, watch, idle ? NET_POLL_OUT : 0);
+    return op;
+}
+
+net_async* TCP_recv_async(net_reactor* reactor, socket_t socket, net_buffer* buf, net_async_fn cb, void* user)
+{
+    if (!reactor || socket == INV_SOCKET || !buf) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return NULL;
+    }
+    net_async* op = op_create(reactor, socket, ASYNC_RECV, cb, user);
+    if (!op) return NULL;
+    op->buf = buf;
+    op->header_len = NET_MAXINIT;
+    net_watch* watch = watch_get(reactor, socket);
+    if (!watch) {
+        free(op);
+        return NULL;
+    }
+
+    if (watch->recvs_tail) watch->recvs_tail->next = op;
+    else watch->recvs = op;
+    watch->recvs_tail = op;
+    reactor->pending++;
+
+    // data usually is not there yet, wait for readiness
+    watch_progress(reactor, watch, 0);
+    return op;
+}
+
+int TCP_reactor_poll(net_reactor* reactor, int timeout_ms)
+{
+    // do not sleep on undelivered completions
+    if (reactor->ready) timeout_ms = 0;
+
+    net_poll_event events[NET_ASYNC_EVENTS];
+    int count = 0;
+    if (reactor->watches) {
+        count = net_poller_wait(reactor->poller, events, NET_ASYNC_EVENTS, timeout_ms);
+        if (count == -1) {
+            fprintf(stderr, "ERROR: Async poll failed with err %d\n", TCP_ERRNO);
+            return -1;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        watch_progress(reactor, (net_watch*)events[i].ptr, events[i].events);
+    }
+
+    // detach first, callbacks may start operations or poll again
+    net_async* op = reactor->ready;
+    reactor->ready = reactor->ready_tail = NULL;
+    while (op) {
+        net_async* next = op->next;
+        reactor->pending--;
+        op->cb(reactor, op, op->user);
+        op_free(op);
+        op = next;
+    }
+
+    int finished = reactor->finished;
+    reactor->finished = 0;
+    return finished;
+}
+
+int TCP_reactor_pending(const net_reactor* reactor)
+{
+    return reactor->pending;
+}
+
+net_async* TCP_reactor_next(net_reactor* reactor)
+{
+    net_async* op = reactor->queue;
+    if (op) queue_unlink(reactor, op);
+    return op;
+}
+
+int TCP_async_status(const net_async* op)
+{
+    return op->status;
+}
+
+int64_t TCP_async_result(const net_async* op)
+{
+    return op->result;
+}
+
+socket_t TCP_async_socket(const net_async* op)
+{
+    return op->socket;
+}
+
+void* TCP_async_user(const net_async* op)
+{
+    return op->user;
+}
+
+int64_t TCP_async_wait(net_reactor* reactor, net_async* op)
+{
+    if (op->cb) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    while (op->status == NET_ASYNC_PENDING) {
+        if (TCP_reactor_poll(reactor, -1) == -1) return -1;
+    }
+    queue_unlink(reactor, op);
+    int64_t result = op->result;
+    op_free(op);
+    return result;
+}
+
+void TCP_async_release(net_async* op)
+{
+    op_free(op);
+}
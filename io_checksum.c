@@ -0,0 +1,431 @@
+//
+// CRC-32 and Adler-32 kernels, for PNG chunks, zlib streams and message
+// payloads (NET_FLAG_CHECKSUM).
+// CRC-32 folds 64 bytes per step with carry-less multiplies (PCLMULQDQ, as
+// in Intel's "Fast CRC Computation Using PCLMULQDQ") or runs the ARMv8 CRC
+// instructions, and falls back to slice-by-8 tables. Adler-32 sums 16 or 32
+// bytes per step in vector lanes, weighting each byte by its distance to the
+// end of the step, and reduces once per ADLER_NMAX bytes like zlib.
+// x86 kernels are picked at run time from CPUID; the ARM ones when the build
+// targets them (-march=armv8-a+crc, -mfpu=neon). Every kernel returns the
+// same value as the byte-at-a-time loop.
+//
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <pthread.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define CHECKSUM_X86 1
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#else
+    #if defined(__ARM_FEATURE_CRC32)
+        #define CHECKSUM_ARM_CRC 1
+        #include <arm_acle.h>
+    #endif
+    #if defined(__ARM_NEON) || defined(__ARM_NEON__)
+        #define CHECKSUM_NEON 1
+        #include <arm_neon.h>
+    #endif
+#endif
+
+#if defined(__GNUC__)
+#define CHECKSUM_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CHECKSUM_TARGET(isa)
+#endif
+
+#define ADLER_BASE 65521u
+#define ADLER_NMAX 5552 // bytes before the sums could overflow 32 bits
+
+typedef unsigned char u8;
+
+typedef struct checksum_kernels {
+    const char* crc_name;
+    uint32_t (*crc)(uint32_t crc, const u8* p, size_t len);
+    const char* adler_name;
+    uint32_t (*adler)(uint32_t adler, const u8* p, size_t len);
+} checksum_kernels;
+
+bool net_checksum_on = false;
+
+static uint32_t crc_tables[8][256]; // [k][i]: CRC of byte i followed by k zero bytes
+static checksum_kernels chosen;
+#ifdef _WIN32
+static INIT_ONCE chosen_once = INIT_ONCE_STATIC_INIT;
+#else
+static pthread_once_t chosen_once = PTHREAD_ONCE_INIT;
+#endif
+
+void TCP_set_checksum(bool enable)
+{
+    net_checksum_on = enable;
+}
+
+// scalar
+
+static void crc_tables_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        crc_tables[0][i] = c;
+    }
+    for (int k = 1; k < 8; k++) {
+        for (int i = 0; i < 256; i++) {
+            uint32_t c = crc_tables[k - 1][i];
+            crc_tables[k][i] = (c >> 8) ^ crc_tables[0][c & 0xff];
+        }
+    }
+}
+
+// Eight bytes per step, one table per byte position. Loads are little-endian
+// regardless of the host.
+static uint32_t crc_slice8(uint32_t crc, const u8* p, size_t len)
+{
+    crc = ~crc;
+    for (; len >= 8; p += 8, len -= 8) {
+        uint32_t lo = get_le32(p) ^ crc, hi = get_le32(p + 4);
+        crc = crc_tables[7][lo & 0xff] ^ crc_tables[6][(lo >> 8) & 0xff] ^ crc_tables[5][(lo >> 16) & 0xff] ^
+            crc_tables[4][lo >> 24] ^ crc_tables[3][hi & 0xff] ^ crc_tables[2][(hi >> 8) & 0xff] ^
+            crc_tables[1][(hi >> 16) & 0xff] ^ crc_tables[0][hi >> 24];
+    }
+    while (len--) crc = (crc >> 8) ^ crc_tables[0][(*p++ ^ crc) & 0xff];
+    return ~crc;
+}
+
+static uint32_t adler_scalar(uint32_t adler, const u8* p, size_t len)
+{
+    uint32_t a = adler & 0xffff, b = adler >> 16;
+    while (len) {
+        size_t n = MIN(len, (size_t)ADLER_NMAX);
+        len -= n;
+        while (n--) {
+            a += *p++;
+            b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+    }
+    return a | (b << 16);
+}
+
+// Adler-32 after steps vector steps of step bytes each: sum is the byte sum,
+// prefix the sum of the byte sums before each step and weighted the bytes
+// times step, step-1, ..., 1. At most ADLER_NMAX bytes.
+static uint32_t adler_steps(uint32_t adler, size_t steps, int step, uint64_t sum, uint64_t prefix,
+    uint64_t weighted)
+{
+    uint64_t a = adler & 0xffff, b = adler >> 16;
+    b += a * step * steps + prefix * step + weighted;
+    a += sum;
+    return (uint32_t)(a % ADLER_BASE) | ((uint32_t)(b % ADLER_BASE) << 16);
+}
+
+#ifdef CHECKSUM_X86
+
+CHECKSUM_TARGET("sse2")
+static inline uint32_t hsum_epi32(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t)_mm_cvtsi128_si32(v);
+}
+
+// Fold len bytes (a multiple of 16, at least 64) into the inverted crc.
+CHECKSUM_TARGET("sse2,pclmul")
+static uint32_t crc_fold_pclmul(uint32_t crc, const u8* p, size_t len)
+{
+    // x^(k*32) mod P for the fold distances, bit-reflected, and the Barrett constants
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4); // 512 bits
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0); // 128 bits
+    const __m128i k5 = _mm_set_epi64x(0, 0x0163cd6124);              // 64 bits
+    const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641); // mu, P
+    const __m128i mask32 = _mm_setr_epi32(-1, 0, -1, 0);
+
+    __m128i x1 = _mm_loadu_si128((const __m128i*)p);
+    __m128i x2 = _mm_loadu_si128((const __m128i*)(p + 16));
+    __m128i x3 = _mm_loadu_si128((const __m128i*)(p + 32));
+    __m128i x4 = _mm_loadu_si128((const __m128i*)(p + 48));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    p += 64;
+    len -= 64;
+
+    // four independent lanes of 128 bits
+    for (; len >= 64; p += 64, len -= 64) {
+        __m128i h1 = _mm_clmulepi64_si128(x1, k1k2, 0x11), l1 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        __m128i h2 = _mm_clmulepi64_si128(x2, k1k2, 0x11), l2 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        __m128i h3 = _mm_clmulepi64_si128(x3, k1k2, 0x11), l3 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        __m128i h4 = _mm_clmulepi64_si128(x4, k1k2, 0x11), l4 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(h1, l1), _mm_loadu_si128((const __m128i*)p));
+        x2 = _mm_xor_si128(_mm_xor_si128(h2, l2), _mm_loadu_si128((const __m128i*)(p + 16)));
+        x3 = _mm_xor_si128(_mm_xor_si128(h3, l3), _mm_loadu_si128((const __m128i*)(p + 32)));
+        x4 = _mm_xor_si128(_mm_xor_si128(h4, l4), _mm_loadu_si128((const __m128i*)(p + 48)));
+    }
+
+    // fold the lanes into one, then the remaining 16-byte blocks
+    __m128i next[3] = { x2, x3, x4 };
+    for (int i = 0; i < 3; i++) {
+        __m128i lo = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, lo), next[i]);
+    }
+    for (; len >= 16; p += 16, len -= 16) {
+        __m128i lo = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, lo), _mm_loadu_si128((const __m128i*)p));
+    }
+
+    // 128 -> 64 bits
+    __m128i t = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), t);
+    t = _mm_srli_si128(x1, 4);
+    x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5, 0x00);
+    x1 = _mm_xor_si128(x1, t);
+
+    // Barrett reduction to 32 bits
+    t = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10);
+    t = _mm_clmulepi64_si128(_mm_and_si128(t, mask32), poly, 0x00);
+    x1 = _mm_xor_si128(x1, t);
+    return (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+static uint32_t crc_pclmul(uint32_t crc, const u8* p, size_t len)
+{
+    if (len >= 64) {
+        size_t n = len & ~(size_t)15;
+        crc = ~crc_fold_pclmul(~crc, p, n);
+        p += n;
+        len -= n;
+    }
+    return crc_slice8(crc, p, len);
+}
+
+CHECKSUM_TARGET("ssse3")
+static uint32_t adler_ssse3(uint32_t adler, const u8* p, size_t len)
+{
+    const __m128i taps = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i zero = _mm_setzero_si128();
+    while (len >= 16) {
+        size_t steps = MIN(len, (size_t)ADLER_NMAX) / 16;
+        len -= steps * 16;
+        __m128i sum = zero, prefix = zero, weighted = zero;
+        for (size_t i = 0; i < steps; i++, p += 16) {
+            __m128i bytes = _mm_loadu_si128((const __m128i*)p);
+            prefix = _mm_add_epi32(prefix, sum);
+            sum = _mm_add_epi32(sum, _mm_sad_epu8(bytes, zero));
+            weighted = _mm_add_epi32(weighted, _mm_madd_epi16(_mm_maddubs_epi16(bytes, taps), ones));
+        }
+        adler = adler_steps(adler, steps, 16, hsum_epi32(sum), hsum_epi32(prefix), hsum_epi32(weighted));
+    }
+    return adler_scalar(adler, p, len);
+}
+
+CHECKSUM_TARGET("avx2")
+static inline uint32_t hsum256_epi32(__m256i v)
+{
+    return hsum_epi32(_mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
+
+CHECKSUM_TARGET("avx2")
+static uint32_t adler_avx2(uint32_t adler, const u8* p, size_t len)
+{
+    const __m256i taps = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14,
+        13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i zero = _mm256_setzero_si256();
+    while (len >= 32) {
+        size_t steps = MIN(len, (size_t)ADLER_NMAX) / 32;
+        len -= steps * 32;
+        __m256i sum = zero, prefix = zero, weighted = zero;
+        for (size_t i = 0; i < steps; i++, p += 32) {
+            __m256i bytes = _mm256_loadu_si256((const __m256i*)p);
+            prefix = _mm256_add_epi32(prefix, sum);
+            sum = _mm256_add_epi32(sum, _mm256_sad_epu8(bytes, zero));
+            weighted = _mm256_add_epi32(weighted, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, taps), ones));
+        }
+        adler = adler_steps(adler, steps, 32, hsum256_epi32(sum), hsum256_epi32(prefix), hsum256_epi32(weighted));
+    }
+    return adler_scalar(adler, p, len);
+}
+
+static void x86_pick(checksum_kernels* k)
+{
+    bool pclmul = false, ssse3 = false, avx2 = false;
+#if defined(__GNUC__)
+    __builtin_cpu_init();
+    pclmul = __builtin_cpu_supports("pclmul");
+    ssse3 = __builtin_cpu_supports("ssse3");
+    avx2 = __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    __cpuid(info, 1);
+    pclmul = (info[2] >> 1) & 1;
+    ssse3 = (info[2] >> 9) & 1;
+    bool osxsave = (info[2] >> 27) & 1;
+    if (max_leaf >= 7 && osxsave && (_xgetbv(0) & 6) == 6) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] >> 5) & 1;
+    }
+#endif
+    if (pclmul) {
+        k->crc_name = "pclmul";
+        k->crc = crc_pclmul;
+    }
+    if (avx2) {
+        k->adler_name = "avx2";
+        k->adler = adler_avx2;
+    }
+    else if (ssse3) {
+        k->adler_name = "ssse3";
+        k->adler = adler_ssse3;
+    }
+}
+
+#endif // CHECKSUM_X86
+
+#ifdef CHECKSUM_ARM_CRC
+
+static uint32_t crc_armv8(uint32_t crc, const u8* p, size_t len)
+{
+    crc = ~crc;
+    for (; len && ((uintptr_t)p & 7); len--) crc = __crc32b(crc, *p++);
+    for (; len >= 8; p += 8, len -= 8) crc = __crc32d(crc, get_le64(p));
+    while (len--) crc = __crc32b(crc, *p++);
+    return ~crc;
+}
+
+#endif // CHECKSUM_ARM_CRC
+
+#ifdef CHECKSUM_NEON
+
+static uint32_t adler_neon(uint32_t adler, const u8* p, size_t len)
+{
+    static const u8 tap_bytes[16] = { 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1 };
+    const uint8x8_t tap_lo = vld1_u8(tap_bytes), tap_hi = vld1_u8(tap_bytes + 8);
+    while (len >= 16) {
+        size_t steps = MIN(len, (size_t)ADLER_NMAX) / 16;
+        len -= steps * 16;
+        uint32x4_t sum = vdupq_n_u32(0), prefix = vdupq_n_u32(0), weighted = vdupq_n_u32(0);
+        for (size_t i = 0; i < steps; i++, p += 16) {
+            uint8x16_t bytes = vld1q_u8(p);
+            prefix = vaddq_u32(prefix, sum);
+            sum = vpadalq_u16(sum, vpaddlq_u8(bytes));
+            uint16x8_t products = vmull_u8(vget_low_u8(bytes), tap_lo);
+            products = vmlal_u8(products, vget_high_u8(bytes), tap_hi);
+            weighted = vpadalq_u16(weighted, products);
+        }
+        uint32_t lanes[3][4];
+        vst1q_u32(lanes[0], sum);
+        vst1q_u32(lanes[1], prefix);
+        vst1q_u32(lanes[2], weighted);
+        uint64_t total[3];
+        for (int j = 0; j < 3; j++) total[j] = (uint64_t)lanes[j][0] + lanes[j][1] + lanes[j][2] + lanes[j][3];
+        adler = adler_steps(adler, steps, 16, total[0], total[1], total[2]);
+    }
+    return adler_scalar(adler, p, len);
+}
+
+#endif // CHECKSUM_NEON
+
+// Fill the tables and pick the kernels of this build and CPU, once.
+static void choose_kernels(void)
+{
+    crc_tables_init();
+    checksum_kernels k = { "slice8", crc_slice8, "scalar", adler_scalar };
+#ifdef CHECKSUM_X86
+    x86_pick(&k);
+#endif
+#ifdef CHECKSUM_ARM_CRC
+    k.crc_name = "armv8-crc";
+    k.crc = crc_armv8;
+#endif
+#ifdef CHECKSUM_NEON
+    k.adler_name = "neon";
+    k.adler = adler_neon;
+#endif
+    chosen = k;
+}
+
+#ifdef _WIN32
+static BOOL CALLBACK choose_kernels_once(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+    (void)once; (void)param; (void)context;
+    choose_kernels();
+    return TRUE;
+}
+#endif
+
+// Kernels of this build and CPU. First calls from several threads
+// (PNG workers) wait for one of them to fill the tables.
+static const checksum_kernels* kernels(void)
+{
+#ifdef _WIN32
+    InitOnceExecuteOnce(&chosen_once, choose_kernels_once, NULL, NULL);
+#else
+    pthread_once(&chosen_once, choose_kernels);
+#endif
+    return &chosen;
+}
+
+uint32_t TCP_crc32(uint32_t crc, const void* data, size_t len)
+{
+    return len ? kernels()->crc(crc, (const u8*)data, len) : crc;
+}
+
+uint32_t TCP_adler32(uint32_t adler, const void* data, size_t len)
+{
+    return len ? kernels()->adler(adler, (const u8*)data, len) : adler;
+}
+
+void TCP_checksum_kernels(const char** crc, const char** adler)
+{
+    const checksum_kernels* k = kernels();
+    if (crc) *crc = k->crc_name;
+    if (adler) *adler = k->adler_name;
+}
+
+uint32_t img_adler32_combine(uint32_t adler1, uint32_t adler2, size_t len2)
+{
+    // as zlib's adler32_combine()
+    uint32_t rem = (uint32_t)(len2 % ADLER_BASE);
+    uint32_t a = adler1 & 0xffff;
+    uint32_t b = (uint32_t)(((uint64_t)rem * a) % ADLER_BASE);
+    a += (adler2 & 0xffff) + ADLER_BASE - 1;
+    b += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+    if (a >= ADLER_BASE) a -= ADLER_BASE;
+    if (a >= ADLER_BASE) a -= ADLER_BASE;
+    if (b >= 2 * ADLER_BASE) b -= 2 * ADLER_BASE;
+    if (b >= ADLER_BASE) b -= ADLER_BASE;
+    return a | (b << 16);
+}
+
+uint32_t net_checksum_iov(const net_iovec* iov, int iovcnt)
+{
+    uint32_t crc = 0;
+    for (int i = 0; i < iovcnt; i++) crc = TCP_crc32(crc, iov[i].base, iov[i].len);
+    return crc;
+}
+
+bool net_checksum_ok(const net_header* header, const char* payload, size_t len)
+{
+    if (!(header->flags & NET_FLAG_CHECKSUM) || TCP_crc32(0, payload, len) == header->checksum) return true;
+    fprintf(stderr, "ERROR: Payload checksum mismatch!\n");
+    return false;
+}
@@ -0,0 +1,637 @@
+//
+// Raw deflate for the PNG encoder and stb_image_write.
+// Compresses one band of a zlib stream at a time. A band may be primed with
+// the bytes in front of it as dictionary and ends either in the final block
+// or in a sync flush (an empty stored block, leaving the output on a byte
+// boundary), so bands compressed independently concatenate into one valid
+// stream, the way pigz does it.
+//
+// Three matchers, from fastest:
+//   rle   runs of the previous byte only (distance 1), no hashing at all.
+//         Filtered sky and flat areas are mostly such runs.
+//   fast  greedy, hash chains level/2 deep, only the last positions of long
+//         matches are hashed.
+//   lazy  as zlib's deflate_slow(): a match is only taken if the next byte
+//         does not start a longer one. Chains 2*level deep.
+// Each block of up to DEFLATE_BLOCK_SYMBOLS symbols goes out with dynamic
+// Huffman codes, the fixed codes or stored, whichever is smallest.
+// img_zlib_compress() is the STBIW_ZLIB_COMPRESS hook, so stb's own writers
+// use this too.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+#define DEFLATE_WINDOW 32768
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_BLOCK_SYMBOLS 32768
+#define DEFLATE_LITLEN_CODES 286
+#define DEFLATE_DIST_CODES 30
+#define DEFLATE_CL_CODES 19 // code length alphabet of the dynamic header
+#define DEFLATE_MAX_BITS 15
+#define DEFLATE_MAX_CL_BITS 7
+#define DEFLATE_STORED_MAX 65535
+#define DEFLATE_EOB 256
+#define DEFLATE_FAST_INSERT 8 // fast: longer matches only hash their tail
+#define DEFLATE_TOO_FAR 4096  // 3-byte matches further back cost more than literals
+
+static const uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+    67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5,
+    5, 5, 5, 0 };
+static const uint16_t dist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513,
+    769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t dist_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11,
+    11, 12, 12, 13, 13 };
+// order of the code length code lengths in the dynamic header
+static const uint8_t cl_order[DEFLATE_CL_CODES] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1,
+    15 };
+
+typedef struct bit_writer {
+    unsigned char* data;
+    size_t size, cap;
+    uint64_t bits;
+    int count;
+    bool failed;
+} bit_writer;
+
+// Code lengths and bit-reversed codes of one alphabet.
+typedef struct huff_code {
+    uint8_t lens[DEFLATE_LITLEN_CODES + 2];
+    uint16_t codes[DEFLATE_LITLEN_CODES + 2];
+} huff_code;
+
+typedef struct deflate_state {
+    const unsigned char* base; // dictionary start, positions are offsets from here
+    int32_t end;
+    int chain, nice;
+    bool final;
+
+    // pending block: literal byte or match length - 3, and distance (0 for literals)
+    uint8_t sym_len[DEFLATE_BLOCK_SYMBOLS];
+    uint16_t sym_dist[DEFLATE_BLOCK_SYMBOLS];
+    int syms;
+    int32_t block_start, block_len; // input bytes the pending block covers
+    uint32_t lit_freq[DEFLATE_LITLEN_CODES];
+    uint32_t dist_freq[DEFLATE_DIST_CODES];
+
+    uint8_t length_sym[DEFLATE_MAX_MATCH + 1]; // match length -> length code index
+    uint8_t dist_sym[512]; // distance-1 < 256 direct, else 256 + ((distance-1) >> 7)
+    huff_code fixed_lit, fixed_dist;
+    bit_writer out;
+
+    int32_t head[1 << DEFLATE_HASH_BITS];
+    int32_t prev[DEFLATE_WINDOW];
+} deflate_state;
+
+static unsigned reverse_bits(unsigned code, int bits)
+{
+    unsigned r = 0;
+    for (int i = 0; i < bits; i++, code >>= 1) r = (r << 1) | (code & 1);
+    return r;
+}
+
+// Make room for 8 more bytes.
+static void bits_reserve(bit_writer* w)
+{
+    if (w->size + 8 <= w->cap) return;
+    size_t cap = w->cap * 2 + 64;
+    unsigned char* data = (unsigned char*)realloc(w->data, cap);
+    if (!data) {
+        w->failed = true;
+        w->size = 0; // keep writing into the old buffer
+        return;
+    }
+    w->data = data;
+    w->cap = cap;
+}
+
+static inline void put_bits(bit_writer* w, unsigned value, int bits)
+{
+    w->bits |= (uint64_t)value << w->count;
+    w->count += bits;
+    if (w->count < 32) return;
+    bits_reserve(w);
+    put_le32(w->data + w->size, (uint32_t)w->bits);
+    w->size += 4;
+    w->bits >>= 32;
+    w->count -= 32;
+}
+
+// Flush the pending bits, zero-padded to a byte boundary.
+static void align_bits(bit_writer* w)
+{
+    bits_reserve(w);
+    while (w->count > 0) {
+        w->data[w->size++] = (unsigned char)w->bits;
+        w->bits >>= 8;
+        w->count -= 8;
+    }
+    w->bits = 0;
+    w->count = 0;
+}
+
+static void put_bytes(bit_writer* w, const unsigned char* p, size_t len)
+{
+    if (w->size + len + 8 > w->cap) {
+        size_t cap = w->size + len + w->cap / 2 + 64;
+        unsigned char* data = (unsigned char*)realloc(w->data, cap);
+        if (!data) {
+            w->failed = true;
+            return;
+        }
+        w->data = data;
+        w->cap = cap;
+    }
+    memcpy(w->data + w->size, p, len);
+    w->size += len;
+}
+
+// Huffman code lengths of freq[0..n), unlimited. Keeps at least two codes
+// so every tree is complete. returns the longest length
+static int huffman_lengths(const uint32_t* freq, int n, uint8_t* lens)
+{
+    uint32_t weight[2 * DEFLATE_LITLEN_CODES];
+    int16_t parent[2 * DEFLATE_LITLEN_CODES];
+    uint8_t depth[2 * DEFLATE_LITLEN_CODES];
+    uint16_t leaf_sym[DEFLATE_LITLEN_CODES];
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        lens[i] = 0;
+        if (!freq[i]) continue;
+        // insertion sort by weight, alphabets are small
+        int k = m++;
+        while (k > 0 && weight[k - 1] > freq[i]) {
+            weight[k] = weight[k - 1];
+            leaf_sym[k] = leaf_sym[k - 1];
+            k--;
+        }
+        weight[k] = freq[i];
+        leaf_sym[k] = (uint16_t)i;
+    }
+    if (m < 2) {
+        int used = m ? leaf_sym[0] : 0;
+        lens[used] = 1;
+        lens[used ? 0 : 1] = 1;
+        return 1;
+    }
+
+    // two queues: sorted leaves [leaf, m), internal nodes [node, next) in creation order
+    int leaf = 0, node = m, next = m;
+    while (next < 2 * m - 1) {
+        int pick[2];
+        for (int j = 0; j < 2; j++) {
+            if (leaf < m && (node >= next || weight[leaf] <= weight[node])) pick[j] = leaf++;
+            else pick[j] = node++;
+        }
+        weight[next] = weight[pick[0]] + weight[pick[1]];
+        parent[pick[0]] = parent[pick[1]] = (int16_t)next;
+        next++;
+    }
+    int longest = 0;
+    depth[2 * m - 2] = 0;
+    for (int k = 2 * m - 3; k >= 0; k--) depth[k] = depth[parent[k]] + 1;
+    for (int k = 0; k < m; k++) {
+        lens[leaf_sym[k]] = depth[k];
+        longest = MAX(longest, depth[k]);
+    }
+    return longest;
+}
+
+// Code lengths no longer than limit: flatten the frequencies until they fit.
+static void limited_lengths(const uint32_t* freq, int n, int limit, uint8_t* lens)
+{
+    uint32_t f[DEFLATE_LITLEN_CODES];
+    memcpy(f, freq, n * sizeof(uint32_t));
+    while (huffman_lengths(f, n, lens) > limit) {
+        for (int i = 0; i < n; i++) {
+            if (f[i]) f[i] = (f[i] >> 1) | 1;
+        }
+    }
+}
+
+// Canonical codes from code lengths, bit-reversed for the writer.
+static void canonical_codes(huff_code* h, int n)
+{
+    int count[DEFLATE_MAX_BITS + 1] = { 0 };
+    unsigned next[DEFLATE_MAX_BITS + 1];
+    for (int i = 0; i < n; i++) count[h->lens[i]]++;
+    count[0] = 0;
+    unsigned code = 0;
+    for (int bits = 1; bits <= DEFLATE_MAX_BITS; bits++) {
+        code = (code + count[bits - 1]) << 1;
+        next[bits] = code;
+    }
+    for (int i = 0; i < n; i++) {
+        if (h->lens[i]) h->codes[i] = (uint16_t)reverse_bits(next[h->lens[i]]++, h->lens[i]);
+    }
+}
+
+static void state_tables(deflate_state* s)
+{
+    for (int c = 0; c < 29; c++) {
+        int top = c + 1 < 29 ? length_base[c + 1] : DEFLATE_MAX_MATCH + 1;
+        for (int len = length_base[c]; len < top; len++) s->length_sym[len] = (uint8_t)c;
+    }
+    for (int c = 0; c < 30; c++) {
+        int top = c + 1 < 30 ? dist_base[c + 1] : DEFLATE_WINDOW + 1;
+        for (int d = dist_base[c]; d < top; d++) {
+            if (d <= 256) s->dist_sym[d - 1] = (uint8_t)c;
+            else s->dist_sym[256 + ((d - 1) >> 7)] = (uint8_t)c;
+        }
+    }
+    for (int v = 0; v < 288; v++) s->fixed_lit.lens[v] = v < 144 ? 8 : v < 256 ? 9 : v < 280 ? 7 : 8;
+    canonical_codes(&s->fixed_lit, 288);
+    for (int v = 0; v < 30; v++) s->fixed_dist.lens[v] = 5;
+    canonical_codes(&s->fixed_dist, 30);
+}
+
+static inline int dist_code(const deflate_state* s, int dist)
+{
+    return dist <= 256 ? s->dist_sym[dist - 1] : s->dist_sym[256 + ((dist - 1) >> 7)];
+}
+
+// Bits of the pending symbols under the given codes, extra bits included.
+static uint64_t block_bits(const deflate_state* s, const huff_code* lit, const huff_code* dist)
+{
+    uint64_t bits = 0;
+    for (int i = 0; i < DEFLATE_LITLEN_CODES; i++) {
+        bits += (uint64_t)s->lit_freq[i] * (lit->lens[i] + (i > 256 ? length_extra[i - 257] : 0));
+    }
+    for (int i = 0; i < DEFLATE_DIST_CODES; i++) {
+        bits += (uint64_t)s->dist_freq[i] * (dist->lens[i] + dist_extra[i]);
+    }
+    return bits;
+}
+
+static void put_symbols(deflate_state* s, const huff_code* lit, const huff_code* dist)
+{
+    bit_writer* w = &s->out;
+    for (int i = 0; i < s->syms; i++) {
+        int d = s->sym_dist[i];
+        if (!d) {
+            put_bits(w, lit->codes[s->sym_len[i]], lit->lens[s->sym_len[i]]);
+            continue;
+        }
+        int len = s->sym_len[i] + DEFLATE_MIN_MATCH;
+        int c = s->length_sym[len];
+        put_bits(w, lit->codes[257 + c], lit->lens[257 + c]);
+        if (length_extra[c]) put_bits(w, len - length_base[c], length_extra[c]);
+        c = dist_code(s, d);
+        put_bits(w, dist->codes[c], dist->lens[c]);
+        if (dist_extra[c]) put_bits(w, d - dist_base[c], dist_extra[c]);
+    }
+    put_bits(w, lit->codes[DEFLATE_EOB], lit->lens[DEFLATE_EOB]);
+}
+
+// The dynamic header's code lengths, run-length coded: symbol | extra << 8.
+static int cl_runs(const uint8_t* lens, int n, uint16_t* runs, uint32_t* cl_freq)
+{
+    int count = 0;
+    for (int i = 0; i < n;) {
+        int len = lens[i], run = 1;
+        while (i + run < n && lens[i + run] == len) run++;
+        i += run;
+        if (len == 0) {
+            while (run >= 11) {
+                int r = MIN(run, 138);
+                runs[count++] = (uint16_t)(18 | (r - 11) << 8);
+                run -= r;
+            }
+            if (run >= 3) {
+                runs[count++] = (uint16_t)(17 | (run - 3) << 8);
+                run = 0;
+            }
+        }
+        else {
+            runs[count++] = (uint16_t)len;
+            run--;
+            while (run >= 3) {
+                int r = MIN(run, 6);
+                runs[count++] = (uint16_t)(16 | (r - 3) << 8);
+                run -= r;
+            }
+        }
+        while (run-- > 0) runs[count++] = (uint16_t)len;
+    }
+    for (int i = 0; i < count; i++) cl_freq[runs[i] & 0xff]++;
+    return count;
+}
+
+// Write the pending symbols as one or more blocks, last ends the call's output.
+static void flush_block(deflate_state* s, bool last)
+{
+    bit_writer* w = &s->out;
+    bool bfinal = last && s->final;
+    s->lit_freq[DEFLATE_EOB] = 1;
+
+    huff_code lit, dist, cl;
+    limited_lengths(s->lit_freq, DEFLATE_LITLEN_CODES, DEFLATE_MAX_BITS, lit.lens);
+    limited_lengths(s->dist_freq, DEFLATE_DIST_CODES, DEFLATE_MAX_BITS, dist.lens);
+    int hlit = DEFLATE_LITLEN_CODES, hdist = DEFLATE_DIST_CODES;
+    while (hlit > 257 && !lit.lens[hlit - 1]) hlit--;
+    while (hdist > 1 && !dist.lens[hdist - 1]) hdist--;
+
+    // literal/length and distance lengths are coded as one sequence
+    uint8_t all_lens[DEFLATE_LITLEN_CODES + DEFLATE_DIST_CODES];
+    uint16_t runs[DEFLATE_LITLEN_CODES + DEFLATE_DIST_CODES];
+    uint32_t cl_freq[DEFLATE_CL_CODES] = { 0 };
+    memcpy(all_lens, lit.lens, hlit);
+    memcpy(all_lens + hlit, dist.lens, hdist);
+    int run_count = cl_runs(all_lens, hlit + hdist, runs, cl_freq);
+    limited_lengths(cl_freq, DEFLATE_CL_CODES, DEFLATE_MAX_CL_BITS, cl.lens);
+    int hclen = DEFLATE_CL_CODES;
+    while (hclen > 4 && !cl.lens[cl_order[hclen - 1]]) hclen--;
+
+    uint64_t dynamic_bits = 3 + 5 + 5 + 4 + 3 * hclen + block_bits(s, &lit, &dist);
+    for (int i = 0; i < DEFLATE_CL_CODES; i++) {
+        static const uint8_t cl_extra[3] = { 2, 3, 7 };
+        dynamic_bits += (uint64_t)cl_freq[i] * (cl.lens[i] + (i >= 16 ? cl_extra[i - 16] : 0));
+    }
+    uint64_t fixed_bits = 3 + block_bits(s, &s->fixed_lit, &s->fixed_dist);
+    uint64_t chunks = MAX(((uint64_t)s->block_len + DEFLATE_STORED_MAX - 1) / DEFLATE_STORED_MAX, 1);
+    uint64_t stored_bits = (3 + 7 + 32) * chunks + 8 * (uint64_t)s->block_len;
+
+    if (stored_bits < dynamic_bits && stored_bits < fixed_bits) {
+        const unsigned char* p = s->base + s->block_start;
+        int32_t left = s->block_len;
+        do {
+            int32_t n = MIN(left, DEFLATE_STORED_MAX);
+            left -= n;
+            put_bits(w, bfinal && !left ? 1 : 0, 3);
+            align_bits(w);
+            unsigned char header[4];
+            put_le16(header, (uint16_t)n);
+            put_le16(header + 2, (uint16_t)~n);
+            put_bytes(w, header, 4);
+            put_bytes(w, p, n);
+            p += n;
+        } while (left);
+    }
+    else if (fixed_bits <= dynamic_bits) {
+        put_bits(w, (bfinal ? 1 : 0) | (1 << 1), 3);
+        put_symbols(s, &s->fixed_lit, &s->fixed_dist);
+    }
+    else {
+        put_bits(w, (bfinal ? 1 : 0) | (2 << 1), 3);
+        put_bits(w, hlit - 257, 5);
+        put_bits(w, hdist - 1, 5);
+        put_bits(w, hclen - 4, 4);
+        for (int i = 0; i < hclen; i++) put_bits(w, cl.lens[cl_order[i]], 3);
+        canonical_codes(&cl, DEFLATE_CL_CODES);
+        for (int i = 0; i < run_count; i++) {
+            int sym = runs[i] & 0xff, extra = runs[i] >> 8;
+            put_bits(w, cl.codes[sym], cl.lens[sym]);
+            if (sym == 16) put_bits(w, extra, 2);
+            else if (sym == 17) put_bits(w, extra, 3);
+            else if (sym == 18) put_bits(w, extra, 7);
+        }
+        canonical_codes(&lit, DEFLATE_LITLEN_CODES);
+        canonical_codes(&dist, DEFLATE_DIST_CODES);
+        put_symbols(s, &lit, &dist);
+    }
+
+    s->block_start += s->block_len;
+    s->block_len = 0;
+    s->syms = 0;
+    memset(s->lit_freq, 0, sizeof(s->lit_freq));
+    memset(s->dist_freq, 0, sizeof(s->dist_freq));
+}
+
+static inline void emit_literal(deflate_state* s, unsigned char c)
+{
+    s->sym_len[s->syms] = c;
+    s->sym_dist[s->syms++] = 0;
+    s->lit_freq[c]++;
+    s->block_len++;
+    if (s->syms == DEFLATE_BLOCK_SYMBOLS) flush_block(s, false);
+}
+
+static inline void emit_match(deflate_state* s, int len, int dist)
+{
+    s->sym_len[s->syms] = (uint8_t)(len - DEFLATE_MIN_MATCH);
+    s->sym_dist[s->syms++] = (uint16_t)dist;
+    s->lit_freq[257 + s->length_sym[len]]++;
+    s->dist_freq[dist_code(s, dist)]++;
+    s->block_len += len;
+    if (s->syms == DEFLATE_BLOCK_SYMBOLS) flush_block(s, false);
+}
+
+// Bytes a and b have in common, at most limit.
+static inline int match_length(const unsigned char* a, const unsigned char* b, int limit)
+{
+    int len = 0;
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (len + 8 <= limit) {
+        uint64_t x, y;
+        memcpy(&x, a + len, 8);
+        memcpy(&y, b + len, 8);
+        if (x != y) return len + __builtin_ctzll(x ^ y) / 8;
+        len += 8;
+    }
+#endif
+    while (len < limit && a[len] == b[len]) len++;
+    return len;
+}
+
+static inline uint32_t hash3(const unsigned char* p)
+{
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (v * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+static inline void insert(deflate_state* s, int32_t pos)
+{
+    uint32_t h = hash3(s->base + pos);
+    s->prev[pos & (DEFLATE_WINDOW - 1)] = s->head[h];
+    s->head[h] = pos;
+}
+
+// Hash positions [from, to), as far as 3 bytes remain.
+static inline void insert_range(deflate_state* s, int32_t from, int32_t to)
+{
+    to = MIN(to, s->end - DEFLATE_MIN_MATCH + 1);
+    for (int32_t i = from; i < to; i++) insert(s, i);
+}
+
+// Longest match for pos among chain candidates of its hash, which must not include pos.
+// returns the length (< DEFLATE_MIN_MATCH for none), *from its start
+static int longest_match(const deflate_state* s, int32_t pos, int chain, int32_t* from)
+{
+    const unsigned char* cur = s->base + pos;
+    int limit = (int)MIN(s->end - pos, DEFLATE_MAX_MATCH);
+    int best = DEFLATE_MIN_MATCH - 1;
+    int32_t cand = s->head[hash3(cur)];
+    for (; chain > 0 && cand >= 0 && pos - cand <= DEFLATE_WINDOW; chain--) {
+        const unsigned char* p = s->base + cand;
+        if (p[best] == cur[best] && p[0] == cur[0]) {
+            int len = match_length(p, cur, limit);
+            if (len > best) {
+                best = len;
+                *from = cand;
+                if (len >= s->nice || len == limit) break;
+            }
+        }
+        int32_t next = s->prev[cand & (DEFLATE_WINDOW - 1)];
+        if (next >= cand) break; // slot reused by a newer position
+        cand = next;
+    }
+    return best;
+}
+
+static void deflate_rle(deflate_state* s, int32_t pos)
+{
+    while (pos < s->end) {
+        if (pos > 0) {
+            // run of the byte before, compared as overlapping strings
+            int run = match_length(s->base + pos - 1, s->base + pos, (int)MIN(s->end - pos, DEFLATE_MAX_MATCH));
+            if (run >= DEFLATE_MIN_MATCH) {
+                emit_match(s, run, 1);
+                pos += run;
+                continue;
+            }
+        }
+        emit_literal(s, s->base[pos++]);
+    }
+}
+
+static void deflate_fast(deflate_state* s, int32_t pos)
+{
+    while (pos + DEFLATE_MIN_MATCH <= s->end) {
+        int32_t from = 0;
+        int len = longest_match(s, pos, s->chain, &from);
+        insert(s, pos);
+        if (len >= DEFLATE_MIN_MATCH) {
+            emit_match(s, len, pos - from);
+            // hash the tail of long matches only, so long runs keep a recent candidate
+            insert_range(s, len <= DEFLATE_FAST_INSERT ? pos + 1 : pos + len - 2, pos + len);
+            pos += len;
+        }
+        else emit_literal(s, s->base[pos++]);
+    }
+    while (pos < s->end) emit_literal(s, s->base[pos++]);
+}
+
+static void deflate_lazy(deflate_state* s, int32_t pos)
+{
+    int prev_len = DEFLATE_MIN_MATCH - 1;
+    int32_t prev_from = 0;
+    bool pending = false; // byte at pos - 1 not emitted yet
+    while (pos < s->end) {
+        int len = DEFLATE_MIN_MATCH - 1;
+        int32_t from = 0;
+        if (pos + DEFLATE_MIN_MATCH <= s->end) {
+            if (prev_len < s->nice) {
+                // a good match already found needs less searching
+                int chain = prev_len >= 32 ? s->chain / 4 + 1 : s->chain;
+                len = longest_match(s, pos, chain, &from);
+                if (len == DEFLATE_MIN_MATCH && pos - from > DEFLATE_TOO_FAR) len = DEFLATE_MIN_MATCH - 1;
+            }
+            insert(s, pos);
+        }
+        if (prev_len >= DEFLATE_MIN_MATCH && len <= prev_len) {
+            // the match from pos - 1 wins
+            emit_match(s, prev_len, pos - 1 - prev_from);
+            insert_range(s, pos + 1, pos - 1 + prev_len);
+            pos += prev_len - 1;
+            pending = false;
+            prev_len = DEFLATE_MIN_MATCH - 1;
+            continue;
+        }
+        if (pending) emit_literal(s, s->base[pos - 1]);
+        pending = true;
+        prev_len = len;
+        prev_from = from;
+        pos++;
+    }
+    if (pending) emit_literal(s, s->base[pos - 1]);
+}
+
+unsigned char* img_deflate(const unsigned char* data, size_t dict_len, size_t len, int tier, int level, bool final,
+    size_t* out_len)
+{
+    deflate_state* s = (deflate_state*)malloc(sizeof(deflate_state));
+    if (!s) return NULL;
+    dict_len = MIN(dict_len, (size_t)DEFLATE_WINDOW);
+    s->base = data - dict_len;
+    s->end = (int32_t)(dict_len + len);
+    s->final = final;
+    s->syms = 0;
+    s->block_start = (int32_t)dict_len;
+    s->block_len = 0;
+    memset(s->lit_freq, 0, sizeof(s->lit_freq));
+    memset(s->dist_freq, 0, sizeof(s->dist_freq));
+    state_tables(s);
+    s->out.cap = len + len / 8 + 1024;
+    s->out.data = (unsigned char*)malloc(s->out.cap);
+    s->out.size = 0;
+    s->out.bits = 0;
+    s->out.count = 0;
+    s->out.failed = !s->out.data;
+    if (s->out.failed) {
+        free(s);
+        return NULL;
+    }
+
+    int32_t pos = (int32_t)dict_len;
+    if (tier == PNG_DEFLATE_RLE) deflate_rle(s, pos);
+    else {
+        level = level > 0 ? level : 8;
+        s->chain = tier == PNG_DEFLATE_FAST ? MAX(level / 2, 1) : 2 * level;
+        s->nice = tier == PNG_DEFLATE_FAST ? 32 : MIN(16 * level, DEFLATE_MAX_MATCH);
+        memset(s->head, 0xff, sizeof(s->head));
+        insert_range(s, 0, pos);
+        if (tier == PNG_DEFLATE_FAST) deflate_fast(s, pos);
+        else deflate_lazy(s, pos);
+    }
+    flush_block(s, true);
+
+    bit_writer* w = &s->out;
+    if (!final) {
+        // sync flush: empty stored block, byte aligned
+        put_bits(w, 0, 3);
+        align_bits(w);
+        static const unsigned char sync[4] = { 0x00, 0x00, 0xff, 0xff };
+        put_bytes(w, sync, 4);
+    }
+    else align_bits(w);
+
+    unsigned char* out = w->data;
+    *out_len = w->size;
+    bool failed = w->failed;
+    free(s);
+    if (failed) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+unsigned char* img_zlib_compress(unsigned char* data, int data_len, int* out_len, int quality)
+{
+    int tier = quality <= 1 ? PNG_DEFLATE_RLE : quality < 5 ? PNG_DEFLATE_FAST : PNG_DEFLATE_LAZY;
+    size_t len;
+    unsigned char* raw = img_deflate(data, 0, (size_t)data_len, tier, quality, true, &len);
+    if (!raw) return NULL;
+    unsigned char* out = (unsigned char*)malloc(len + 6);
+    if (!out) {
+        free(raw);
+        return NULL;
+    }
+    out[0] = 0x78; // 32K window
+    out[1] = 0x5e;
+    memcpy(out + 2, raw, len);
+    free(raw);
+    uint32_t adler = TCP_adler32(1, data, (size_t)data_len);
+    out[len + 2] = (unsigned char)(adler >> 24);
+    out[len + 3] = (unsigned char)(adler >> 16);
+    out[len + 4] = (unsigned char)(adler >> 8);
+    out[len + 5] = (unsigned char)adler;
+    *out_len = (int)(len + 6);
+    return out;
+}
@@ -0,0 +1,448 @@
+//
+// PNG row filter kernels.
+// The five filters (None, Sub, Up, Average, Paeth) and the sum of absolute
+// values that picks between them, in scalar, SSE2, AVX2 and NEON versions.
+// Encoding filters only read original pixels, so unlike decoding every byte
+// of a row is independent and the whole row vectorizes.
+// x86 kernels are compiled with target attributes and picked at run time
+// from CPUID; NEON is used when the build targets it (-mfpu=neon on the HPS,
+// always on AArch64). All versions produce the same bytes as the scalar one.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define FILTER_X86 1
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define FILTER_NEON 1
+    #include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__)
+#define FILTER_TARGET(isa) __attribute__((target(isa)))
+#else
+#define FILTER_TARGET(isa)
+#endif
+
+typedef unsigned char u8;
+
+// scalar
+
+static inline u8 paeth(int a, int b, int c)
+{
+    int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return (u8)a;
+    if (pb <= pc) return (u8)b;
+    return (u8)c;
+}
+
+// Scalar filters of bytes [i, len), the vector kernels finish their rows with these.
+static void sub_tail(const u8* z, int n, int i, int len, u8* out)
+{
+    for (; i < n && i < len; i++) out[i] = z[i];
+    for (; i < len; i++) out[i] = (u8)(z[i] - z[i - n]);
+}
+
+static void up_tail(const u8* z, const u8* up, int i, int len, u8* out)
+{
+    for (; i < len; i++) out[i] = (u8)(z[i] - up[i]);
+}
+
+static void avg_tail(const u8* z, const u8* up, int n, int i, int len, u8* out)
+{
+    for (; i < n && i < len; i++) out[i] = (u8)(z[i] - (up[i] >> 1));
+    for (; i < len; i++) out[i] = (u8)(z[i] - ((z[i - n] + up[i]) >> 1));
+}
+
+static void paeth_tail(const u8* z, const u8* up, int n, int i, int len, u8* out)
+{
+    for (; i < n && i < len; i++) out[i] = (u8)(z[i] - up[i]); // paeth(0, up, 0)
+    for (; i < len; i++) out[i] = (u8)(z[i] - paeth(z[i - n], up[i], up[i - n]));
+}
+
+static uint32_t cost_tail(const u8* line, int i, int len)
+{
+    uint32_t sum = 0;
+    for (; i < len; i++) sum += (uint32_t)abs((signed char)line[i]);
+    return sum;
+}
+
+static void none_filter(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    (void)up;
+    (void)n;
+    memcpy(out, z, len);
+}
+
+static void sub_scalar(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    (void)up;
+    sub_tail(z, n, 0, len, out);
+}
+
+static void up_scalar(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    (void)n;
+    up_tail(z, up, 0, len, out);
+}
+
+static void avg_scalar(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    avg_tail(z, up, n, 0, len, out);
+}
+
+static void paeth_scalar(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    paeth_tail(z, up, n, 0, len, out);
+}
+
+static uint32_t cost_scalar(const u8* line, int len)
+{
+    return cost_tail(line, 0, len);
+}
+
+static const img_filter_kernels kernels_scalar = {
+    "scalar", { none_filter, sub_scalar, up_scalar, avg_scalar, paeth_scalar }, cost_scalar
+};
+
+#ifdef FILTER_X86
+
+// SSE2
+
+#define SSE2 FILTER_TARGET("sse2")
+
+SSE2 static void sub_sse2(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    (void)up;
+    int i = n;
+    memcpy(out, z, MIN(n, len));
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(z + i));
+        __m128i a = _mm_loadu_si128((const __m128i*)(z + i - n));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_sub_epi8(x, a));
+    }
+    sub_tail(z, n, i, len, out);
+}
+
+SSE2 static void up_sse2(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    (void)n;
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(z + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(up + i));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_sub_epi8(x, b));
+    }
+    up_tail(z, up, i, len, out);
+}
+
+SSE2 static void avg_sse2(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    avg_tail(z, up, n, 0, MIN(n, len), out);
+    int i = n;
+    const __m128i one = _mm_set1_epi8(1);
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(z + i));
+        __m128i a = _mm_loadu_si128((const __m128i*)(z + i - n));
+        __m128i b = _mm_loadu_si128((const __m128i*)(up + i));
+        // pavgb rounds up, (a + b) >> 1 rounds down
+        __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_sub_epi8(x, avg));
+    }
+    avg_tail(z, up, n, i, len, out);
+}
+
+SSE2 static inline __m128i abs_epi16_sse2(__m128i x)
+{
+    return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+// Paeth predictor of 8 bytes widened to 16 bits.
+SSE2 static inline __m128i paeth_epi16_sse2(__m128i a, __m128i b, __m128i c)
+{
+    __m128i pa = abs_epi16_sse2(_mm_sub_epi16(b, c));
+    __m128i pb = abs_epi16_sse2(_mm_sub_epi16(a, c));
+    __m128i pc = abs_epi16_sse2(_mm_sub_epi16(_mm_add_epi16(a, b), _mm_add_epi16(c, c)));
+    __m128i not_a = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+    __m128i not_b = _mm_cmpgt_epi16(pb, pc);
+    __m128i bc = _mm_or_si128(_mm_and_si128(not_b, c), _mm_andnot_si128(not_b, b));
+    return _mm_or_si128(_mm_and_si128(not_a, bc), _mm_andnot_si128(not_a, a));
+}
+
+SSE2 static void paeth_sse2(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    paeth_tail(z, up, n, 0, MIN(n, len), out);
+    int i = n;
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(z + i));
+        __m128i a = _mm_loadu_si128((const __m128i*)(z + i - n));
+        __m128i b = _mm_loadu_si128((const __m128i*)(up + i));
+        __m128i c = _mm_loadu_si128((const __m128i*)(up + i - n));
+        __m128i lo = paeth_epi16_sse2(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero),
+            _mm_unpacklo_epi8(c, zero));
+        __m128i hi = paeth_epi16_sse2(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero),
+            _mm_unpackhi_epi8(c, zero));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_sub_epi8(x, _mm_packus_epi16(lo, hi)));
+    }
+    paeth_tail(z, up, n, i, len, out);
+}
+
+SSE2 static uint32_t cost_sse2(const u8* line, int len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero;
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(line + i));
+        // as unsigned bytes min(x, -x) is |x| of the signed byte, -128 included
+        __m128i mag = _mm_min_epu8(x, _mm_sub_epi8(zero, x));
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(mag, zero));
+    }
+    uint32_t total = (uint32_t)_mm_cvtsi128_si32(sum) + (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+    return total + cost_tail(line, i, len);
+}
+
+static const img_filter_kernels kernels_sse2 = {
+    "sse2", { none_filter, sub_sse2, up_sse2, avg_sse2, paeth_sse2 }, cost_sse2
+};
+
+// AVX2
+
+#define AVX2 FILTER_TARGET("avx2")
+
+AVX2 static void sub_avx2(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    (void)up;
+    int i = n;
+    memcpy(out, z, MIN(n, len));
+    for (; i + 32 <= len; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(z + i));
+        __m256i a = _mm256_loadu_si256((const __m256i*)(z + i - n));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_sub_epi8(x, a));
+    }
+    sub_tail(z, n, i, len, out);
+}
+
+AVX2 static void up_avx2(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    (void)n;
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(z + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(up + i));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_sub_epi8(x, b));
+    }
+    up_tail(z, up, i, len, out);
+}
+
+AVX2 static void avg_avx2(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    avg_tail(z, up, n, 0, MIN(n, len), out);
+    int i = n;
+    const __m256i one = _mm256_set1_epi8(1);
+    for (; i + 32 <= len; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(z + i));
+        __m256i a = _mm256_loadu_si256((const __m256i*)(z + i - n));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(up + i));
+        __m256i avg = _mm256_sub_epi8(_mm256_avg_epu8(a, b), _mm256_and_si256(_mm256_xor_si256(a, b), one));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_sub_epi8(x, avg));
+    }
+    avg_tail(z, up, n, i, len, out);
+}
+
+// Paeth predictor of 16 bytes widened to 16 bits.
+AVX2 static inline __m256i paeth_epi16_avx2(__m256i a, __m256i b, __m256i c)
+{
+    __m256i pa = _mm256_abs_epi16(_mm256_sub_epi16(b, c));
+    __m256i pb = _mm256_abs_epi16(_mm256_sub_epi16(a, c));
+    __m256i pc = _mm256_abs_epi16(_mm256_sub_epi16(_mm256_add_epi16(a, b), _mm256_add_epi16(c, c)));
+    __m256i not_a = _mm256_or_si256(_mm256_cmpgt_epi16(pa, pb), _mm256_cmpgt_epi16(pa, pc));
+    __m256i not_b = _mm256_cmpgt_epi16(pb, pc);
+    return _mm256_blendv_epi8(a, _mm256_blendv_epi8(b, c, not_b), not_a);
+}
+
+AVX2 static void paeth_avx2(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    paeth_tail(z, up, n, 0, MIN(n, len), out);
+    int i = n;
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(z + i));
+        __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(z + i - n)));
+        __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(up + i)));
+        __m256i c = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(up + i - n)));
+        __m256i p = paeth_epi16_avx2(a, b, c);
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(p), _mm256_extracti128_si256(p, 1));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_sub_epi8(x, packed));
+    }
+    paeth_tail(z, up, n, i, len, out);
+}
+
+AVX2 static uint32_t cost_avx2(const u8* line, int len)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sum = zero;
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(line + i));
+        __m256i mag = _mm256_min_epu8(x, _mm256_sub_epi8(zero, x));
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(mag, zero));
+    }
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    uint32_t total = (uint32_t)_mm_cvtsi128_si32(half) + (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(half, 8));
+    return total + cost_tail(line, i, len);
+}
+
+static const img_filter_kernels kernels_avx2 = {
+    "avx2", { none_filter, sub_avx2, up_avx2, avg_avx2, paeth_avx2 }, cost_avx2
+};
+
+// Best x86 kernels the CPU and OS support.
+static int x86_best(void)
+{
+#if defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return PNG_SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2")) return PNG_SIMD_SSE2;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    __cpuid(info, 1);
+    bool sse2 = (info[3] >> 26) & 1;
+    bool osxsave = (info[2] >> 27) & 1;
+    if (max_leaf >= 7 && osxsave && (_xgetbv(0) & 6) == 6) {
+        __cpuidex(info, 7, 0);
+        if ((info[1] >> 5) & 1) return PNG_SIMD_AVX2;
+    }
+    if (sse2) return PNG_SIMD_SSE2;
+#endif
+    return PNG_SIMD_SCALAR;
+}
+
+#endif // FILTER_X86
+
+#ifdef FILTER_NEON
+
+static void sub_neon(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    (void)up;
+    int i = n;
+    memcpy(out, z, MIN(n, len));
+    for (; i + 16 <= len; i += 16) vst1q_u8(out + i, vsubq_u8(vld1q_u8(z + i), vld1q_u8(z + i - n)));
+    sub_tail(z, n, i, len, out);
+}
+
+static void up_neon(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    (void)n;
+    int i = 0;
+    for (; i + 16 <= len; i += 16) vst1q_u8(out + i, vsubq_u8(vld1q_u8(z + i), vld1q_u8(up + i)));
+    up_tail(z, up, i, len, out);
+}
+
+static void avg_neon(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    avg_tail(z, up, n, 0, MIN(n, len), out);
+    int i = n;
+    for (; i + 16 <= len; i += 16) {
+        // vhadd rounds down like (a + b) >> 1
+        uint8x16_t avg = vhaddq_u8(vld1q_u8(z + i - n), vld1q_u8(up + i));
+        vst1q_u8(out + i, vsubq_u8(vld1q_u8(z + i), avg));
+    }
+    avg_tail(z, up, n, i, len, out);
+}
+
+// Paeth predictor of 8 bytes, narrowed back.
+static inline uint8x8_t paeth_neon8(uint8x8_t a8, uint8x8_t b8, uint8x8_t c8)
+{
+    int16x8_t a = vreinterpretq_s16_u16(vmovl_u8(a8));
+    int16x8_t b = vreinterpretq_s16_u16(vmovl_u8(b8));
+    int16x8_t c = vreinterpretq_s16_u16(vmovl_u8(c8));
+    int16x8_t pa = vabdq_s16(b, c);
+    int16x8_t pb = vabdq_s16(a, c);
+    int16x8_t pc = vabsq_s16(vsubq_s16(vaddq_s16(a, b), vaddq_s16(c, c)));
+    uint16x8_t not_a = vorrq_u16(vcgtq_s16(pa, pb), vcgtq_s16(pa, pc));
+    uint16x8_t not_b = vcgtq_s16(pb, pc);
+    uint8x8_t bc = vbsl_u8(vmovn_u16(not_b), c8, b8);
+    return vbsl_u8(vmovn_u16(not_a), bc, a8);
+}
+
+static void paeth_neon(const u8* z, const u8* up, int n, int len, u8* out)
+{
+    paeth_tail(z, up, n, 0, MIN(n, len), out);
+    int i = n;
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t a = vld1q_u8(z + i - n), b = vld1q_u8(up + i), c = vld1q_u8(up + i - n);
+        uint8x8_t lo = paeth_neon8(vget_low_u8(a), vget_low_u8(b), vget_low_u8(c));
+        uint8x8_t hi = paeth_neon8(vget_high_u8(a), vget_high_u8(b), vget_high_u8(c));
+        vst1q_u8(out + i, vsubq_u8(vld1q_u8(z + i), vcombine_u8(lo, hi)));
+    }
+    paeth_tail(z, up, n, i, len, out);
+}
+
+static uint32_t cost_neon(const u8* line, int len)
+{
+    uint32x4_t sum = vdupq_n_u32(0);
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        int8x16_t x = vreinterpretq_s8_u8(vld1q_u8(line + i));
+        // |x| of a signed byte fits unsigned, -128 included
+        uint8x16_t mag = vreinterpretq_u8_s8(vabsq_s8(x));
+        sum = vpadalq_u16(sum, vpaddlq_u8(mag));
+    }
+    uint64x2_t pairs = vpaddlq_u32(sum);
+    uint32_t total = (uint32_t)(vgetq_lane_u64(pairs, 0) + vgetq_lane_u64(pairs, 1));
+    return total + cost_tail(line, i, len);
+}
+
+static const img_filter_kernels kernels_neon = {
+    "neon", { none_filter, sub_neon, up_neon, avg_neon, paeth_neon }, cost_neon
+};
+
+#endif // FILTER_NEON
+
+// Best PNG_SIMD_* level of this build and CPU.
+static int best_simd(void)
+{
+    static int best;
+    if (best) return best;
+#if defined(FILTER_X86)
+    best = x86_best();
+#elif defined(FILTER_NEON)
+    best = PNG_SIMD_NEON;
+#else
+    best = PNG_SIMD_SCALAR;
+#endif
+    return best;
+}
+
+bool png_simd_supported(int simd)
+{
+    return img_filter_kernels_for(simd) != NULL;
+}
+
+const img_filter_kernels* img_filter_kernels_for(int simd)
+{
+    int best = best_simd();
+    if (simd == PNG_SIMD_AUTO) simd = best;
+    switch (simd) {
+    case PNG_SIMD_SCALAR: return &kernels_scalar;
+#ifdef FILTER_X86
+    case PNG_SIMD_SSE2: return best >= PNG_SIMD_SSE2 ? &kernels_sse2 : NULL;
+    case PNG_SIMD_AVX2: return best >= PNG_SIMD_AVX2 ? &kernels_avx2 : NULL;
+#endif
+#ifdef FILTER_NEON
+    case PNG_SIMD_NEON: return &kernels_neon;
+#endif
+    default: return NULL;
+    }
+}
@@ -0,0 +1,285 @@
+//
+// Frame streams with inter-frame delta encoding.
+// Both ends keep the last frame. The sender transmits only the byte runs
+// that changed since then, the receiver patches its copy in place.
+// Keyframes carry the whole frame and resynchronize the stream.
+//
+// Delta payload: repeated (skip varint, copy varint, copy bytes) where skip
+// counts unchanged bytes and copy the new bytes that follow them.
+// Bytes after the last run are unchanged.
+//
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <winsock2.h>
+#else
+    #include <unistd.h>
+    #include <sys/socket.h>
+    #include <errno.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+#define NET_DELTA_MAXRUN 20 // two varints
+
+struct net_frame_stream {
+    size_t size;
+    int keyframe_interval;
+    int since_key;      // frames sent since the last keyframe
+    bool have_ref;
+    char* ref;          // last frame sent / received
+    char* scratch;      // encoded delta
+    size_t scratch_cap;
+    uint64_t trace_capture; // TCP_frame_stream_trace() stamp for the next frame, 0 if untraced
+    net_frame_stats stats;
+};
+
+net_frame_stream* TCP_frame_stream_create(size_t frame_size, int keyframe_interval)
+{
+    if (!frame_size || (frame_size & ~(size_t)0x7fffffff) || keyframe_interval < 0) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return NULL;
+    }
+    net_frame_stream* stream = (net_frame_stream*)calloc(1, sizeof(net_frame_stream));
+    if (stream) stream->ref = (char*)malloc(frame_size);
+    if (!stream || !stream->ref) {
+        fprintf(stderr, "ERROR: Out of memory!\n");
+        free(stream);
+        return NULL;
+    }
+    stream->size = frame_size;
+    stream->keyframe_interval = keyframe_interval;
+    return stream;
+}
+
+void TCP_frame_stream_destroy(net_frame_stream* stream)
+{
+    if (!stream) return;
+    free(stream->ref);
+    free(stream->scratch);
+    free(stream);
+}
+
+void TCP_frame_stream_reset(net_frame_stream* stream)
+{
+    stream->have_ref = false;
+}
+
+void TCP_frame_stream_trace(net_frame_stream* stream, uint64_t capture_ns)
+{
+    stream->trace_capture = capture_ns ? capture_ns : net_now_ns();
+}
+
+const char* TCP_frame_data(const net_frame_stream* stream)
+{
+    return stream->have_ref ? stream->ref : NULL;
+}
+
+void TCP_frame_get_stats(const net_frame_stream* stream, net_frame_stats* stats)
+{
+    *stats = stream->stats;
+}
+
+static bool scratch_reserve(net_frame_stream* stream, size_t capacity)
+{
+    if (capacity <= stream->scratch_cap) return true;
+    char* scratch = (char*)realloc(stream->scratch, capacity);
+    if (!scratch) return false;
+    stream->scratch = scratch;
+    stream->scratch_cap = capacity;
+    return true;
+}
+
+static inline uint64_t load64(const unsigned char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline size_t put_varint(unsigned char* p, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (unsigned char)v;
+    return n;
+}
+
+// returns bytes read, 0 if malformed
+static inline size_t get_varint(const unsigned char* p, const unsigned char* end, uint64_t* v)
+{
+    *v = 0;
+    for (size_t n = 0; n < 10 && p + n < end; n++) {
+        *v |= (uint64_t)(p[n] & 0x7f) << (7 * n);
+        if (!(p[n] & 0x80)) return n + 1;
+    }
+    return 0;
+}
+
+// Encode cur against ref into out, updating ref to cur as it goes.
+// Unchanged stretches shorter than 8 bytes are folded into the copy.
+// returns encoded size, -1 if it would reach limit (ref partially updated)
+static int64_t delta_encode(const unsigned char* cur, unsigned char* ref, size_t size, unsigned char* out, size_t limit)
+{
+    size_t pos = 0, out_len = 0;
+    while (pos < size) {
+        size_t start = pos;
+        while (pos + 8 <= size && load64(cur + pos) == load64(ref + pos)) pos += 8;
+        while (pos < size && cur[pos] == ref[pos]) pos++;
+        if (pos == size) break;
+
+        size_t end = pos;
+        while (end + 8 <= size && load64(cur + end) != load64(ref + end)) end += 8;
+        if (end + 8 > size) end = size;
+
+        size_t copy = end - pos;
+        if (out_len + NET_DELTA_MAXRUN + copy >= limit) return -1;
+        out_len += put_varint(out + out_len, pos - start);
+        out_len += put_varint(out + out_len, copy);
+        memcpy(out + out_len, cur + pos, copy);
+        memcpy(ref + pos, cur + pos, copy);
+        out_len += copy;
+        pos = end;
+    }
+    return (int64_t)out_len;
+}
+
+// Apply an encoded delta to frame in place.
+// returns 0, -1 if malformed
+static int delta_apply(unsigned char* frame, size_t size, const unsigned char* in, size_t len)
+{
+    const unsigned char* end = in + len;
+    size_t pos = 0;
+    while (in < end) {
+        uint64_t skip, copy;
+        size_t n = get_varint(in, end, &skip);
+        if (!n) return -1;
+        in += n;
+        n = get_varint(in, end, &copy);
+        if (!n) return -1;
+        in += n;
+        if (skip > size - pos || copy > size - pos - skip || copy > (uint64_t)(end - in)) return -1;
+        pos += (size_t)skip;
+        memcpy(frame + pos, in, (size_t)copy);
+        in += copy;
+        pos += (size_t)copy;
+    }
+    return 0;
+}
+
+int64_t TCP_send_frame(socket_t socket, net_frame_stream* stream, const char* frame)
+{
+    if (!stream || !frame) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    net_header header;
+    memset(&header, 0, sizeof(header));
+    header.seq = net_next_seq();
+
+    bool key = !stream->have_ref ||
+        (stream->keyframe_interval && stream->since_key >= stream->keyframe_interval);
+    int64_t delta_len = -1;
+    if (!key) {
+        if (!scratch_reserve(stream, stream->size)) {
+            fprintf(stderr, "ERROR: Out of memory!\n");
+            return -1;
+        }
+        // a delta no smaller than the frame is sent as a keyframe
+        delta_len = delta_encode((const unsigned char*)frame, (unsigned char*)stream->ref, stream->size,
+            (unsigned char*)stream->scratch, stream->size);
+    }
+
+    int ret;
+    const char* payload = frame;
+    if (delta_len >= 0) {
+        header.type = NET_MSG_FRAME_DELTA;
+        header.length = (uint64_t)delta_len;
+        payload = stream->scratch;
+    }
+    else {
+        header.type = NET_MSG_FRAME_KEY;
+        header.length = stream->size;
+    }
+    if (stream->trace_capture) {
+        ret = TCP_send_traced(socket, &header, payload, stream->trace_capture, net_now_ns());
+        stream->trace_capture = 0;
+    }
+    else ret = TCP_send_msg(socket, &header, payload);
+    if (delta_len >= 0) stream->since_key++;
+    else {
+        memcpy(stream->ref, frame, stream->size);
+        stream->since_key = 1;
+        stream->stats.keyframes++;
+    }
+    if (ret == -1) {
+        // the receiver's reference is unknown now
+        stream->have_ref = false;
+        return -1;
+    }
+    stream->have_ref = true;
+    stream->stats.frames++;
+    stream->stats.bytes_raw += stream->size;
+    stream->stats.bytes_wire += header.length + NET_HEADER_SIZE;
+    return (int64_t)header.length;
+}
+
+int64_t TCP_recv_frame(socket_t socket, net_frame_stream* stream)
+{
+    if (!stream) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    net_header header;
+    uint64_t wire;
+    if (recv_header(socket, &header) == -1) return -1;
+    if (recv_raw_size(socket, &header, &wire) == -1) return -1;
+
+    if (header.type == NET_MSG_FRAME_KEY && header.length == stream->size) {
+        // straight into the frame
+        if (recv_payload(socket, &header, wire, stream->ref) == -1) {
+            stream->have_ref = false;
+            return -1;
+        }
+        stream->have_ref = true;
+        stream->stats.keyframes++;
+    }
+    else if (header.type == NET_MSG_FRAME_DELTA && stream->have_ref && header.length <= stream->size) {
+        if (!scratch_reserve(stream, (size_t)header.length)) {
+            fprintf(stderr, "ERROR: Out of memory!\n");
+            TCP_close(socket);
+            return -1;
+        }
+        if (recv_payload(socket, &header, wire, stream->scratch) == -1) {
+            stream->have_ref = false;
+            return -1;
+        }
+        if (delta_apply((unsigned char*)stream->ref, stream->size, (const unsigned char*)stream->scratch,
+                (size_t)header.length) == -1) {
+            fprintf(stderr, "ERROR: Malformed frame delta!\n");
+            stream->have_ref = false;
+            TCP_close(socket);
+            return -1;
+        }
+    }
+    else {
+        fprintf(stderr, "ERROR: Unexpected frame message!\n");
+        stream->have_ref = false;
+        TCP_close(socket);
+        return -1;
+    }
+
+    stream->stats.frames++;
+    stream->stats.bytes_raw += stream->size;
+    stream->stats.bytes_wire += header.length + NET_HEADER_SIZE;
+    return (int64_t)stream->size;
+}
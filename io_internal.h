@@ -0,0 +1,401 @@
+//
+// Internal helpers shared between the IO translation units.
+// Not part of the public API, include after the platform headers and io.h.
+//
+
+#ifndef IO_INTERNAL_H
+#define IO_INTERNAL_H
+
+#include "io.h"
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+#define NET_TIMEOUT 30
+#define NET_MAXINIT 11 // max size of init message
+#define NET_MAXHEADER (NET_HEADER_SIZE > NET_MAXINIT ? NET_HEADER_SIZE : NET_MAXINIT)
+
+#ifdef _WIN32
+#define TCP_ERRNO WSAGetLastError()
+#define TCP_WOULDBLOCK(err) ((err) == WSAEWOULDBLOCK)
+#define TCP_PEER_GONE(err) ((err) == WSAECONNRESET || (err) == WSAECONNABORTED)
+#else
+#define TCP_ERRNO errno
+#define TCP_WOULDBLOCK(err) ((err) == EAGAIN || (err) == EWOULDBLOCK)
+#define TCP_PEER_GONE(err) ((err) == EPIPE || (err) == ECONNRESET)
+#endif
+
+// Send flag that fails sends to a closed peer with EPIPE instead of raising
+// SIGPIPE. Where it is missing (BSD, macOS) see net_set_nosigpipe().
+#ifdef MSG_NOSIGNAL
+#define NET_NOSIGNAL MSG_NOSIGNAL
+#else
+#define NET_NOSIGNAL 0
+#endif
+
+// io_stats.c
+
+// Process-wide counters, see TCP_get_stats().
+extern net_stats net_totals;
+
+// Counters of socket, claiming a table slot on first use.
+// NULL if the table is full (the totals still count).
+net_stats* net_stats_find(socket_t socket);
+
+// Free the slot of a closing socket.
+void net_stats_release(socket_t socket);
+
+// Monotonic clock for latencies.
+uint64_t net_now_ns(void);
+
+typedef struct net_trace_log net_trace_log;
+
+// Where socket keeps its trace log (io_trace.c), freed with the slot.
+// create claims a slot if the socket has none. NULL if there is none.
+net_trace_log** net_stats_trace(socket_t socket, bool create);
+
+// Count one complete message of bytes payload. start_ns from net_now_ns()
+// feeds the histograms, 0 counts the message only.
+void net_count_msg(net_stats* stats, bool recv, uint64_t bytes, uint64_t start_ns);
+
+static inline void net_stat_add(uint64_t* counter, uint64_t value)
+{
+#if defined(__GNUC__)
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+#elif defined(_WIN32)
+    InterlockedExchangeAdd64((volatile LONG64*)counter, (LONG64)value);
+#else
+    *counter += value;
+#endif
+}
+
+// Count one send/recv-family syscall on stats (optional) and the totals.
+static inline void net_count_syscall(net_stats* stats)
+{
+    net_stat_add(&net_totals.syscalls, 1);
+    if (stats) net_stat_add(&stats->syscalls, 1);
+}
+
+// Count the bytes one call moved (-1 on failure) out of asked.
+static inline void net_count_bytes(net_stats* stats, bool recv, int64_t moved, uint64_t asked)
+{
+    if (moved <= 0) return;
+    net_dir_stats* total = recv ? &net_totals.recv : &net_totals.send;
+    net_stat_add(&total->bytes, (uint64_t)moved);
+    if ((uint64_t)moved < asked) net_stat_add(&total->partial, 1);
+    if (stats) {
+        net_dir_stats* dir = recv ? &stats->recv : &stats->send;
+        net_stat_add(&dir->bytes, (uint64_t)moved);
+        if ((uint64_t)moved < asked) net_stat_add(&dir->partial, 1);
+    }
+}
+
+static inline void put_le16(unsigned char* p, uint16_t v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static inline void put_le32(unsigned char* p, uint32_t v)
+{
+    put_le16(p, (uint16_t)v);
+    put_le16(p + 2, (uint16_t)(v >> 16));
+}
+
+static inline void put_le64(unsigned char* p, uint64_t v)
+{
+    put_le32(p, (uint32_t)v);
+    put_le32(p + 4, (uint32_t)(v >> 32));
+}
+
+static inline uint16_t get_le16(const unsigned char* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t get_le32(const unsigned char* p)
+{
+    return get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+static inline uint64_t get_le64(const unsigned char* p)
+{
+    return get_le32(p) | ((uint64_t)get_le32(p + 4) << 32);
+}
+
+// io.c
+
+// Payload cap for the server and async receives, see TCP_set_max_message().
+extern uint64_t net_max_message;
+
+// Blocking send/recv loops, -1 for error (with socket cleanup).
+int64_t send_data(socket_t socket, const char* data, uint64_t total_size, const char* log_name);
+int64_t recv_data(socket_t socket, char* data, uint64_t total_size, const char* log_name);
+int64_t sendv_data(socket_t socket, const net_iovec* iov, int iovcnt, int flags, const char* log_name);
+
+// Receive and parse one header (either framing). Returns 0, -1 for error (with socket cleanup).
+int recv_header(socket_t socket, net_header* header);
+
+// Call after recv_header(). For a compressed message receives the raw size
+// ahead of the payload, sets header->length to it and *wire to the compressed
+// bytes still queued; *wire is 0 otherwise.
+// Returns 0, -1 for error (with socket cleanup).
+int recv_raw_size(socket_t socket, net_header* header, uint64_t* wire);
+
+// Receive the rest of the message into data (header->length bytes),
+// inflating wire compressed bytes if nonzero. Returns 0, -1 for error (with socket cleanup).
+int recv_payload(socket_t socket, const net_header* header, uint64_t wire, char* data);
+
+// Whether a payload of len bytes should be compressed under the current settings.
+bool net_compressible(uint64_t len);
+
+// Whether a message with these header flags gets NET_FLAG_CHECKSUM under the current settings.
+bool net_checksummed(uint16_t flags);
+
+// TCP_send_msg() without input checks, trailer (NULL for none) is a trace
+// trailer sent in the same syscall with send_end filled in.
+// Returns payload size, -1 for error (with socket cleanup).
+int net_send_msg(socket_t socket, const net_header* header, const char* data, unsigned char* trailer);
+
+struct addrinfo;
+
+// Resolve addr, port for connecting. Returns 0, -1 on failure; *server_info (freeaddrinfo).
+int net_resolve(const char* addr, const char* port, struct addrinfo** server_info);
+
+// Connect to the first reachable address, as TCP_connect3(). Returns INV_SOCKET on failure.
+socket_t net_connect_addrinfo(const struct addrinfo* server_info, const net_sockopts* opts, bool verbose);
+
+// Next process-wide sequence id for outgoing messages.
+uint32_t net_next_seq(void);
+
+// Encode header in the current framing into NET_MAXHEADER bytes.
+// Returns header size, -1 if not representable.
+int net_encode_frame(char* buffer, const net_header* header);
+
+// Header size in the current framing.
+int net_frame_header_size(void);
+
+// Header size given its first NET_MAXINIT bytes.
+int net_header_size(const unsigned char* buffer);
+
+// Parse a complete header. Returns 0, -1 if malformed.
+int net_decode_header(unsigned char* buffer, net_header* header);
+
+// io_lz.c
+
+#define NET_COMPRESS_PREFIX 4 // raw size ahead of compressed payloads
+
+// Minimum payload size to compress, 0 if disabled. See TCP_set_compression().
+extern unsigned net_compress_min;
+
+// Compress len bytes into out (at least len bytes) as NET_FLAG_COMPRESSED payload.
+// Returns payload size, -1 if that would not be smaller than len.
+int64_t net_compress(const char* data, size_t len, char* out);
+
+// Raw size stated by a compressed payload of len bytes (only its prefix is read),
+// -1 if malformed or more than len bytes can inflate to.
+int64_t net_inflated_size(const char* payload, size_t len);
+
+// Inflate a compressed payload into out (raw bytes). Returns 0, -1 if malformed.
+int net_inflate(const char* payload, size_t len, char* out, size_t raw);
+
+// Replace a compressed payload in buf with its raw bytes, updating size and header.length.
+// Returns 0, -1 if malformed, above net_max_message or out of memory.
+int net_buffer_inflate(net_buffer* buf);
+
+// io_deflate.c
+
+// Raw deflate of len bytes at data with PNG_DEFLATE_* tier, primed with the
+// dict_len bytes in front of it (the last 32 KiB count). level sets the
+// match search effort, 0 for default. final ends the stream, otherwise the
+// output ends in a sync flush on a byte boundary so the next band can follow.
+// Returns the output (free()) of *out_len bytes, NULL if out of memory.
+unsigned char* img_deflate(const unsigned char* data, size_t dict_len, size_t len, int tier, int level, bool final,
+    size_t* out_len);
+
+// zlib stream of data, the STBIW_ZLIB_COMPRESS hook. quality is
+// stbi_write_png_compression_level: 1 for rle, 2-4 fast, 5 and up lazy.
+unsigned char* img_zlib_compress(unsigned char* data, int data_len, int* out_len, int quality);
+
+// io_filter.c
+
+typedef void (*img_filter_fn)(const unsigned char* z, const unsigned char* up, int n, int len, unsigned char* out);
+
+// PNG row filters of one instruction set. filter[type] filters len bytes at z,
+// n per pixel, against the row above (zeroes for the first row); cost is the
+// sum of absolute values of the filtered bytes taken as signed.
+typedef struct img_filter_kernels {
+    const char* name;
+    img_filter_fn filter[5];
+    uint32_t (*cost)(const unsigned char* line, int len);
+} img_filter_kernels;
+
+// Kernels for PNG_SIMD_* simd, NULL if this build or CPU cannot run them.
+// Call once before starting threads, the first call probes the CPU.
+const img_filter_kernels* img_filter_kernels_for(int simd);
+
+// io_checksum.c
+
+// Whether sends attach payload CRC-32s, see TCP_set_checksum().
+extern bool net_checksum_on;
+
+// Adler-32 of two runs joined, len2 the length of the second.
+uint32_t img_adler32_combine(uint32_t adler1, uint32_t adler2, size_t len2);
+
+// CRC-32 of the payload fragments, as NET_FLAG_CHECKSUM messages carry it.
+uint32_t net_checksum_iov(const net_iovec* iov, int iovcnt);
+
+// Check the CRC-32 of a NET_FLAG_CHECKSUM message against its payload of len
+// bytes as received (before inflating). Returns false (with an error message)
+// on a mismatch, true for messages without the flag.
+bool net_checksum_ok(const net_header* header, const char* payload, size_t len);
+
+// io_trace.c
+
+// Bytes following the payload of a message with these header flags.
+static inline size_t net_trailer_size(uint16_t flags)
+{
+    return flags & NET_FLAG_TRACED ? NET_TRACE_SIZE : 0;
+}
+
+// Receive the trailer of a traced message and record it, arrival_ns when
+// its header was in. Returns 0, -1 for error (with socket cleanup).
+int net_trace_recv(socket_t socket, const net_header* header, uint64_t arrival_ns);
+
+// Record a traced message whose NET_TRACE_SIZE trailer is already received.
+void net_trace_record(socket_t socket, const net_header* header, const unsigned char* trailer, uint64_t arrival_ns,
+    uint64_t received_ns);
+
+// io_local.c
+
+#define NET_LOCAL_NONE 0
+#define NET_LOCAL_UNIX 1 // unix:<path>
+#define NET_LOCAL_SHM 2  // shm:<path>
+
+// NET_LOCAL_* scheme of an address.
+int net_local_scheme(const char* addr);
+
+// TCP_connect3() / TCP_listen3() for unix: and shm: addresses.
+socket_t net_local_connect(const char* addr, const net_sockopts* opts, bool verbose);
+socket_t net_local_listen(const char* addr, const net_sockopts* opts, bool verbose);
+
+typedef struct net_shm net_shm;
+
+#if defined(__linux__)
+// Open shm: sockets, listeners included. The blocking loops look up
+// their socket only while this is nonzero.
+extern int net_shm_count;
+
+net_shm* net_shm_find(socket_t socket);
+
+static inline net_shm* net_shm_get(socket_t socket)
+{
+    return __atomic_load_n(&net_shm_count, __ATOMIC_RELAXED) ? net_shm_find(socket) : NULL;
+}
+
+// Finish accepting on a shm: listener (no-op for other listeners).
+// Returns client_socket, INV_SOCKET for error (with socket cleanup).
+socket_t net_local_accepted(socket_t listen_socket, socket_t client_socket);
+
+// Ring loops, same contract as sendv_data/recv_data. peek leaves the bytes queued.
+int64_t net_shm_sendv(net_shm* shm, const net_iovec* iov, int iovcnt, const char* log_name);
+int64_t net_shm_recv(net_shm* shm, char* data, uint64_t total_size, bool peek, const char* log_name);
+
+// Mark the send direction finished, the peer reads the rest then gets EOF.
+void net_shm_shutdown(net_shm* shm);
+
+// Unmap the rings of a closing socket, waking the peer.
+void net_shm_close(socket_t socket);
+#else
+#define net_shm_get(socket) ((net_shm*)NULL)
+#define net_local_accepted(listen_socket, client_socket) (client_socket)
+#endif
+
+// io_thread.c
+
+// One share of a net_run_jobs() call. Returns 0, -1 for failure.
+typedef int (*net_job_fn)(void* job);
+
+// Run fn on count jobs of job_size bytes each: jobs[1..count) on their own
+// threads and jobs[0] on this one. Jobs that do not get a thread run here
+// afterwards if run_unstarted; otherwise none run on this thread and it fails.
+// Returns 0, -1 if a job failed or a thread could not start.
+int net_run_jobs(void* jobs, size_t job_size, int count, net_job_fn fn, bool run_unstarted);
+
+// io_poll.c
+
+// Switch socket between blocking and non-blocking mode. Returns 0, -1 on failure.
+int net_set_nonblocking(socket_t socket, bool nonblocking);
+
+// Keep sends on socket from raising SIGPIPE where NET_NOSIGNAL cannot (SO_NOSIGPIPE).
+void net_set_nosigpipe(socket_t socket);
+
+#define NET_POLL_IN 1
+#define NET_POLL_OUT 2
+#define NET_POLL_ERR 4 // error or hangup, always reported
+
+typedef struct net_poll_event {
+    void* ptr;       // as registered
+    unsigned events; // NET_POLL_*
+} net_poll_event;
+
+// Readiness poller: epoll on Linux, poll()/WSAPoll() elsewhere.
+// Level-triggered.
+typedef struct net_poller net_poller;
+
+net_poller* net_poller_create(void);
+void net_poller_destroy(net_poller* poller);
+int net_poller_add(net_poller* poller, socket_t socket, unsigned events, void* ptr);
+int net_poller_mod(net_poller* poller, socket_t socket, unsigned events, void* ptr);
+int net_poller_del(net_poller* poller, socket_t socket);
+
+// Wait up to timeout_ms (-1 forever) for events.
+// Returns number of events stored (0 on timeout), -1 on failure.
+int net_poller_wait(net_poller* poller, net_poll_event* events, int max_events, int timeout_ms);
+
+// Wait up to timeout_ms for one socket. Returns NET_POLL_* that are ready (0 on timeout), -1 on failure.
+int net_poll_socket(socket_t socket, unsigned events, int timeout_ms);
+
+// io_uring.c
+
+#ifdef NET_HAVE_URING
+#include <linux/io_uring.h>
+
+#define NET_URING_MAXIOV 64
+
+typedef struct net_uring net_uring;
+
+net_uring* net_uring_create(unsigned entries);
+void net_uring_destroy(net_uring* ring);
+int net_uring_fd(const net_uring* ring);
+
+// Next free submission entry (zeroed), NULL if the ring is full.
+struct io_uring_sqe* net_uring_sqe(net_uring* ring);
+
+// Submit prepared entries and wait for wait_nr completions in one syscall.
+// Returns entries submitted, -1 on failure.
+int net_uring_submit(net_uring* ring, unsigned wait_nr);
+
+// Pop one completion. Returns false if none is ready.
+bool net_uring_peek(net_uring* ring, uint64_t* user_data, int32_t* res, uint32_t* flags);
+
+// Register a provided-buffer ring for multishot receives. Returns 0, -1 on failure.
+int net_uring_register_bufring(net_uring* ring, void* mem, unsigned entries, unsigned group);
+
+// Calling thread's ring for blocking calls, NULL if unavailable.
+net_uring* net_uring_thread(void);
+
+// Whether blocking calls on this thread should use io_uring.
+bool net_uring_active(void);
+
+// Blocking loops on the thread ring, same contract as sendv_data/recv_data.
+int64_t net_uring_sendv(socket_t socket, const net_iovec* iov, int iovcnt, int flags, const char* log_name);
+int64_t net_uring_recv(socket_t socket, char* data, uint64_t total_size, const char* log_name);
+#endif
+
+#endif
@@ -0,0 +1,812 @@
+//
+// Same-host transports, chosen by address scheme:
+//   unix:<path>  Unix domain stream socket (unix:@name: Linux abstract namespace)
+//   shm:<path>   shared-memory rings, Linux only
+// A shm: connection is a Unix socket at <path> for the handshake and hangup
+// detection plus a memfd segment holding one ring per direction. Each ring
+// is mapped twice back to back, so every message is contiguous in memory.
+// Data moves with one memcpy per side (none with TCP_shm_reserve() and
+// TCP_shm_recv()), and a side sleeps on a futex only when its ring is
+// empty or full. A ring that fits in cache is fastest for copies: every
+// byte of a larger one is written back to memory once per lap.
+//
+// Segment: one page of control words, then the client to server ring,
+// then the server to client ring.
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE 1 // MAP_ANONYMOUS, MSG_CMSG_CLOEXEC
+#endif
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <winsock2.h>
+#else
+    #include <unistd.h>
+    #include <stddef.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <sys/time.h>
+    #include <errno.h>
+#endif
+#ifdef __linux__
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/syscall.h>
+    #include <linux/futex.h>
+    #include <limits.h>
+    #include <poll.h>
+    #include <pthread.h>
+    #include <time.h>
+    #define NET_HAVE_SHM 1
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+int net_local_scheme(const char* addr)
+{
+    if (!addr) return NET_LOCAL_NONE;
+    if (strncmp(addr, "unix:", 5) == 0) return NET_LOCAL_UNIX;
+    if (strncmp(addr, "shm:", 4) == 0) return NET_LOCAL_SHM;
+    return NET_LOCAL_NONE;
+}
+
+#ifndef _WIN32
+// Fill sa with the path after the scheme. A leading '@' names an abstract socket.
+// returns 0, -1 if the path is empty or too long
+static int local_address(const char* addr, struct sockaddr_un* sa, socklen_t* len)
+{
+    const char* path = strchr(addr, ':') + 1;
+    size_t n = strlen(path);
+    memset(sa, 0, sizeof(*sa));
+    sa->sun_family = AF_UNIX;
+    if (!n || n >= sizeof(sa->sun_path)) {
+        fprintf(stderr, "ERROR: Invalid local address %s!\n", addr);
+        return -1;
+    }
+    memcpy(sa->sun_path, path, n);
+#ifdef __linux__
+    if (path[0] == '@') sa->sun_path[0] = 0;
+#endif
+    *len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + n);
+    return 0;
+}
+#endif
+
+#ifdef NET_HAVE_SHM
+
+#define SHM_MAGIC 0x314d4853u         // "SHM1"
+#define SHM_RING_DEFAULT (1u << 20)   // bytes per direction, small enough to stay in cache
+#define SHM_RING_MAX (1u << 30)
+#define SHM_SLICE_MS 100              // futex sleep between hangup checks
+
+#define SHM_WRITER_CLOSED 1 // nothing more after head
+#define SHM_READER_CLOSED 2 // nobody drains the ring
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 1U
+#endif
+
+// Shared state of one direction, head and tail on their own cache lines.
+typedef struct shm_ctl {
+    uint64_t head;            // bytes written, moved by the writer
+    char pad0[56];
+    uint64_t tail;            // bytes read, moved by the reader
+    char pad1[56];
+    uint32_t data_seq;        // futex, bumped to wake the reader
+    uint32_t space_seq;       // futex, bumped to wake the writer
+    uint32_t reader_waiting;  // bytes the sleeping reader needs, 0 if awake
+    uint32_t writer_waiting;  // free bytes the sleeping writer needs, 0 if awake
+    uint32_t closed;          // SHM_*_CLOSED
+    char pad2[44];
+} shm_ctl;
+
+typedef struct shm_segment {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t ring_size;
+    char pad[48];
+    shm_ctl dir[2]; // [0] client to server, [1] server to client
+} shm_segment;
+
+typedef struct shm_ring {
+    shm_ctl* ctl;
+    char* data; // ring_size bytes, mapped twice in a row
+} shm_ring;
+
+struct net_shm {
+    socket_t socket;       // Unix socket: handshake, hangup
+    bool listener;
+    size_t page;
+    size_t ring_size;
+    shm_segment* segment;
+    shm_ring tx, rx;
+    int send_timeout_ms;   // from SO_SNDTIMEO / SO_RCVTIMEO, 0 for none
+    int recv_timeout_ms;
+    size_t reserved;       // payload bytes handed out by TCP_shm_reserve()
+    int reserved_header;
+    uint64_t pending;      // bytes of the message handed out by TCP_shm_recv()
+    net_buffer inflated;   // TCP_shm_recv() of compressed messages
+    net_stats* stats;      // ring transfers are counted here, they make no syscalls
+    net_shm* next;
+};
+
+int net_shm_count = 0;
+static net_shm* shm_list = NULL;
+static pthread_mutex_t shm_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t shm_ring_size = SHM_RING_DEFAULT;
+
+void TCP_set_shm_ring(size_t size)
+{
+    shm_ring_size = size ? MIN(size, (size_t)SHM_RING_MAX) : SHM_RING_DEFAULT;
+}
+
+net_shm* net_shm_find(socket_t socket)
+{
+    pthread_mutex_lock(&shm_lock);
+    net_shm* shm = shm_list;
+    while (shm && shm->socket != socket) shm = shm->next;
+    pthread_mutex_unlock(&shm_lock);
+    return shm;
+}
+
+static void shm_register(net_shm* shm)
+{
+    if (!shm->listener) shm->stats = net_stats_find(shm->socket);
+    pthread_mutex_lock(&shm_lock);
+    shm->next = shm_list;
+    shm_list = shm;
+    __atomic_add_fetch(&net_shm_count, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&shm_lock);
+}
+
+static net_shm* shm_unregister(socket_t socket)
+{
+    pthread_mutex_lock(&shm_lock);
+    net_shm** p = &shm_list;
+    while (*p && (*p)->socket != socket) p = &(*p)->next;
+    net_shm* shm = *p;
+    if (shm) {
+        *p = shm->next;
+        __atomic_sub_fetch(&net_shm_count, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&shm_lock);
+    return shm;
+}
+
+static void futex_wake(uint32_t* word)
+{
+    __atomic_add_fetch(word, 1, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// returns false on timeout
+static bool futex_wait(uint32_t* word, uint32_t seen, int timeout_ms)
+{
+    struct timespec ts = { timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000 };
+    return syscall(SYS_futex, word, FUTEX_WAIT, seen, &ts, NULL, 0) == 0 || errno != ETIMEDOUT;
+}
+
+// The Unix socket carries nothing after the handshake, readable means hangup.
+static bool peer_gone(const net_shm* shm)
+{
+    struct pollfd p = { shm->socket, POLLIN, 0 };
+    return poll(&p, 1, 0) != 0;
+}
+
+static inline uint64_t rx_avail(const net_shm* shm)
+{
+    return __atomic_load_n(&shm->rx.ctl->head, __ATOMIC_SEQ_CST) - shm->rx.ctl->tail;
+}
+
+static inline uint64_t tx_space(const net_shm* shm)
+{
+    return shm->ring_size - (shm->tx.ctl->head - __atomic_load_n(&shm->tx.ctl->tail, __ATOMIC_SEQ_CST));
+}
+
+// Make send ring bytes up to head visible, waking the reader if that is what it waits for.
+static void tx_publish(net_shm* shm, uint64_t head)
+{
+    shm_ctl* ctl = shm->tx.ctl;
+    __atomic_store_n(&ctl->head, head, __ATOMIC_SEQ_CST);
+    uint32_t want = __atomic_load_n(&ctl->reader_waiting, __ATOMIC_SEQ_CST);
+    if (want && head - __atomic_load_n(&ctl->tail, __ATOMIC_SEQ_CST) >= want) futex_wake(&ctl->data_seq);
+}
+
+// Hand receive ring bytes up to tail back to the writer.
+static void rx_release(net_shm* shm, uint64_t tail)
+{
+    shm_ctl* ctl = shm->rx.ctl;
+    __atomic_store_n(&ctl->tail, tail, __ATOMIC_SEQ_CST);
+    uint32_t want = __atomic_load_n(&ctl->writer_waiting, __ATOMIC_SEQ_CST);
+    if (want && shm->ring_size - (__atomic_load_n(&ctl->head, __ATOMIC_SEQ_CST) - tail) >= want)
+        futex_wake(&ctl->space_seq);
+}
+
+// Block until the receive ring holds (recv) or the send ring has room for (!recv)
+// need bytes. The waiter states need, so the other side wakes it only once.
+// returns 0, -1 if the peer closed or hung up, or the socket timeout passed
+static int shm_wait(net_shm* shm, bool recv, uint64_t need, const char* log_name)
+{
+    shm_ctl* ctl = recv ? shm->rx.ctl : shm->tx.ctl;
+    uint32_t* seq = recv ? &ctl->data_seq : &ctl->space_seq;
+    uint32_t* waiting = recv ? &ctl->reader_waiting : &ctl->writer_waiting;
+    uint32_t closed_bit = recv ? SHM_WRITER_CLOSED : SHM_READER_CLOSED;
+    int timeout_ms = recv ? shm->recv_timeout_ms : shm->send_timeout_ms;
+    int waited = 0;
+    while (true) {
+        uint32_t seen = __atomic_load_n(seq, __ATOMIC_SEQ_CST);
+        __atomic_store_n(waiting, (uint32_t)need, __ATOMIC_SEQ_CST);
+        bool ready = (recv ? rx_avail(shm) : tx_space(shm)) >= need;
+        bool closed = __atomic_load_n(&ctl->closed, __ATOMIC_SEQ_CST) & closed_bit;
+        // closed is set after the last head move, so ready is final then
+        bool woken = ready || closed || futex_wait(seq, seen, SHM_SLICE_MS);
+        __atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
+        if (ready) return 0;
+        if (closed) {
+            fprintf(stderr, "ERROR: %s message %s failed, connection closed\n", log_name, recv ? "receive" : "send");
+            return -1;
+        }
+        if (!woken) {
+            waited += SHM_SLICE_MS;
+            if (peer_gone(shm)) {
+                fprintf(stderr, "ERROR: %s message %s failed, connection closed\n", log_name, recv ? "receive" : "send");
+                return -1;
+            }
+            if (timeout_ms && waited >= timeout_ms) {
+                fprintf(stderr, "ERROR: %s message %s timed out\n", log_name, recv ? "receive" : "send");
+                return -1;
+            }
+        }
+    }
+}
+
+int64_t net_shm_sendv(net_shm* shm, const net_iovec* iov, int iovcnt, const char* log_name)
+{
+    // publish at least every quarter ring so the reader drains while we fill
+    uint64_t step = shm->ring_size / 4;
+    uint64_t head = shm->tx.ctl->head;
+    uint64_t published = head;
+    int64_t total_size = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        const char* data = (const char*)iov[i].base;
+        uint64_t left = iov[i].len;
+        while (left) {
+            uint64_t space = shm->ring_size - (head - __atomic_load_n(&shm->tx.ctl->tail, __ATOMIC_SEQ_CST));
+            if (!space) {
+                tx_publish(shm, head);
+                published = head;
+                if (shm_wait(shm, false, MIN(left, step), log_name) == -1) {
+                    TCP_close(shm->socket);
+                    return -1;
+                }
+                continue;
+            }
+            size_t n = (size_t)MIN(MIN(left, space), step);
+            memcpy(shm->tx.data + head % shm->ring_size, data, n);
+            head += n;
+            data += n;
+            left -= n;
+            total_size += n;
+            if (head - published >= step) {
+                tx_publish(shm, head);
+                published = head;
+            }
+        }
+    }
+    if (head != published) tx_publish(shm, head);
+    net_count_bytes(shm->stats, false, total_size, total_size);
+    return total_size;
+}
+
+int64_t net_shm_recv(net_shm* shm, char* data, uint64_t total_size, bool peek, const char* log_name)
+{
+    if (shm->pending) TCP_shm_release(shm->socket);
+    if (peek) {
+        if (total_size > shm->ring_size || shm_wait(shm, true, total_size, log_name) == -1) {
+            TCP_close(shm->socket);
+            return -1;
+        }
+        memcpy(data, shm->rx.data + shm->rx.ctl->tail % shm->ring_size, (size_t)total_size);
+        return (int64_t)total_size;
+    }
+
+    uint64_t step = shm->ring_size / 4;
+    uint64_t tail = shm->rx.ctl->tail;
+    uint64_t released = tail;
+    uint64_t left = total_size;
+    while (left) {
+        uint64_t avail = __atomic_load_n(&shm->rx.ctl->head, __ATOMIC_SEQ_CST) - tail;
+        if (!avail) {
+            rx_release(shm, tail);
+            released = tail;
+            if (shm_wait(shm, true, MIN(left, step), log_name) == -1) {
+                TCP_close(shm->socket);
+                return -1;
+            }
+            continue;
+        }
+        size_t n = (size_t)MIN(MIN(left, avail), step);
+        memcpy(data, shm->rx.data + tail % shm->ring_size, n);
+        tail += n;
+        data += n;
+        left -= n;
+        if (tail - released >= step) {
+            rx_release(shm, tail);
+            released = tail;
+        }
+    }
+    if (tail != released) rx_release(shm, tail);
+    net_count_bytes(shm->stats, true, (int64_t)total_size, total_size);
+    return (int64_t)total_size;
+}
+
+void net_shm_shutdown(net_shm* shm)
+{
+    // the socket stays open, the peer would take its EOF for a hangup
+    __atomic_or_fetch(&shm->tx.ctl->closed, SHM_WRITER_CLOSED, __ATOMIC_SEQ_CST);
+    futex_wake(&shm->tx.ctl->data_seq);
+}
+
+static void shm_free(net_shm* shm)
+{
+    if (shm->segment) munmap(shm->segment, shm->page);
+    if (shm->tx.data) munmap(shm->tx.data, 2 * shm->ring_size);
+    if (shm->rx.data) munmap(shm->rx.data, 2 * shm->ring_size);
+    net_buffer_free(&shm->inflated);
+    free(shm);
+}
+
+void net_shm_close(socket_t socket)
+{
+    net_shm* shm = shm_unregister(socket);
+    if (!shm) return;
+    if (!shm->listener) {
+        net_shm_shutdown(shm);
+        __atomic_or_fetch(&shm->rx.ctl->closed, SHM_READER_CLOSED, __ATOMIC_SEQ_CST);
+        futex_wake(&shm->rx.ctl->space_seq);
+    }
+    shm_free(shm);
+}
+
+// Map ring_size bytes of fd at offset twice in a row.
+static char* map_ring(int fd, size_t offset, size_t ring_size)
+{
+    char* base = (char*)mmap(NULL, 2 * ring_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+    for (int i = 0; i < 2; i++) {
+        if (mmap(base + i * ring_size, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+            (off_t)offset) == MAP_FAILED) {
+            munmap(base, 2 * ring_size);
+            return NULL;
+        }
+    }
+    return base;
+}
+
+static int timeout_ms(socket_t socket, int name)
+{
+    struct timeval timer = { 0, 0 };
+    socklen_t len = sizeof(timer);
+    if (getsockopt(socket, SOL_SOCKET, name, &timer, &len) == -1) return 0;
+    return (int)(timer.tv_sec * 1000 + timer.tv_usec / 1000);
+}
+
+// Map the segment behind fd, client picks ring 0 for sending.
+static net_shm* shm_map(socket_t socket, int fd, size_t page, size_t ring_size, bool client)
+{
+    net_shm* shm = (net_shm*)calloc(1, sizeof(net_shm));
+    if (!shm) return NULL;
+    shm->socket = socket;
+    shm->page = page;
+    shm->ring_size = ring_size;
+    net_buffer_init(&shm->inflated);
+    shm->segment = (shm_segment*)mmap(NULL, page, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (shm->segment == MAP_FAILED) {
+        shm->segment = NULL;
+        shm_free(shm);
+        return NULL;
+    }
+    char* ring0 = map_ring(fd, page, ring_size);
+    char* ring1 = ring0 ? map_ring(fd, page + ring_size, ring_size) : NULL;
+    shm->tx.ctl = &shm->segment->dir[client ? 0 : 1];
+    shm->rx.ctl = &shm->segment->dir[client ? 1 : 0];
+    shm->tx.data = client ? ring0 : ring1;
+    shm->rx.data = client ? ring1 : ring0;
+    if (!ring0 || !ring1) {
+        shm_free(shm);
+        return NULL;
+    }
+    shm->send_timeout_ms = timeout_ms(socket, SO_SNDTIMEO);
+    shm->recv_timeout_ms = timeout_ms(socket, SO_RCVTIMEO);
+    return shm;
+}
+
+// Wait up to NET_TIMEOUT for one handshake byte, with a descriptor attached if fd.
+// returns 0, -1 on failure
+static int recv_handshake(socket_t socket, char expected, int* fd)
+{
+    struct pollfd p = { socket, POLLIN, 0 };
+    if (poll(&p, 1, NET_TIMEOUT * 1000) != 1) return -1;
+
+    char byte = 0;
+    struct iovec iov = { &byte, 1 };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (fd) {
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+    }
+    if (recvmsg(socket, &msg, MSG_CMSG_CLOEXEC) != 1 || byte != expected) return -1;
+    if (!fd) return 0;
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(int))) return -1;
+    memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+    return 0;
+}
+
+static int send_handshake(socket_t socket, char byte, int fd)
+{
+    struct iovec iov = { &byte, 1 };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (fd != -1) {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+    return sendmsg(socket, &msg, MSG_NOSIGNAL) == 1 ? 0 : -1;
+}
+
+// Client: create the segment and pass it over the connected socket.
+// returns 0, -1 for error (with socket cleanup)
+static int shm_connect(socket_t socket)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t ring_size = (shm_ring_size + page - 1) / page * page;
+    int fd = (int)syscall(SYS_memfd_create, "io-shm", MFD_CLOEXEC);
+    if (fd == -1 || ftruncate(fd, (off_t)(page + 2 * ring_size)) == -1) {
+        fprintf(stderr, "ERROR: Shared memory segment failed with err %d!\n", errno);
+        if (fd != -1) close(fd);
+        TCP_close(socket);
+        return -1;
+    }
+    net_shm* shm = shm_map(socket, fd, page, ring_size, true);
+    if (!shm) {
+        fprintf(stderr, "ERROR: Shared memory mapping failed with err %d!\n", errno);
+        close(fd);
+        TCP_close(socket);
+        return -1;
+    }
+    shm->segment->magic = SHM_MAGIC;
+    shm->segment->ring_size = ring_size;
+
+    // the server acknowledges once it mapped the segment
+    int ret = send_handshake(socket, 'S', fd);
+    close(fd);
+    if (ret == -1 || recv_handshake(socket, 'A', NULL) == -1) {
+        fprintf(stderr, "ERROR: Shared memory handshake failed!\n");
+        shm_free(shm);
+        TCP_close(socket);
+        return -1;
+    }
+    shm_register(shm);
+    return 0;
+}
+
+// Server: map the segment the client passed over the accepted socket.
+// returns 0, -1 for error (with socket cleanup)
+static int shm_accept(socket_t socket)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    int fd = -1;
+    net_shm* shm = NULL;
+    struct stat st;
+    if (recv_handshake(socket, 'S', &fd) == 0 && fstat(fd, &st) == 0 && (size_t)st.st_size > page) {
+        // trust only a ring size that matches the segment
+        size_t ring_size = ((size_t)st.st_size - page) / 2;
+        shm_segment* segment = (shm_segment*)mmap(NULL, page, PROT_READ, MAP_SHARED, fd, 0);
+        if (segment != MAP_FAILED) {
+            bool valid = segment->magic == SHM_MAGIC && segment->ring_size == ring_size &&
+                ring_size % page == 0 && ring_size <= SHM_RING_MAX;
+            munmap(segment, page);
+            if (valid) shm = shm_map(socket, fd, page, ring_size, false);
+        }
+    }
+    if (fd != -1) close(fd);
+    if (!shm || send_handshake(socket, 'A', -1) == -1) {
+        fprintf(stderr, "ERROR: Shared memory handshake failed!\n");
+        if (shm) shm_free(shm);
+        TCP_close(socket);
+        return -1;
+    }
+    shm_register(shm);
+    return 0;
+}
+
+socket_t net_local_accepted(socket_t listen_socket, socket_t client_socket)
+{
+    net_shm* listener = net_shm_find(listen_socket);
+    if (!listener || !listener->listener) return client_socket;
+    return shm_accept(client_socket) == 0 ? client_socket : INV_SOCKET;
+}
+
+char* TCP_shm_reserve(socket_t socket, size_t size)
+{
+    net_shm* shm = net_shm_get(socket);
+    int header = net_frame_header_size();
+    if (!shm || shm->listener || size > shm->ring_size - header) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return NULL;
+    }
+    if (shm_wait(shm, false, header + size, "Data") == -1) {
+        TCP_close(socket);
+        return NULL;
+    }
+    shm->reserved = size;
+    shm->reserved_header = header;
+    return shm->tx.data + (shm->tx.ctl->head + header) % shm->ring_size;
+}
+
+int64_t TCP_shm_commit(socket_t socket, const net_header* header)
+{
+    uint64_t start_ns = net_now_ns();
+    net_shm* shm = net_shm_get(socket);
+    if (!shm || !header || !shm->reserved_header || header->length > shm->reserved ||
+        (header->flags & NET_FLAG_TRACED)) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    char buffer[NET_MAXHEADER];
+    int size = net_encode_frame(buffer, header);
+    if (size != shm->reserved_header) {
+        if (size != -1) fprintf(stderr, "ERROR: Framing changed since TCP_shm_reserve()!\n");
+        TCP_close(socket);
+        return -1;
+    }
+    shm->reserved_header = 0;
+    uint64_t head = shm->tx.ctl->head;
+    memcpy(shm->tx.data + head % shm->ring_size, buffer, size);
+    tx_publish(shm, head + size + header->length);
+    net_count_bytes(shm->stats, false, size + header->length, size + header->length);
+    net_count_msg(shm->stats, false, header->length, start_ns);
+    return (int64_t)header->length;
+}
+
+const char* TCP_shm_recv(socket_t socket, net_header* header)
+{
+    net_shm* shm = net_shm_get(socket);
+    if (!shm || shm->listener || !header) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return NULL;
+    }
+    if (shm->pending) TCP_shm_release(socket);
+
+    unsigned char buffer[NET_MAXHEADER];
+    if (shm_wait(shm, true, NET_MAXINIT, "Header") == -1) {
+        TCP_close(socket);
+        return NULL;
+    }
+    const char* start = shm->rx.data + shm->rx.ctl->tail % shm->ring_size;
+    memcpy(buffer, start, NET_MAXINIT);
+    int size = net_header_size(buffer);
+    if (size > NET_MAXINIT && shm_wait(shm, true, size, "Header") == -1) {
+        TCP_close(socket);
+        return NULL;
+    }
+    memcpy(buffer, start, size);
+    if (net_decode_header(buffer, header) == -1) {
+        TCP_close(socket);
+        return NULL;
+    }
+    size_t trailer = net_trailer_size(header->flags);
+    if (header->length > shm->ring_size - size - trailer) {
+        fprintf(stderr, "ERROR: Message of %llu bytes exceeds the shared memory ring!\n",
+            (unsigned long long)header->length);
+        TCP_close(socket);
+        return NULL;
+    }
+    uint64_t start_ns = net_now_ns();
+    if (shm_wait(shm, true, size + header->length + trailer, "Data") == -1) {
+        TCP_close(socket);
+        return NULL;
+    }
+    shm->pending = size + header->length + trailer;
+    net_count_bytes(shm->stats, true, (int64_t)shm->pending, shm->pending);
+    net_count_msg(shm->stats, true, header->length, start_ns);
+    const char* payload = start + size;
+    if (!net_checksum_ok(header, payload, (size_t)header->length)) {
+        TCP_close(socket);
+        return NULL;
+    }
+    if (trailer) {
+        net_header traced = *header;
+        int64_t raw = header->flags & NET_FLAG_COMPRESSED ? net_inflated_size(payload, (size_t)header->length) : -1;
+        if (raw != -1) traced.length = (uint64_t)raw;
+        net_trace_record(socket, &traced, (const unsigned char*)payload + header->length, start_ns, net_now_ns());
+    }
+    if (!(header->flags & NET_FLAG_COMPRESSED)) return payload;
+
+    // compressed messages cannot be used in place
+    int64_t raw = net_inflated_size(payload, (size_t)header->length);
+    if (raw == -1 || !net_buffer_reserve(&shm->inflated, raw ? (size_t)raw : 1) ||
+        net_inflate(payload, (size_t)header->length, shm->inflated.data, (size_t)raw) == -1) {
+        fprintf(stderr, "ERROR: Malformed compressed message!\n");
+        TCP_close(socket);
+        return NULL;
+    }
+    header->length = (uint64_t)raw;
+    return shm->inflated.data;
+}
+
+void TCP_shm_release(socket_t socket)
+{
+    net_shm* shm = net_shm_get(socket);
+    if (!shm || !shm->pending) return;
+    uint64_t tail = shm->rx.ctl->tail + shm->pending;
+    shm->pending = 0;
+    rx_release(shm, tail);
+}
+
+#else
+
+void TCP_set_shm_ring(size_t size)
+{
+    (void)size;
+}
+
+char* TCP_shm_reserve(socket_t socket, size_t size)
+{
+    (void)socket;
+    (void)size;
+    fprintf(stderr, "ERROR: Invalid input!\n");
+    return NULL;
+}
+
+int64_t TCP_shm_commit(socket_t socket, const net_header* header)
+{
+    (void)socket;
+    (void)header;
+    fprintf(stderr, "ERROR: Invalid input!\n");
+    return -1;
+}
+
+const char* TCP_shm_recv(socket_t socket, net_header* header)
+{
+    (void)socket;
+    (void)header;
+    fprintf(stderr, "ERROR: Invalid input!\n");
+    return NULL;
+}
+
+void TCP_shm_release(socket_t socket)
+{
+    (void)socket;
+}
+
+#endif
+
+socket_t net_local_connect(const char* addr, const net_sockopts* opts, bool verbose)
+{
+#ifdef _WIN32
+    (void)opts;
+    (void)verbose;
+    fprintf(stderr, "ERROR: Local address %s not supported on Windows!\n", addr);
+    return INV_SOCKET;
+#else
+    int scheme = net_local_scheme(addr);
+#ifndef NET_HAVE_SHM
+    if (scheme == NET_LOCAL_SHM) {
+        fprintf(stderr, "ERROR: Shared memory transport needs Linux!\n");
+        return INV_SOCKET;
+    }
+#endif
+    struct sockaddr_un sa;
+    socklen_t len;
+    if (local_address(addr, &sa, &len) == -1) return INV_SOCKET;
+
+    socket_t client_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (client_socket == INV_SOCKET) {
+        fprintf(stderr, "ERROR: Socket creation failed with err %d!\n", TCP_ERRNO);
+        return INV_SOCKET;
+    }
+    if (opts) TCP_set_sockopts(client_socket, opts);
+    if (connect(client_socket, (struct sockaddr*)&sa, len) == -1) {
+        fprintf(stderr, "ERROR: Connect to %s failed with err %d!\n", addr, TCP_ERRNO);
+        TCP_close(client_socket);
+        return INV_SOCKET;
+    }
+
+    // inactivity timer
+    struct timeval timer = { NET_TIMEOUT, 0 };
+    if (setsockopt(client_socket, SOL_SOCKET, SO_SNDTIMEO, (char*)&timer, sizeof(timer)) == -1) {
+        fprintf(stderr, "WARNING: Connect inactivity timer failed with err %d!\n", TCP_ERRNO);
+    }
+#ifdef NET_HAVE_SHM
+    if (scheme == NET_LOCAL_SHM && shm_connect(client_socket) == -1) return INV_SOCKET;
+#endif
+    if (verbose) printf("MESSAGE: Established connection to %s.\n", addr);
+    return client_socket;
+#endif
+}
+
+socket_t net_local_listen(const char* addr, const net_sockopts* opts, bool verbose)
+{
+#ifdef _WIN32
+    (void)opts;
+    (void)verbose;
+    fprintf(stderr, "ERROR: Local address %s not supported on Windows!\n", addr);
+    return INV_SOCKET;
+#else
+    int scheme = net_local_scheme(addr);
+#ifndef NET_HAVE_SHM
+    if (scheme == NET_LOCAL_SHM) {
+        fprintf(stderr, "ERROR: Shared memory transport needs Linux!\n");
+        return INV_SOCKET;
+    }
+#endif
+    struct sockaddr_un sa;
+    socklen_t len;
+    if (local_address(addr, &sa, &len) == -1) return INV_SOCKET;
+
+    socket_t server_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_socket == INV_SOCKET) {
+        fprintf(stderr, "ERROR: Socket creation failed with err %d!\n", TCP_ERRNO);
+        return INV_SOCKET;
+    }
+    if (opts) TCP_set_sockopts(server_socket, opts);
+    // a socket file left by an earlier run blocks bind, as TIME_WAIT does for ports
+    if (opts && opts->reuseaddr && sa.sun_path[0]) unlink(sa.sun_path);
+    if (bind(server_socket, (struct sockaddr*)&sa, len) == -1) {
+        fprintf(stderr, "ERROR: Bind failed!\n");
+        TCP_close(server_socket);
+        return INV_SOCKET;
+    }
+    if (listen(server_socket, SOMAXCONN) == -1) {
+        fprintf(stderr, "ERROR: Listen failed!\n");
+        TCP_close(server_socket);
+        return INV_SOCKET;
+    }
+#ifdef NET_HAVE_SHM
+    if (scheme == NET_LOCAL_SHM) {
+        // accepted sockets of a shm: listener map the client's segment
+        net_shm* shm = (net_shm*)calloc(1, sizeof(net_shm));
+        if (!shm) {
+            fprintf(stderr, "ERROR: Out of memory!\n");
+            TCP_close(server_socket);
+            return INV_SOCKET;
+        }
+        shm->socket = server_socket;
+        shm->listener = true;
+        net_buffer_init(&shm->inflated);
+        shm_register(shm);
+    }
+#endif
+    if (verbose) printf("MESSAGE: Start to listen on %s.\n", addr);
+    return server_socket;
+#endif
+}
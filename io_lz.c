@@ -0,0 +1,263 @@
+//
+// Payload compression.
+// A byte-oriented LZ77 codec in the LZ4 block format: literal runs and
+// back-references of up to 64 KiB, no entropy coding, so it runs at memory
+// speed and pays off whenever the wire is slower than the CPU.
+//
+// Compressed payloads (NET_FLAG_COMPRESSED) are the raw size as u32
+// little-endian followed by one block.
+//
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <winsock2.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+#define LZ_MINMATCH 4
+#define LZ_HASH_LOG 12
+#define LZ_LAST_LITERALS 5 // block ends with literals
+#define LZ_MFLIMIT 12      // no match starts closer to the end
+#define LZ_MAX_OFFSET 65535
+#define LZ_SKIP_TRIGGER 6  // search step grows every 2^6 misses on incompressible data
+#define LZ_MAX_RATIO 255   // most raw bytes one block byte can expand to
+
+unsigned net_compress_min = 0;
+
+void TCP_set_compression(unsigned min_size)
+{
+    net_compress_min = min_size;
+}
+
+static inline uint32_t load32(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t load64(const unsigned char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t lz_hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - LZ_HASH_LOG);
+}
+
+// Length of the common prefix of a and b, a stops before limit.
+static inline size_t lz_count(const unsigned char* a, const unsigned char* b, const unsigned char* limit)
+{
+    const unsigned char* start = a;
+    while (a + 8 <= limit && load64(a) == load64(b)) {
+        a += 8;
+        b += 8;
+    }
+    while (a < limit && *a == *b) {
+        a++;
+        b++;
+    }
+    return (size_t)(a - start);
+}
+
+static inline unsigned char* lz_put_length(unsigned char* op, size_t len)
+{
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (unsigned char)len;
+    return op;
+}
+
+// Emit literals [anchor, anchor + lit) and, if offset, a match of mlen bytes.
+// returns new output position, NULL if it would pass oend
+static unsigned char* lz_sequence(unsigned char* op, unsigned char* oend, const unsigned char* anchor, size_t lit,
+    unsigned offset, size_t mlen)
+{
+    size_t need = 1 + lit / 255 + 1 + lit + (offset ? 2 + mlen / 255 + 1 : 0);
+    if (need > (size_t)(oend - op)) return NULL;
+
+    unsigned char* token = op++;
+    if (lit >= 15) {
+        *token = 15 << 4;
+        op = lz_put_length(op, lit - 15);
+    }
+    else *token = (unsigned char)(lit << 4);
+    memcpy(op, anchor, lit);
+    op += lit;
+    if (!offset) return op;
+
+    put_le16(op, (uint16_t)offset);
+    op += 2;
+    mlen -= LZ_MINMATCH;
+    if (mlen >= 15) {
+        *token |= 15;
+        op = lz_put_length(op, mlen - 15);
+    }
+    else *token |= (unsigned char)mlen;
+    return op;
+}
+
+// Greedy single-probe matcher.
+// returns compressed size, -1 if it would not fit in capacity
+static int64_t lz_compress(const unsigned char* src, size_t len, unsigned char* dst, size_t capacity)
+{
+    uint32_t table[1 << LZ_HASH_LOG]; // last position of each hashed 4-byte sequence
+    memset(table, 0, sizeof(table));
+
+    const unsigned char* ip = src;
+    const unsigned char* anchor = src;
+    const unsigned char* end = src + len;
+    unsigned char* op = dst;
+    unsigned char* oend = dst + capacity;
+
+    if (len > LZ_MFLIMIT) {
+        const unsigned char* match_limit = end - LZ_MFLIMIT;
+        const unsigned char* copy_limit = end - LZ_LAST_LITERALS;
+        ip++;
+        while (ip < match_limit) {
+            // find a match, stepping faster the longer nothing matches
+            const unsigned char* ref;
+            unsigned misses = 0;
+            while (true) {
+                uint32_t h = lz_hash(load32(ip));
+                ref = src + table[h];
+                table[h] = (uint32_t)(ip - src);
+                if (ref < ip && ip - ref <= LZ_MAX_OFFSET && load32(ref) == load32(ip)) break;
+                ip += 1 + (misses++ >> LZ_SKIP_TRIGGER);
+                if (ip >= match_limit) goto last_literals;
+            }
+
+            // extend backwards into pending literals, then forwards
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            size_t mlen = LZ_MINMATCH + lz_count(ip + LZ_MINMATCH, ref + LZ_MINMATCH, copy_limit);
+
+            op = lz_sequence(op, oend, anchor, (size_t)(ip - anchor), (unsigned)(ip - ref), mlen);
+            if (!op) return -1;
+            ip += mlen;
+            anchor = ip;
+            if (ip < match_limit) table[lz_hash(load32(ip - 2))] = (uint32_t)(ip - 2 - src);
+        }
+    }
+
+last_literals:
+    op = lz_sequence(op, oend, anchor, (size_t)(end - anchor), 0, 0);
+    if (!op) return -1;
+    return (int64_t)(op - dst);
+}
+
+// returns 0, -1 if malformed or not exactly capacity bytes long
+static int lz_decompress(const unsigned char* src, size_t len, unsigned char* dst, size_t capacity)
+{
+    const unsigned char* ip = src;
+    const unsigned char* iend = src + len;
+    unsigned char* op = dst;
+    unsigned char* oend = dst + capacity;
+
+    while (ip < iend) {
+        unsigned token = *ip++;
+
+        size_t lit = token >> 4;
+        if (lit == 15) {
+            unsigned char b;
+            do {
+                if (ip == iend) return -1;
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
+        }
+        if (lit > (size_t)(iend - ip) || lit > (size_t)(oend - op)) return -1;
+        memcpy(op, ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip == iend) break; // last sequence has no match
+
+        if (iend - ip < 2) return -1;
+        size_t offset = get_le16(ip);
+        ip += 2;
+        if (!offset || offset > (size_t)(op - dst)) return -1;
+
+        size_t mlen = token & 15;
+        if (mlen == 15) {
+            unsigned char b;
+            do {
+                if (ip == iend) return -1;
+                b = *ip++;
+                mlen += b;
+            } while (b == 255);
+        }
+        mlen += LZ_MINMATCH;
+        if (mlen > (size_t)(oend - op)) return -1;
+
+        // overlapping matches repeat the last offset bytes,
+        // copy in non-overlapping steps that double each time
+        const unsigned char* match = op - offset;
+        while (mlen) {
+            size_t n = MIN(mlen, (size_t)(op - match));
+            memcpy(op, match, n);
+            op += n;
+            mlen -= n;
+        }
+    }
+    return op == oend ? 0 : -1;
+}
+
+int64_t net_compress(const char* data, size_t len, char* out)
+{
+    if (len <= NET_COMPRESS_PREFIX + 1 || (len & ~(size_t)0x7fffffff)) return -1;
+    put_le32((unsigned char*)out, (uint32_t)len);
+    // must come out strictly smaller than the payload
+    int64_t size = lz_compress((const unsigned char*)data, len, (unsigned char*)out + NET_COMPRESS_PREFIX,
+        len - NET_COMPRESS_PREFIX - 1);
+    return size == -1 ? -1 : size + NET_COMPRESS_PREFIX;
+}
+
+int64_t net_inflated_size(const char* payload, size_t len)
+{
+    if (len < NET_COMPRESS_PREFIX) return -1;
+    uint32_t raw = get_le32((const unsigned char*)payload);
+    if (raw & 0x80000000u) return -1;
+    // a length byte adds at most 255 bytes, so anything more is a lie
+    // that would have us allocate before finding out
+    if (raw > (uint64_t)LZ_MAX_RATIO * (len - NET_COMPRESS_PREFIX) + 16) return -1;
+    return (int64_t)raw;
+}
+
+int net_inflate(const char* payload, size_t len, char* out, size_t raw)
+{
+    if (net_inflated_size(payload, len) != (int64_t)raw) return -1;
+    return lz_decompress((const unsigned char*)payload + NET_COMPRESS_PREFIX, len - NET_COMPRESS_PREFIX,
+        (unsigned char*)out, raw);
+}
+
+int net_buffer_inflate(net_buffer* buf)
+{
+    int64_t raw = net_inflated_size(buf->data, buf->size);
+    if (raw == -1 || (uint64_t)raw > net_max_message) return -1;
+    char* data = (char*)malloc(raw ? (size_t)raw : 1);
+    if (!data) return -1;
+    if (net_inflate(buf->data, buf->size, data, (size_t)raw) == -1) {
+        free(data);
+        return -1;
+    }
+    free(buf->data);
+    buf->data = data;
+    buf->capacity = raw ? (size_t)raw : 1;
+    buf->size = (size_t)raw;
+    buf->header.length = (uint64_t)raw;
+    return 0;
+}
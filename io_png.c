@@ -0,0 +1,301 @@
+//
+// Parallel PNG encoder.
+// The image is cut into bands of rows that worker threads filter and
+// deflate independently. Each band is primed with the last 32 KiB of
+// filtered rows in front of it and ends in a sync flush, so the bands join
+// into one zlib stream without re-encoding, the way pigz does it. Every band
+// goes out as an IDAT chunk of its own, which keeps the chunk CRCs parallel
+// too; only the per-band Adler-32s are combined at the end.
+// Filter choice matches stb_image_write: per row, the filter whose output
+// has the smallest sum of absolute values (kernels in io_filter.c).
+//
+
+#define _CRT_SECURE_NO_WARNINGS 1
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+#define PNG_DEFAULT_LEVEL 8      // as stbi_write_png_compression_level
+#define PNG_BAND_MIN (256 * 1024) // filtered bytes, smaller bands cost more than they gain
+#define PNG_BANDS_PER_THREAD 4   // so cheap and expensive rows even out
+#define PNG_WINDOW 32768
+#define PNG_MAX_BYTES 0x7fff0000 // filtered image, deflate positions are 32-bit
+
+typedef struct png_band {
+    int y0, y1;           // rows
+    unsigned char* zdata; // raw deflate of the filtered rows
+    size_t zlen;
+    uint32_t adler; // of the filtered rows
+    uint32_t crc;   // of "IDAT" and the chunk data so far
+    uint64_t filter_ns, deflate_ns, crc_ns;
+} png_band;
+
+typedef struct png_encoder {
+    const unsigned char* pixels;
+    int width, height, channels;
+    int level;
+    int deflate; // PNG_DEFLATE_*
+    const img_filter_kernels* kernels;
+    int band_count;
+    png_band* bands;
+} png_encoder;
+
+// One worker thread, doing bands index, index + count, ...
+typedef struct png_job {
+    png_encoder* enc;
+    int index, count;
+} png_job;
+
+static int cpu_count(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+// Filter rows [y0, y1) into out, each prefixed with its filter type.
+// scratch holds 5 rows; zero_row a row of zeroes.
+static void filter_rows(const png_encoder* enc, int y0, int y1, unsigned char* out, unsigned char* scratch,
+    const unsigned char* zero_row)
+{
+    const img_filter_kernels* kernels = enc->kernels;
+    int n = enc->channels, len = enc->width * n;
+    for (int y = y0; y < y1; y++, out += len + 1) {
+        const unsigned char* z = enc->pixels + (size_t)y * len;
+        const unsigned char* up = y ? z - len : zero_row;
+        int best = 0;
+        uint32_t best_cost = UINT32_MAX;
+        for (int type = 0; type < 5; type++) {
+            unsigned char* line = scratch + (size_t)type * len;
+            kernels->filter[type](z, up, n, len, line);
+            uint32_t cost = kernels->cost(line, len);
+            if (cost < best_cost) {
+                best_cost = cost;
+                best = type;
+            }
+        }
+        out[0] = (unsigned char)best;
+        memcpy(out + 1, scratch + (size_t)best * len, len);
+    }
+}
+
+// Filter and deflate one band.
+// returns 0, -1 if out of memory
+static int encode_band(png_encoder* enc, int index)
+{
+    png_band* band = &enc->bands[index];
+    size_t row = (size_t)enc->width * enc->channels + 1;
+    // rows in front, filtered again here as dictionary
+    int dict_rows = (int)MIN((size_t)band->y0, (PNG_WINDOW + row - 1) / row);
+    int y = band->y0 - dict_rows;
+    size_t dict_len = (size_t)dict_rows * row, len = (size_t)(band->y1 - band->y0) * row;
+
+    unsigned char* filtered = (unsigned char*)malloc(dict_len + len);
+    unsigned char* scratch = (unsigned char*)calloc(6, row); // 5 filter rows and the zero row
+    if (!filtered || !scratch) {
+        free(filtered);
+        free(scratch);
+        return -1;
+    }
+    uint64_t start = net_now_ns();
+    filter_rows(enc, y, band->y1, filtered, scratch, scratch + 5 * row);
+    free(scratch);
+    uint64_t filtered_ns = net_now_ns();
+
+    bool last = index == enc->band_count - 1;
+    band->adler = TCP_adler32(1, filtered + dict_len, len);
+    band->zdata = img_deflate(filtered + dict_len, dict_len, len, enc->deflate, enc->level, last, &band->zlen);
+    free(filtered);
+    if (!band->zdata) return -1;
+    uint64_t deflated_ns = net_now_ns();
+
+    static const unsigned char zlib_header[2] = { 0x78, 0x5e }; // as stb writes it
+    band->crc = TCP_crc32(0, (const unsigned char*)"IDAT", 4);
+    if (index == 0) band->crc = TCP_crc32(band->crc, zlib_header, 2);
+    band->crc = TCP_crc32(band->crc, band->zdata, band->zlen);
+
+    band->filter_ns = filtered_ns - start;
+    band->deflate_ns = deflated_ns - filtered_ns;
+    band->crc_ns = net_now_ns() - deflated_ns;
+    return 0;
+}
+
+static int job_run(void* arg)
+{
+    png_job* job = (png_job*)arg;
+    for (int i = job->index; i < job->enc->band_count; i += job->count) {
+        if (encode_band(job->enc, i) == -1) return -1;
+    }
+    return 0;
+}
+
+static unsigned char* put_be32(unsigned char* o, uint32_t v)
+{
+    o[0] = (unsigned char)(v >> 24);
+    o[1] = (unsigned char)(v >> 16);
+    o[2] = (unsigned char)(v >> 8);
+    o[3] = (unsigned char)v;
+    return o + 4;
+}
+
+// Join the encoded bands into the PNG file image.
+static unsigned char* assemble(const png_encoder* enc, size_t* out_len)
+{
+    size_t size = 8 + 25 + 12 + 2 + 4; // signature, IHDR, IEND, zlib header and Adler-32
+    uint32_t adler = 1;
+    for (int i = 0; i < enc->band_count; i++) {
+        const png_band* band = &enc->bands[i];
+        size += 12 + band->zlen;
+        size_t len = (size_t)(band->y1 - band->y0) * ((size_t)enc->width * enc->channels + 1);
+        adler = img_adler32_combine(adler, band->adler, len);
+    }
+    unsigned char* out = (unsigned char*)malloc(size);
+    if (!out) return NULL;
+
+    static const unsigned char sig[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    static const unsigned char ctype[5] = { 0, 0, 4, 2, 6 };
+    unsigned char* o = out;
+    memcpy(o, sig, 8);
+    o = put_be32(o + 8, 13);
+    memcpy(o, "IHDR", 4);
+    o = put_be32(o + 4, (uint32_t)enc->width);
+    o = put_be32(o, (uint32_t)enc->height);
+    o[0] = 8; // bit depth
+    o[1] = ctype[enc->channels];
+    o[2] = o[3] = o[4] = 0; // deflate, adaptive filtering, no interlace
+    o = put_be32(o + 5, TCP_crc32(0, o - 12, 17));
+
+    for (int i = 0; i < enc->band_count; i++) {
+        const png_band* band = &enc->bands[i];
+        bool first = i == 0, last = i == enc->band_count - 1;
+        o = put_be32(o, (uint32_t)(band->zlen + (first ? 2 : 0) + (last ? 4 : 0)));
+        memcpy(o, "IDAT", 4);
+        o += 4;
+        if (first) {
+            *o++ = 0x78;
+            *o++ = 0x5e;
+        }
+        memcpy(o, band->zdata, band->zlen);
+        o += band->zlen;
+        uint32_t crc = band->crc;
+        if (last) {
+            o = put_be32(o, adler);
+            crc = TCP_crc32(crc, o - 4, 4);
+        }
+        o = put_be32(o, crc);
+    }
+    o = put_be32(o, 0);
+    memcpy(o, "IEND", 4);
+    put_be32(o + 4, TCP_crc32(0, o, 4));
+    *out_len = size;
+    return out;
+}
+
+unsigned char* encode_png(const void* data, int width, int height, int channels, const png_options* options,
+    size_t* out_len)
+{
+    if (!data || !out_len || width <= 0 || height <= 0 || channels < 1 || channels > 4
+        || (options && (options->deflate < PNG_DEFLATE_LAZY || options->deflate > PNG_DEFLATE_RLE))
+        || ((uint64_t)width * channels + 1) * height > PNG_MAX_BYTES) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return NULL;
+    }
+    uint64_t start = net_now_ns();
+
+    png_encoder enc;
+    enc.pixels = (const unsigned char*)data;
+    enc.width = width;
+    enc.height = height;
+    enc.channels = channels;
+    enc.level = options && options->level > 0 ? options->level : PNG_DEFAULT_LEVEL;
+    enc.deflate = options ? options->deflate : PNG_DEFLATE_LAZY;
+    enc.kernels = img_filter_kernels_for(options ? options->simd : PNG_SIMD_AUTO);
+    if (!enc.kernels) {
+        fprintf(stderr, "ERROR: PNG filter instruction set not supported!\n");
+        return NULL;
+    }
+
+    int threads = options && options->threads > 0 ? options->threads : cpu_count();
+    size_t row = (size_t)width * channels + 1;
+    int bands = 1;
+    if (threads > 1) bands = (int)MIN((size_t)threads * PNG_BANDS_PER_THREAD, row * height / PNG_BAND_MIN);
+    bands = MAX(MIN(bands, height), 1);
+    int rows = (height + bands - 1) / bands;
+    enc.band_count = (height + rows - 1) / rows;
+    threads = MIN(threads, enc.band_count);
+
+    enc.bands = (png_band*)calloc(enc.band_count, sizeof(png_band));
+    png_job* jobs = (png_job*)calloc(threads, sizeof(png_job));
+    if (!enc.bands || !jobs) {
+        fprintf(stderr, "ERROR: Out of memory!\n");
+        free(enc.bands);
+        free(jobs);
+        return NULL;
+    }
+    for (int i = 0; i < enc.band_count; i++) {
+        enc.bands[i].y0 = i * rows;
+        enc.bands[i].y1 = MIN((i + 1) * rows, height);
+    }
+    for (int i = 0; i < threads; i++) {
+        jobs[i].enc = &enc;
+        jobs[i].index = i;
+        jobs[i].count = threads;
+    }
+
+    unsigned char* out = NULL;
+    if (net_run_jobs(jobs, sizeof(png_job), threads, job_run, true) == -1) fprintf(stderr, "ERROR: Out of memory!\n");
+    else out = assemble(&enc, out_len);
+
+    if (out && options && options->stats) {
+        png_stats* stats = options->stats;
+        memset(stats, 0, sizeof(*stats));
+        for (int i = 0; i < enc.band_count; i++) {
+            stats->filter_sec += enc.bands[i].filter_ns / 1e9;
+            stats->deflate_sec += enc.bands[i].deflate_ns / 1e9;
+            stats->crc_sec += enc.bands[i].crc_ns / 1e9;
+        }
+        stats->wall_sec = (net_now_ns() - start) / 1e9;
+        stats->threads = threads;
+        stats->bands = enc.band_count;
+        stats->bytes = *out_len;
+    }
+    for (int i = 0; i < enc.band_count; i++) free(enc.bands[i].zdata);
+    free(enc.bands);
+    free(jobs);
+    return out;
+}
+
+bool write_png_ex(const char* filename, const void* data, int width, int height, int channels,
+    const png_options* options)
+{
+    size_t len;
+    unsigned char* png = encode_png(data, width, height, channels, options, &len);
+    if (!png) return false;
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "ERROR: Cannot open %s!\n", filename);
+        free(png);
+        return false;
+    }
+    bool ok = fwrite(png, 1, len, file) == len;
+    ok = fclose(file) == 0 && ok;
+    free(png);
+    if (!ok) fprintf(stderr, "ERROR: Writing %s failed!\n", filename);
+    return ok;
+}
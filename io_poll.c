@@ -0,0 +1,248 @@
+//
+// Readiness polling for the non-blocking server and reactor.
+// epoll on Linux, poll() on other POSIX systems, WSAPoll() on Windows.
+//
+
+#if defined(_WIN32) && (!defined(_WIN32_WINNT) || _WIN32_WINNT < 0x600)
+// WSAPoll needs Vista
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x600
+#endif
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <winsock2.h>
+#else
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <sys/socket.h>
+    #include <poll.h>
+    #include <errno.h>
+#endif
+#ifdef __linux__
+    #include <sys/epoll.h>
+    #define NET_USE_EPOLL 1
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+int net_set_nonblocking(socket_t socket, bool nonblocking)
+{
+#ifdef _WIN32
+    u_long mode = nonblocking ? 1 : 0;
+    if (ioctlsocket(socket, FIONBIO, &mode) != 0) return -1;
+#else
+    int flags = fcntl(socket, F_GETFL, 0);
+    if (flags == -1) return -1;
+    flags = nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    if (fcntl(socket, F_SETFL, flags) == -1) return -1;
+#endif
+    return 0;
+}
+
+void net_set_nosigpipe(socket_t socket)
+{
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+    int on = 1;
+    setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, (const char*)&on, sizeof(on));
+#else
+    (void)socket;
+#endif
+}
+
+#ifdef NET_USE_EPOLL
+
+struct net_poller {
+    int epfd;
+    struct epoll_event events[64];
+};
+
+net_poller* net_poller_create(void)
+{
+    net_poller* poller = (net_poller*)malloc(sizeof(net_poller));
+    if (!poller) return NULL;
+    poller->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (poller->epfd == -1) {
+        fprintf(stderr, "ERROR: epoll_create failed with err %d\n", TCP_ERRNO);
+        free(poller);
+        return NULL;
+    }
+    return poller;
+}
+
+void net_poller_destroy(net_poller* poller)
+{
+    if (!poller) return;
+    close(poller->epfd);
+    free(poller);
+}
+
+static int epoll_update(net_poller* poller, int op, socket_t socket, unsigned events, void* ptr)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    if (events & NET_POLL_IN) ev.events |= EPOLLIN;
+    if (events & NET_POLL_OUT) ev.events |= EPOLLOUT;
+    ev.data.ptr = ptr;
+    return epoll_ctl(poller->epfd, op, socket, &ev) == 0 ? 0 : -1;
+}
+
+int net_poller_add(net_poller* poller, socket_t socket, unsigned events, void* ptr)
+{
+    return epoll_update(poller, EPOLL_CTL_ADD, socket, events, ptr);
+}
+
+int net_poller_mod(net_poller* poller, socket_t socket, unsigned events, void* ptr)
+{
+    return epoll_update(poller, EPOLL_CTL_MOD, socket, events, ptr);
+}
+
+int net_poller_del(net_poller* poller, socket_t socket)
+{
+    struct epoll_event ev; // non-NULL for pre-2.6.9 kernels
+    return epoll_ctl(poller->epfd, EPOLL_CTL_DEL, socket, &ev) == 0 ? 0 : -1;
+}
+
+int net_poller_wait(net_poller* poller, net_poll_event* events, int max_events, int timeout_ms)
+{
+    int count = epoll_wait(poller->epfd, poller->events, MIN(max_events, 64), timeout_ms);
+    if (count == -1) return errno == EINTR ? 0 : -1;
+    for (int i = 0; i < count; i++) {
+        uint32_t ev = poller->events[i].events;
+        events[i].ptr = poller->events[i].data.ptr;
+        events[i].events = ((ev & EPOLLIN) ? NET_POLL_IN : 0) | ((ev & EPOLLOUT) ? NET_POLL_OUT : 0) |
+            ((ev & (EPOLLERR | EPOLLHUP)) ? NET_POLL_ERR : 0);
+    }
+    return count;
+}
+
+#else
+
+#ifdef _WIN32
+#define poll WSAPoll
+typedef ULONG nfds_t;
+#endif
+
+// parallel arrays, swap-removed on delete
+struct net_poller {
+    struct pollfd* fds;
+    void** ptrs;
+    int count;
+    int capacity;
+    int next; // round-robin start so early sockets cannot starve later ones
+};
+
+net_poller* net_poller_create(void)
+{
+    net_poller* poller = (net_poller*)calloc(1, sizeof(net_poller));
+    return poller;
+}
+
+void net_poller_destroy(net_poller* poller)
+{
+    if (!poller) return;
+    free(poller->fds);
+    free(poller->ptrs);
+    free(poller);
+}
+
+static int poller_find(net_poller* poller, socket_t socket)
+{
+    for (int i = 0; i < poller->count; i++) {
+        if ((socket_t)poller->fds[i].fd == socket) return i;
+    }
+    return -1;
+}
+
+static short poll_events(unsigned events)
+{
+    return (short)(((events & NET_POLL_IN) ? POLLIN : 0) | ((events & NET_POLL_OUT) ? POLLOUT : 0));
+}
+
+int net_poller_add(net_poller* poller, socket_t socket, unsigned events, void* ptr)
+{
+    if (poller_find(poller, socket) != -1) return -1;
+    if (poller->count == poller->capacity) {
+        int capacity = poller->capacity ? poller->capacity * 2 : 16;
+        struct pollfd* fds = (struct pollfd*)realloc(poller->fds, capacity * sizeof(struct pollfd));
+        if (!fds) return -1;
+        poller->fds = fds;
+        void** ptrs = (void**)realloc(poller->ptrs, capacity * sizeof(void*));
+        if (!ptrs) return -1;
+        poller->ptrs = ptrs;
+        poller->capacity = capacity;
+    }
+    poller->fds[poller->count].fd = socket;
+    poller->fds[poller->count].events = poll_events(events);
+    poller->fds[poller->count].revents = 0;
+    poller->ptrs[poller->count] = ptr;
+    poller->count++;
+    return 0;
+}
+
+int net_poller_mod(net_poller* poller, socket_t socket, unsigned events, void* ptr)
+{
+    int i = poller_find(poller, socket);
+    if (i == -1) return -1;
+    poller->fds[i].events = poll_events(events);
+    poller->ptrs[i] = ptr;
+    return 0;
+}
+
+int net_poller_del(net_poller* poller, socket_t socket)
+{
+    int i = poller_find(poller, socket);
+    if (i == -1) return -1;
+    poller->count--;
+    poller->fds[i] = poller->fds[poller->count];
+    poller->ptrs[i] = poller->ptrs[poller->count];
+    return 0;
+}
+
+int net_poller_wait(net_poller* poller, net_poll_event* events, int max_events, int timeout_ms)
+{
+    int ready = poll(poller->fds, (nfds_t)poller->count, timeout_ms);
+    if (ready < 0) {
+#ifndef _WIN32
+        if (errno == EINTR) return 0;
+#endif
+        return -1;
+    }
+
+    int count = 0;
+    for (int n = 0; n < poller->count && count < max_events; n++) {
+        int i = (poller->next + n) % poller->count;
+        short ev = poller->fds[i].revents;
+        if (!ev) continue;
+        events[count].ptr = poller->ptrs[i];
+        events[count].events = ((ev & POLLIN) ? NET_POLL_IN : 0) | ((ev & POLLOUT) ? NET_POLL_OUT : 0) |
+            ((ev & (POLLERR | POLLHUP | POLLNVAL)) ? NET_POLL_ERR : 0);
+        count++;
+    }
+    if (poller->count) poller->next = (poller->next + 1) % poller->count;
+    return count;
+}
+
+#endif
+
+int net_poll_socket(socket_t socket, unsigned events, int timeout_ms)
+{
+    struct pollfd fd;
+    fd.fd = socket;
+    fd.events = (short)(((events & NET_POLL_IN) ? POLLIN : 0) | ((events & NET_POLL_OUT) ? POLLOUT : 0));
+    fd.revents = 0;
+#ifdef _WIN32
+    int ready = WSAPoll(&fd, 1, timeout_ms);
+#else
+    int ready = poll(&fd, 1, timeout_ms);
+#endif
+    if (ready < 0) return -1;
+    return ((fd.revents & POLLIN) ? NET_POLL_IN : 0) | ((fd.revents & POLLOUT) ? NET_POLL_OUT : 0) |
+        ((fd.revents & (POLLERR | POLLHUP | POLLNVAL)) ? NET_POLL_ERR : 0);
+}
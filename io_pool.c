@@ -0,0 +1,276 @@
+//
+// Client connection pool.
+// Keeps idle connections per addr:port warm and hands them out again,
+// so request/response exchanges skip name resolution, the TCP handshake
+// and slow start. Not thread-safe, use one pool per thread.
+//
+
+#if defined(__MINGW32__) && !defined(_WIN32_WINNT)
+// mingw bug. for ws2tcpip.h
+#define _WIN32_WINNT 0x501
+#endif
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <unistd.h>
+    #include <sys/socket.h>
+    #include <netdb.h>
+    #include <errno.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+typedef struct pool_idle {
+    socket_t socket;
+    time_t since;
+} pool_idle;
+
+typedef struct pool_host {
+    char addr[NET_MAX_STRING];
+    char port[NET_MAX_STRING];
+    struct addrinfo* server_info; // resolved once
+    pool_idle* idle;              // stack, warmest on top
+    int idle_count;
+    struct pool_host* next;
+} pool_host;
+
+// Socket handed out by TCP_pool_acquire()
+typedef struct pool_busy {
+    socket_t socket;
+    pool_host* host;
+    bool reused;
+} pool_busy;
+
+struct net_pool {
+    int max_idle;
+    int idle_timeout;
+    pool_host* hosts;
+    pool_busy* busy;
+    int busy_count, busy_cap;
+    bool has_opts;
+    net_sockopts opts;  // for new connections
+    net_pool_stats stats;
+};
+
+net_pool* TCP_pool_create(int max_idle, int idle_timeout)
+{
+    if (max_idle <= 0 || idle_timeout <= 0) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return NULL;
+    }
+    net_pool* pool = (net_pool*)calloc(1, sizeof(net_pool));
+    if (!pool) {
+        fprintf(stderr, "ERROR: Out of memory!\n");
+        return NULL;
+    }
+    pool->max_idle = max_idle;
+    pool->idle_timeout = idle_timeout;
+    return pool;
+}
+
+void TCP_pool_destroy(net_pool* pool)
+{
+    if (!pool) return;
+    pool_host* host = pool->hosts;
+    while (host) {
+        pool_host* next = host->next;
+        for (int i = 0; i < host->idle_count; i++) TCP_close(host->idle[i].socket);
+        if (host->server_info) freeaddrinfo(host->server_info);
+        free(host->idle);
+        free(host);
+        host = next;
+    }
+    // sockets still handed out belong to the caller now
+    free(pool->busy);
+    free(pool);
+}
+
+static pool_host* host_get(net_pool* pool, const char* addr, const char* port)
+{
+    if (!addr || !port || strlen(addr) >= NET_MAX_STRING || strlen(port) >= NET_MAX_STRING) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return NULL;
+    }
+    for (pool_host* host = pool->hosts; host; host = host->next) {
+        if (strcmp(host->addr, addr) == 0 && strcmp(host->port, port) == 0) return host;
+    }
+    pool_host* host = (pool_host*)calloc(1, sizeof(pool_host));
+    if (host) host->idle = (pool_idle*)malloc(pool->max_idle * sizeof(pool_idle));
+    if (!host || !host->idle) {
+        fprintf(stderr, "ERROR: Out of memory!\n");
+        free(host);
+        return NULL;
+    }
+    strcpy(host->addr, addr);
+    strcpy(host->port, port);
+    host->next = pool->hosts;
+    pool->hosts = host;
+    return host;
+}
+
+// An idle connection is reusable if nothing is readable on it:
+// EOF means the server closed it, unexpected bytes mean a broken exchange.
+static bool idle_alive(socket_t socket)
+{
+    int ready = net_poll_socket(socket, NET_POLL_IN, 0);
+    return ready == 0;
+}
+
+static socket_t pool_connect(net_pool* pool, pool_host* host)
+{
+    if (!host->server_info && net_resolve(host->addr, host->port, &host->server_info) == -1) return INV_SOCKET;
+    socket_t socket = net_connect_addrinfo(host->server_info, pool->has_opts ? &pool->opts : NULL, false);
+    if (socket == INV_SOCKET) {
+        // address may have moved, resolve again next time
+        freeaddrinfo(host->server_info);
+        host->server_info = NULL;
+        return INV_SOCKET;
+    }
+    pool->stats.connects++;
+    return socket;
+}
+
+static bool busy_add(net_pool* pool, socket_t socket, pool_host* host, bool reused)
+{
+    if (pool->busy_count == pool->busy_cap) {
+        int cap = pool->busy_cap ? pool->busy_cap * 2 : 16;
+        pool_busy* busy = (pool_busy*)realloc(pool->busy, cap * sizeof(pool_busy));
+        if (!busy) {
+            fprintf(stderr, "ERROR: Out of memory!\n");
+            return false;
+        }
+        pool->busy = busy;
+        pool->busy_cap = cap;
+    }
+    pool->busy[pool->busy_count].socket = socket;
+    pool->busy[pool->busy_count].host = host;
+    pool->busy[pool->busy_count].reused = reused;
+    pool->busy_count++;
+    return true;
+}
+
+static socket_t acquire(net_pool* pool, const char* addr, const char* port, bool fresh)
+{
+    pool_host* host = host_get(pool, addr, port);
+    if (!host) return INV_SOCKET;
+
+    time_t now = time(NULL);
+    while (host->idle_count && !fresh) {
+        pool_idle idle = host->idle[--host->idle_count];
+        if (now - idle.since < pool->idle_timeout && idle_alive(idle.socket)) {
+            if (!busy_add(pool, idle.socket, host, true)) {
+                TCP_close(idle.socket);
+                return INV_SOCKET;
+            }
+            pool->stats.reuses++;
+            return idle.socket;
+        }
+        TCP_close(idle.socket);
+        pool->stats.stale++;
+    }
+
+    socket_t socket = pool_connect(pool, host);
+    if (socket == INV_SOCKET) return INV_SOCKET;
+    if (!busy_add(pool, socket, host, false)) {
+        TCP_close(socket);
+        return INV_SOCKET;
+    }
+    return socket;
+}
+
+socket_t TCP_pool_acquire(net_pool* pool, const char* addr, const char* port)
+{
+    return acquire(pool, addr, port, false);
+}
+
+// Forget a handed out socket. returns its entry, false if unknown
+static bool busy_take(net_pool* pool, socket_t socket, pool_busy* entry)
+{
+    for (int i = 0; i < pool->busy_count; i++) {
+        if (pool->busy[i].socket == socket) {
+            *entry = pool->busy[i];
+            pool->busy[i] = pool->busy[--pool->busy_count];
+            return true;
+        }
+    }
+    return false;
+}
+
+void TCP_pool_release(net_pool* pool, socket_t socket, bool reusable)
+{
+    pool_busy entry;
+    if (!busy_take(pool, socket, &entry)) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return;
+    }
+    if (!reusable) {
+        TCP_close(socket);
+        return;
+    }
+
+    pool_host* host = entry.host;
+    if (host->idle_count == pool->max_idle) {
+        // drop the coldest
+        TCP_close(host->idle[0].socket);
+        memmove(host->idle, host->idle + 1, (host->idle_count - 1) * sizeof(pool_idle));
+        host->idle_count--;
+    }
+    host->idle[host->idle_count].socket = socket;
+    host->idle[host->idle_count].since = time(NULL);
+    host->idle_count++;
+}
+
+void TCP_pool_discard(net_pool* pool, socket_t socket)
+{
+    pool_busy entry;
+    busy_take(pool, socket, &entry);
+}
+
+int TCP_pool_exchange(net_pool* pool, const char* addr, const char* port, const char* data, unsigned total_size, net_buffer* response)
+{
+    // checked before taking a connection, TCP_send() rejects these without closing it
+    if (!pool || !response || !total_size || (total_size & 0x80000000) || !data) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    // a reused connection may have died since the liveness check,
+    // retry once on a fresh one in that case
+    for (int attempt = 0; attempt < 2; attempt++) {
+        socket_t socket = acquire(pool, addr, port, attempt != 0);
+        if (socket == INV_SOCKET) return -1;
+        bool reused = pool->busy[pool->busy_count - 1].reused; // just appended
+
+        int ret = TCP_send(socket, data, total_size);
+        if (ret != -1) ret = TCP_recv_buffer(socket, response);
+        if (ret != -1) {
+            TCP_pool_release(pool, socket, true);
+            return ret;
+        }
+        // the failed call closed the socket
+        TCP_pool_discard(pool, socket);
+        if (!reused) return -1;
+        pool->stats.retries++;
+    }
+    return -1;
+}
+
+void TCP_pool_set_sockopts(net_pool* pool, const net_sockopts* opts)
+{
+    pool->has_opts = opts != NULL;
+    if (opts) pool->opts = *opts;
+}
+
+void TCP_pool_get_stats(const net_pool* pool, net_pool_stats* stats)
+{
+    *stats = pool->stats;
+}
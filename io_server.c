@@ -0,0 +1,804 @@
+//
+// Single-threaded multi-client message server.
+// Non-blocking sockets driven by net_poller, or io_uring multishot
+// accept/recv when that backend is selected. One state machine per connection.
+//
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <winsock2.h>
+#else
+    #include <unistd.h>
+    #include <sys/socket.h>
+    #include <errno.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+#define NET_SERVER_INBUF (64 * 1024)    // per-connection staging for headers and small messages
+#define NET_SERVER_READ_BUDGET 16       // recv calls per readiness event, for fairness
+#define NET_SERVER_EVENTS 64
+#define NET_SERVER_ACCEPT_BACKOFF 100   // ms without accepting after an accept error (out of descriptors)
+
+#if defined(NET_HAVE_URING) && defined(IORING_RECV_MULTISHOT)
+#define NET_URING_SERVER 1
+#define NET_URING_SERVER_ENTRIES 256
+#define NET_URING_SERVER_BUFS 64           // provided receive buffers, power of 2
+#define NET_URING_SERVER_BUFSIZE (16 * 1024)
+#define NET_URING_SERVER_GROUP 0
+
+// completion tags in the low bits of user_data, pointers are 8-aligned
+enum { OP_ACCEPT = 1, OP_RECV, OP_SEND, OP_TIMEOUT, OP_MASK = 7 };
+#endif
+
+enum { CONN_HEADER, CONN_PAYLOAD };
+
+struct net_conn {
+    socket_t socket;
+    void* user;
+    bool dead;          // closed, freed at the end of the poll iteration
+    net_conn* prev;
+    net_conn* next;
+
+    // input state machine
+    int state;
+    char in[NET_SERVER_INBUF];
+    size_t in_off, in_len;   // unparsed bytes are in[in_off, in_len)
+    net_buffer payload;      // reused across messages
+    uint64_t payload_have;
+    uint64_t payload_want;   // payload and trailer bytes
+    uint64_t payload_start;  // net_now_ns() when its header was parsed
+    net_stats* stats;        // NULL if the table is full
+
+    // queued output
+    char* out;
+    size_t out_off, out_len, out_cap;
+    bool want_out;           // registered for NET_POLL_OUT
+
+#ifdef NET_URING_SERVER
+    int inflight;            // io_uring ops referencing this conn
+    bool recv_armed;
+    bool send_inflight;      // kernel reads out[out_off, out_len), must not move
+    char* spill;             // output queued while a send is in flight
+    size_t spill_len, spill_cap;
+#endif
+};
+
+struct net_server {
+    socket_t listen_socket;
+    net_server_callbacks cb;
+    void* user;
+    net_poller* poller;
+    net_conn* conns;
+    bool stop;
+    uint64_t accept_resume; // net_now_ns() to accept again after an error, 0 when accepting
+
+#ifdef NET_URING_SERVER
+    net_uring* ring;         // NULL when using the poller
+    struct io_uring_buf_ring* bufring;
+    char* bufs;
+    bool accept_armed;
+    struct __kernel_timespec timeout;
+#endif
+};
+
+#ifdef NET_URING_SERVER
+static bool uring_init(net_server* server);
+static void uring_arm_recv(net_server* server, net_conn* conn);
+static void uring_flush(net_server* server, net_conn* conn);
+static int uring_poll(net_server* server, int timeout_ms);
+#endif
+
+net_server* TCP_server_create(socket_t listen_socket, const net_server_callbacks* callbacks, void* user)
+{
+    if (listen_socket == INV_SOCKET || !callbacks) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return NULL;
+    }
+    net_server* server = (net_server*)calloc(1, sizeof(net_server));
+    if (!server) {
+        fprintf(stderr, "ERROR: Out of memory!\n");
+        return NULL;
+    }
+    server->listen_socket = listen_socket;
+    server->cb = *callbacks;
+    server->user = user;
+#ifdef NET_URING_SERVER
+    if (TCP_get_backend() == NET_BACKEND_URING) {
+        if (uring_init(server)) return server;
+        fprintf(stderr, "WARNING: io_uring server unavailable, using poller!\n");
+    }
+#endif
+    server->poller = net_poller_create();
+    if (!server->poller ||
+        net_set_nonblocking(listen_socket, true) == -1 ||
+        net_poller_add(server->poller, listen_socket, NET_POLL_IN, server) == -1) {
+        fprintf(stderr, "ERROR: Server setup failed with err %d!\n", TCP_ERRNO);
+        net_poller_destroy(server->poller);
+        free(server);
+        return NULL;
+    }
+    return server;
+}
+
+static void conn_free(net_conn* conn)
+{
+    net_buffer_free(&conn->payload);
+    free(conn->out);
+#ifdef NET_URING_SERVER
+    free(conn->spill);
+#endif
+    free(conn);
+}
+
+void TCP_server_close(net_server* server, net_conn* conn)
+{
+    if (conn->dead) return;
+    conn->dead = true;
+#ifdef NET_URING_SERVER
+    if (server->ring) {
+        // ends the multishot recv; memory lives until all ops complete
+        shutdown(conn->socket, SHUT_RDWR);
+    }
+    else
+#endif
+    net_poller_del(server->poller, conn->socket);
+    TCP_close(conn->socket);
+    if (server->cb.on_close) server->cb.on_close(server, conn, server->user);
+}
+
+// Free connections closed during this iteration.
+static void sweep_dead(net_server* server)
+{
+    net_conn* conn = server->conns;
+    while (conn) {
+        net_conn* next = conn->next;
+        bool idle = true;
+#ifdef NET_URING_SERVER
+        idle = conn->inflight == 0;
+#endif
+        if (conn->dead && idle) {
+            if (conn->prev) conn->prev->next = conn->next;
+            else server->conns = conn->next;
+            if (conn->next) conn->next->prev = conn->prev;
+            conn_free(conn);
+        }
+        conn = next;
+    }
+}
+
+void TCP_server_destroy(net_server* server)
+{
+    if (!server) return;
+    for (net_conn* conn = server->conns; conn; conn = conn->next) {
+        TCP_server_close(server, conn);
+    }
+#ifdef NET_URING_SERVER
+    if (server->ring) {
+        // closing the ring cancels what is still in flight
+        net_uring_destroy(server->ring);
+        for (net_conn* conn = server->conns; conn; conn = conn->next) conn->inflight = 0;
+        sweep_dead(server);
+        free(server->bufring);
+        free(server->bufs);
+        free(server);
+        return;
+    }
+#endif
+    sweep_dead(server);
+    net_poller_del(server->poller, server->listen_socket);
+    net_poller_destroy(server->poller);
+    free(server);
+}
+
+// Track a newly accepted socket. returns NULL on failure (socket closed)
+static net_conn* conn_create(net_server* server, socket_t socket)
+{
+    net_conn* conn = (net_conn*)calloc(1, sizeof(net_conn));
+    if (!conn) {
+        fprintf(stderr, "ERROR: Server connection setup failed!\n");
+        TCP_close(socket);
+        return NULL;
+    }
+    conn->socket = socket;
+    conn->state = CONN_HEADER;
+    net_set_nosigpipe(socket);
+    conn->stats = net_stats_find(socket);
+    net_buffer_init(&conn->payload);
+#ifdef NET_URING_SERVER
+    if (!server->ring)
+#endif
+    if (net_set_nonblocking(socket, true) == -1 ||
+        net_poller_add(server->poller, socket, NET_POLL_IN, conn) == -1) {
+        fprintf(stderr, "ERROR: Server connection setup failed!\n");
+        free(conn);
+        TCP_close(socket);
+        return NULL;
+    }
+    conn->next = server->conns;
+    if (server->conns) server->conns->prev = conn;
+    server->conns = conn;
+
+    if (server->cb.on_accept && !server->cb.on_accept(server, conn, server->user)) {
+        TCP_server_close(server, conn);
+        return NULL;
+    }
+#ifdef NET_URING_SERVER
+    if (server->ring && !conn->dead) uring_arm_recv(server, conn);
+#endif
+    return conn;
+}
+
+// Stop accepting for NET_SERVER_ACCEPT_BACKOFF ms. The pending connection
+// keeps the listen socket readable, polling it would spin until a descriptor frees up.
+static void accept_backoff(net_server* server, int err)
+{
+    fprintf(stderr, "WARNING: Server accept failed with err %d!\n", err);
+    server->accept_resume = net_now_ns() + NET_SERVER_ACCEPT_BACKOFF * 1000000ull;
+    if (server->poller) net_poller_mod(server->poller, server->listen_socket, 0, server);
+}
+
+// Accept again once the back-off ran out.
+// returns timeout_ms, shortened to wake up for that
+static int accept_resume(net_server* server, int timeout_ms)
+{
+    if (!server->accept_resume) return timeout_ms;
+    uint64_t now = net_now_ns();
+    if (now >= server->accept_resume) {
+        server->accept_resume = 0;
+        if (server->poller) net_poller_mod(server->poller, server->listen_socket, NET_POLL_IN, server);
+        return timeout_ms;
+    }
+    int left = (int)((server->accept_resume - now + 999999) / 1000000);
+    return timeout_ms < 0 || left < timeout_ms ? left : timeout_ms;
+}
+
+static void accept_all(net_server* server)
+{
+    while (true) {
+        socket_t socket = accept(server->listen_socket, NULL, NULL);
+        if (socket == INV_SOCKET) {
+            int err = TCP_ERRNO;
+            if (!TCP_WOULDBLOCK(err)) accept_backoff(server, err);
+            return;
+        }
+        conn_create(server, socket);
+    }
+}
+
+static void update_interest(net_server* server, net_conn* conn)
+{
+    bool want_out = conn->out_off != conn->out_len;
+    if (want_out == conn->want_out) return;
+    conn->want_out = want_out;
+    net_poller_mod(server->poller, conn->socket, NET_POLL_IN | (want_out ? NET_POLL_OUT : 0), conn);
+}
+
+// Send as much queued output as the socket takes.
+// returns 0, -1 for error (connection closed)
+static int flush_out(net_server* server, net_conn* conn)
+{
+#ifdef NET_URING_SERVER
+    if (server->ring) {
+        uring_flush(server, conn);
+        return 0;
+    }
+#endif
+    while (conn->out_off != conn->out_len) {
+        net_count_syscall(conn->stats);
+        int send_byte = send(conn->socket, conn->out + conn->out_off,
+            (int)MIN(conn->out_len - conn->out_off, (size_t)0x40000000), NET_NOSIGNAL);
+        net_count_bytes(conn->stats, false, send_byte, MIN(conn->out_len - conn->out_off, (size_t)0x40000000));
+        if (send_byte == -1) {
+            int err = TCP_ERRNO;
+            if (TCP_WOULDBLOCK(err)) break;
+            // a client that went away only ends its own connection
+            if (!TCP_PEER_GONE(err)) fprintf(stderr, "ERROR: Server send failed with err %d\n", err);
+            TCP_server_close(server, conn);
+            return -1;
+        }
+        conn->out_off += send_byte;
+    }
+    if (conn->out_off == conn->out_len) conn->out_off = conn->out_len = 0;
+    update_interest(server, conn);
+    return 0;
+}
+
+// Queue header and payload behind pending output, checksummed if net_checksummed().
+// returns 0, -1 for error
+static int queue_msg(net_server* server, net_conn* conn, const net_header* header, const char* data)
+{
+    net_header checked;
+    if (net_checksummed(header->flags)) {
+        checked = *header;
+        checked.flags |= NET_FLAG_CHECKSUM;
+        checked.checksum = TCP_crc32(0, data, (size_t)header->length);
+        header = &checked;
+    }
+    char buffer[NET_MAXHEADER];
+    int header_len = net_encode_frame(buffer, header);
+    if (header_len == -1) return -1;
+
+#ifdef NET_URING_SERVER
+    if (server->ring && conn->send_inflight) {
+        // out is pinned by the kernel, queue behind it
+        size_t need = conn->spill_len + header_len + (size_t)header->length;
+        if (need > conn->spill_cap) {
+            size_t cap = MAX(need, conn->spill_cap * 2);
+            char* spill = (char*)realloc(conn->spill, cap);
+            if (!spill) {
+                fprintf(stderr, "ERROR: Out of memory!\n");
+                return -1;
+            }
+            conn->spill = spill;
+            conn->spill_cap = cap;
+        }
+        memcpy(conn->spill + conn->spill_len, buffer, header_len);
+        conn->spill_len += header_len;
+        if (header->length) memcpy(conn->spill + conn->spill_len, data, (size_t)header->length);
+        conn->spill_len += (size_t)header->length;
+        return 0;
+    }
+#endif
+
+    // queue header and payload behind pending output
+    size_t need = conn->out_len + header_len + (size_t)header->length;
+    if (need > conn->out_cap) {
+        if (conn->out_off) {
+            memmove(conn->out, conn->out + conn->out_off, conn->out_len - conn->out_off);
+            conn->out_len -= conn->out_off;
+            conn->out_off = 0;
+            need = conn->out_len + header_len + (size_t)header->length;
+        }
+        if (need > conn->out_cap) {
+            size_t cap = MAX(need, conn->out_cap * 2);
+            char* out = (char*)realloc(conn->out, cap);
+            if (!out) {
+                fprintf(stderr, "ERROR: Out of memory!\n");
+                return -1;
+            }
+            conn->out = out;
+            conn->out_cap = cap;
+        }
+    }
+    memcpy(conn->out + conn->out_len, buffer, header_len);
+    conn->out_len += header_len;
+    if (header->length) memcpy(conn->out + conn->out_len, data, (size_t)header->length);
+    conn->out_len += (size_t)header->length;
+
+    return flush_out(server, conn);
+}
+
+int TCP_server_send(net_server* server, net_conn* conn, const net_header* header, const char* data)
+{
+    if (!server || !conn || !header || (header->length && !data)) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    if (conn->dead) return -1;
+
+    if (net_compressible(header->length) && !(header->flags & NET_FLAG_COMPRESSED)) {
+        char* packed = (char*)malloc((size_t)header->length);
+        int64_t packed_len = packed ? net_compress(data, (size_t)header->length, packed) : -1;
+        if (packed_len != -1) {
+            net_header h = *header;
+            h.flags |= NET_FLAG_COMPRESSED;
+            h.length = (uint64_t)packed_len;
+            int ret = queue_msg(server, conn, &h, packed);
+            free(packed);
+            if (ret == -1) return -1;
+            net_count_msg(conn->stats, false, h.length, 0);
+            return (int)header->length;
+        }
+        // incompressible (or out of memory), send as is
+        free(packed);
+    }
+    if (queue_msg(server, conn, header, data) == -1) return -1;
+    net_count_msg(conn->stats, false, header->length, 0);
+    return (int)header->length;
+}
+
+// Run the state machine over staged input.
+// returns 0, -1 for error (connection closed)
+static int parse_input(net_server* server, net_conn* conn)
+{
+    while (!conn->dead) {
+        size_t avail = conn->in_len - conn->in_off;
+        unsigned char* p = (unsigned char*)conn->in + conn->in_off;
+
+        if (conn->state == CONN_HEADER) {
+            if (avail < NET_MAXINIT) break;
+            int size = net_header_size(p);
+            if (avail < (size_t)size) break;
+            net_header header;
+            if (net_decode_header(p, &header) == -1 || header.length > (uint64_t)(SIZE_MAX >> 1) ||
+                header.length > net_max_message ||
+                !net_buffer_reserve(&conn->payload, (size_t)header.length + net_trailer_size(header.flags))) {
+                fprintf(stderr, "ERROR: Server rejected message header!\n");
+                TCP_server_close(server, conn);
+                return -1;
+            }
+            conn->in_off += size;
+            conn->payload.header = header;
+            conn->payload_have = 0;
+            conn->payload_want = header.length + net_trailer_size(header.flags);
+            conn->payload_start = net_now_ns();
+            conn->state = CONN_PAYLOAD;
+            continue;
+        }
+
+        uint64_t left = conn->payload_want - conn->payload_have;
+        size_t take = (size_t)MIN((uint64_t)avail, left);
+        memcpy(conn->payload.data + conn->payload_have, conn->in + conn->in_off, take);
+        conn->in_off += take;
+        conn->payload_have += take;
+        if (conn->payload_have != conn->payload_want) break;
+
+        conn->payload.size = (size_t)conn->payload.header.length;
+        conn->state = CONN_HEADER;
+        net_count_msg(conn->stats, true, conn->payload.size, conn->payload_start);
+        unsigned char trailer[NET_TRACE_SIZE];
+        bool traced = conn->payload.header.flags & NET_FLAG_TRACED;
+        if (traced) memcpy(trailer, conn->payload.data + conn->payload.size, NET_TRACE_SIZE);
+        if (!net_checksum_ok(&conn->payload.header, conn->payload.data, conn->payload.size)) {
+            TCP_server_close(server, conn);
+            return -1;
+        }
+        if ((conn->payload.header.flags & NET_FLAG_COMPRESSED) && net_buffer_inflate(&conn->payload) == -1) {
+            fprintf(stderr, "ERROR: Server rejected compressed message!\n");
+            TCP_server_close(server, conn);
+            return -1;
+        }
+        if (traced) net_trace_record(conn->socket, &conn->payload.header, trailer, conn->payload_start, net_now_ns());
+        if (server->cb.on_message) {
+            server->cb.on_message(server, conn, &conn->payload.header, conn->payload.data, server->user);
+        }
+    }
+
+    // keep unparsed bytes at the front
+    if (conn->in_off == conn->in_len) conn->in_off = conn->in_len = 0;
+    else if (conn->in_off > NET_SERVER_INBUF / 2) {
+        memmove(conn->in, conn->in + conn->in_off, conn->in_len - conn->in_off);
+        conn->in_len -= conn->in_off;
+        conn->in_off = 0;
+    }
+    return conn->dead ? -1 : 0;
+}
+
+// Run the state machine over received bytes from outside the staging buffer.
+// returns 0, -1 for error (connection closed)
+static int feed_input(net_server* server, net_conn* conn, const char* data, size_t len)
+{
+    while (len && !conn->dead) {
+        if (conn->state == CONN_PAYLOAD && conn->in_off == conn->in_len) {
+            // straight into the payload
+            uint64_t left = conn->payload_want - conn->payload_have;
+            size_t take = (size_t)MIN((uint64_t)len, left);
+            memcpy(conn->payload.data + conn->payload_have, data, take);
+            conn->payload_have += take;
+            data += take;
+            len -= take;
+        }
+        else {
+            if (conn->in_len == NET_SERVER_INBUF) {
+                memmove(conn->in, conn->in + conn->in_off, conn->in_len - conn->in_off);
+                conn->in_len -= conn->in_off;
+                conn->in_off = 0;
+            }
+            size_t take = MIN(len, NET_SERVER_INBUF - conn->in_len);
+            memcpy(conn->in + conn->in_len, data, take);
+            conn->in_len += take;
+            data += take;
+            len -= take;
+        }
+        if (parse_input(server, conn) == -1) return -1;
+    }
+    return conn->dead ? -1 : 0;
+}
+
+static void read_input(net_server* server, net_conn* conn)
+{
+    for (int i = 0; i < NET_SERVER_READ_BUDGET && !conn->dead; i++) {
+        int recv_byte;
+        uint64_t left = conn->payload_want - conn->payload_have;
+        if (conn->state == CONN_PAYLOAD && conn->in_off == conn->in_len && left >= NET_SERVER_INBUF) {
+            // large payload: receive in place, skipping the staging copy
+            net_count_syscall(conn->stats);
+            recv_byte = recv(conn->socket, conn->payload.data + conn->payload_have,
+                (int)MIN(left, (uint64_t)0x40000000), 0);
+            net_count_bytes(conn->stats, true, recv_byte, MIN(left, (uint64_t)0x40000000));
+            if (recv_byte > 0) {
+                conn->payload_have += recv_byte;
+                if (parse_input(server, conn) == -1) return;
+                continue;
+            }
+        }
+        else {
+            if (conn->in_len == NET_SERVER_INBUF) {
+                memmove(conn->in, conn->in + conn->in_off, conn->in_len - conn->in_off);
+                conn->in_len -= conn->in_off;
+                conn->in_off = 0;
+            }
+            net_count_syscall(conn->stats);
+            recv_byte = recv(conn->socket, conn->in + conn->in_len, (int)(NET_SERVER_INBUF - conn->in_len), 0);
+            net_count_bytes(conn->stats, true, recv_byte, NET_SERVER_INBUF - conn->in_len);
+            if (recv_byte > 0) {
+                conn->in_len += recv_byte;
+                if (parse_input(server, conn) == -1) return;
+                continue;
+            }
+        }
+
+        if (recv_byte == 0) {
+            TCP_server_close(server, conn);
+            return;
+        }
+        int err = TCP_ERRNO;
+        if (TCP_WOULDBLOCK(err)) return;
+        fprintf(stderr, "ERROR: Server receive failed with err %d\n", err);
+        TCP_server_close(server, conn);
+        return;
+    }
+}
+
+int TCP_server_poll(net_server* server, int timeout_ms)
+{
+    timeout_ms = accept_resume(server, timeout_ms);
+#ifdef NET_URING_SERVER
+    if (server->ring) return uring_poll(server, timeout_ms);
+#endif
+    net_poll_event events[NET_SERVER_EVENTS];
+    int count = net_poller_wait(server->poller, events, NET_SERVER_EVENTS, timeout_ms);
+    if (count == -1) {
+        fprintf(stderr, "ERROR: Server poll failed with err %d\n", TCP_ERRNO);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (events[i].ptr == server) {
+            accept_all(server);
+            continue;
+        }
+        net_conn* conn = (net_conn*)events[i].ptr;
+        if (conn->dead) continue;
+        if (events[i].events & NET_POLL_OUT) flush_out(server, conn);
+        if (!conn->dead && (events[i].events & (NET_POLL_IN | NET_POLL_ERR))) read_input(server, conn);
+    }
+
+    sweep_dead(server);
+    return count;
+}
+
+int TCP_server_run(net_server* server)
+{
+    server->stop = false;
+    while (!server->stop) {
+        if (TCP_server_poll(server, 1000) == -1) return -1;
+    }
+    return 0;
+}
+
+void TCP_server_stop(net_server* server)
+{
+    server->stop = true;
+}
+
+socket_t TCP_conn_socket(const net_conn* conn)
+{
+    return conn->socket;
+}
+
+void* TCP_conn_user(const net_conn* conn)
+{
+    return conn->user;
+}
+
+void TCP_conn_set_user(net_conn* conn, void* user)
+{
+    conn->user = user;
+}
+
+size_t TCP_conn_pending(const net_conn* conn)
+{
+#ifdef NET_URING_SERVER
+    return conn->out_len - conn->out_off + conn->spill_len;
+#else
+    return conn->out_len - conn->out_off;
+#endif
+}
+
+
+#ifdef NET_URING_SERVER
+
+static void uring_arm_accept(net_server* server)
+{
+    struct io_uring_sqe* sqe = net_uring_sqe(server->ring);
+    if (!sqe) return; // retried on the next poll
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = server->listen_socket;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = (uint64_t)(uintptr_t)server | OP_ACCEPT;
+    server->accept_armed = true;
+}
+
+static void uring_arm_recv(net_server* server, net_conn* conn)
+{
+    struct io_uring_sqe* sqe = net_uring_sqe(server->ring);
+    if (!sqe) return;
+    // one request keeps delivering into buffers picked from the provided ring
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->socket;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = NET_URING_SERVER_GROUP;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | OP_RECV;
+    conn->recv_armed = true;
+    conn->inflight++;
+}
+
+static void uring_flush(net_server* server, net_conn* conn)
+{
+    if (conn->dead || conn->send_inflight) return;
+    if (conn->out_off == conn->out_len) {
+        conn->out_off = conn->out_len = 0;
+        if (!conn->spill_len) return;
+        // swap in everything queued during the last send
+        char* out = conn->out;
+        size_t cap = conn->out_cap;
+        conn->out = conn->spill;
+        conn->out_cap = conn->spill_cap;
+        conn->out_len = conn->spill_len;
+        conn->spill = out;
+        conn->spill_cap = cap;
+        conn->spill_len = 0;
+    }
+    struct io_uring_sqe* sqe = net_uring_sqe(server->ring);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = conn->socket;
+    sqe->addr = (uint64_t)(uintptr_t)(conn->out + conn->out_off);
+    sqe->len = (uint32_t)MIN(conn->out_len - conn->out_off, (size_t)0x40000000);
+    sqe->msg_flags = MSG_WAITALL | NET_NOSIGNAL;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | OP_SEND;
+    conn->send_inflight = true;
+    conn->inflight++;
+}
+
+static void recycle_buffer(net_server* server, unsigned bid, unsigned offset)
+{
+    struct io_uring_buf* buf = &server->bufring->bufs[(server->bufring->tail + offset) & (NET_URING_SERVER_BUFS - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(server->bufs + (size_t)bid * NET_URING_SERVER_BUFSIZE);
+    buf->len = NET_URING_SERVER_BUFSIZE;
+    buf->bid = (uint16_t)bid;
+}
+
+static bool uring_init(net_server* server)
+{
+    server->ring = net_uring_create(NET_URING_SERVER_ENTRIES);
+    if (!server->ring) return false;
+
+    // ring of buffer descriptors must be page aligned
+    void* mem = NULL;
+    if (posix_memalign(&mem, 4096, NET_URING_SERVER_BUFS * sizeof(struct io_uring_buf)) != 0) mem = NULL;
+    server->bufring = (struct io_uring_buf_ring*)mem;
+    server->bufs = (char*)malloc((size_t)NET_URING_SERVER_BUFS * NET_URING_SERVER_BUFSIZE);
+    if (!server->bufring || !server->bufs) goto fail;
+    memset(server->bufring, 0, NET_URING_SERVER_BUFS * sizeof(struct io_uring_buf));
+    if (net_uring_register_bufring(server->ring, server->bufring, NET_URING_SERVER_BUFS, NET_URING_SERVER_GROUP) == -1)
+        goto fail;
+    for (unsigned i = 0; i < NET_URING_SERVER_BUFS; i++) recycle_buffer(server, i, i);
+    __atomic_store_n(&server->bufring->tail, (uint16_t)NET_URING_SERVER_BUFS, __ATOMIC_RELEASE);
+
+    uring_arm_accept(server);
+    return true;
+
+fail:
+    net_uring_destroy(server->ring);
+    server->ring = NULL;
+    free(server->bufring);
+    free(server->bufs);
+    server->bufring = NULL;
+    server->bufs = NULL;
+    return false;
+}
+
+static int uring_poll(net_server* server, int timeout_ms)
+{
+    if (!server->accept_armed && !server->accept_resume) uring_arm_accept(server);
+    for (net_conn* conn = server->conns; conn; conn = conn->next) {
+        // re-arm receives that ran out of buffers
+        if (!conn->dead && !conn->recv_armed) uring_arm_recv(server, conn);
+    }
+
+    unsigned wait_nr = 1;
+    if (timeout_ms >= 0) {
+        // completes on the first other completion or after the timeout
+        struct io_uring_sqe* sqe = net_uring_sqe(server->ring);
+        if (sqe) {
+            server->timeout.tv_sec = timeout_ms / 1000;
+            server->timeout.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+            sqe->opcode = IORING_OP_TIMEOUT;
+            sqe->addr = (uint64_t)(uintptr_t)&server->timeout;
+            sqe->len = 1;
+            sqe->off = 1;
+            sqe->user_data = OP_TIMEOUT;
+        }
+        else wait_nr = 0;
+    }
+    if (net_uring_submit(server->ring, wait_nr) == -1) {
+        fprintf(stderr, "ERROR: Server io_uring submit failed with err %d\n", TCP_ERRNO);
+        return -1;
+    }
+
+    int count = 0;
+    unsigned recycled = 0;
+    uint64_t user_data;
+    int32_t res;
+    uint32_t flags;
+    while (net_uring_peek(server->ring, &user_data, &res, &flags)) {
+        int op = (int)(user_data & OP_MASK);
+        net_conn* conn = (net_conn*)(uintptr_t)(user_data & ~(uint64_t)OP_MASK);
+        bool more = (flags & IORING_CQE_F_MORE) != 0;
+        if (op == OP_TIMEOUT) continue;
+        count++;
+
+        if (op == OP_ACCEPT) {
+            if (!more) server->accept_armed = false;
+            if (res >= 0) conn_create(server, (socket_t)res);
+            else if (res != -ECANCELED) accept_backoff(server, -res);
+            continue;
+        }
+
+        if (op == OP_SEND) {
+            conn->inflight--;
+            conn->send_inflight = false;
+            if (conn->dead) continue;
+            if (res < 0) {
+                if (!TCP_PEER_GONE(-res)) fprintf(stderr, "ERROR: Server send failed with err %d\n", -res);
+                TCP_server_close(server, conn);
+                continue;
+            }
+            net_count_bytes(conn->stats, false, res, 0);
+            conn->out_off += res;
+            uring_flush(server, conn);
+            continue;
+        }
+
+        // OP_RECV
+        if (!more) {
+            conn->inflight--;
+            conn->recv_armed = false;
+        }
+        if (flags & IORING_CQE_F_BUFFER) {
+            unsigned bid = flags >> IORING_CQE_BUFFER_SHIFT;
+            net_count_bytes(conn->stats, true, res, 0);
+            if (res > 0 && !conn->dead) feed_input(server, conn, server->bufs + (size_t)bid * NET_URING_SERVER_BUFSIZE, res);
+            recycle_buffer(server, bid, recycled++);
+        }
+        if (conn->dead || res == -ENOBUFS) continue;
+        if (res == 0) TCP_server_close(server, conn);
+        else if (res < 0) {
+            fprintf(stderr, "ERROR: Server receive failed with err %d\n", -res);
+            TCP_server_close(server, conn);
+        }
+    }
+    if (recycled) {
+        __atomic_store_n(&server->bufring->tail, (uint16_t)(server->bufring->tail + recycled), __ATOMIC_RELEASE);
+    }
+
+    sweep_dead(server);
+    // hand new sends and re-arms to the kernel without waiting
+    if (net_uring_submit(server->ring, 0) == -1) {
+        fprintf(stderr, "ERROR: Server io_uring submit failed with err %d\n", TCP_ERRNO);
+        return -1;
+    }
+    return count;
+}
+
+#endif
@@ -0,0 +1,109 @@
+//
+// Socket tuning options and presets.
+// Options the platform lacks are skipped silently.
+//
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <winsock2.h>
+#else
+    #include <unistd.h>
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <errno.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+#if defined(TCP_CORK)
+#define NET_TCP_CORK TCP_CORK
+#elif defined(TCP_NOPUSH)
+#define NET_TCP_CORK TCP_NOPUSH // BSD/macOS equivalent
+#endif
+
+void TCP_sockopts_preset(net_sockopts* opts, int preset)
+{
+    memset(opts, 0, sizeof(*opts));
+    switch (preset) {
+    case NET_SOCKOPTS_LOW_LATENCY:
+        // small control messages: no Nagle or delayed ACK, little queued data
+        opts->nodelay = true;
+        opts->quickack = true;
+        opts->notsent_lowat = 16 * 1024;
+        opts->busy_poll = 50;
+        break;
+    case NET_SOCKOPTS_BULK_FRAME:
+        // whole frames: a window large enough for one HD frame in flight,
+        // and no Nagle delay on the last partial segment of each frame
+        opts->nodelay = true;
+        opts->sndbuf = 4 * 1024 * 1024;
+        opts->rcvbuf = 4 * 1024 * 1024;
+        break;
+    default:
+        break;
+    }
+}
+
+static int set_int(socket_t socket, int level, int name, int value, const char* log_name)
+{
+    if (setsockopt(socket, level, name, (const char*)&value, sizeof(value)) == -1) {
+        fprintf(stderr, "WARNING: Setting %s failed with err %d!\n", log_name, TCP_ERRNO);
+        return -1;
+    }
+    return 0;
+}
+
+int TCP_set_sockopts(socket_t socket, const net_sockopts* opts)
+{
+    if (socket == INV_SOCKET || !opts) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    int ret = 0;
+    if (opts->reuseaddr) ret |= set_int(socket, SOL_SOCKET, SO_REUSEADDR, 1, "SO_REUSEADDR");
+    if (opts->sndbuf > 0) ret |= set_int(socket, SOL_SOCKET, SO_SNDBUF, opts->sndbuf, "SO_SNDBUF");
+    if (opts->rcvbuf > 0) ret |= set_int(socket, SOL_SOCKET, SO_RCVBUF, opts->rcvbuf, "SO_RCVBUF");
+#ifndef _WIN32
+    // the rest are TCP options, Unix sockets (unix:, shm:) have none of them
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(socket, (struct sockaddr*)&addr, &len) == 0 && addr.ss_family == AF_UNIX) return ret ? -1 : 0;
+#endif
+    if (opts->nodelay) ret |= set_int(socket, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+#ifdef NET_TCP_CORK
+    if (opts->cork) ret |= set_int(socket, IPPROTO_TCP, NET_TCP_CORK, 1, "TCP_CORK");
+#endif
+#ifdef TCP_QUICKACK
+    if (opts->quickack) ret |= set_int(socket, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+#endif
+#ifdef TCP_NOTSENT_LOWAT
+    if (opts->notsent_lowat > 0)
+        ret |= set_int(socket, IPPROTO_TCP, TCP_NOTSENT_LOWAT, opts->notsent_lowat, "TCP_NOTSENT_LOWAT");
+#endif
+#ifdef SO_BUSY_POLL
+    if (opts->busy_poll > 0) ret |= set_int(socket, SOL_SOCKET, SO_BUSY_POLL, opts->busy_poll, "SO_BUSY_POLL");
+#endif
+    return ret ? -1 : 0;
+}
+
+void TCP_flush(socket_t socket)
+{
+#ifdef NET_TCP_CORK
+    // clearing the cork pushes out the partial segment, then cork again;
+    // sockets that were not corked are left alone
+    int on = 0, off = 0;
+    socklen_t len = sizeof(on);
+    if (getsockopt(socket, IPPROTO_TCP, NET_TCP_CORK, (char*)&on, &len) == -1 || !on) return;
+    setsockopt(socket, IPPROTO_TCP, NET_TCP_CORK, (const char*)&off, sizeof(off));
+    setsockopt(socket, IPPROTO_TCP, NET_TCP_CORK, (const char*)&on, sizeof(on));
+#else
+    (void)socket;
+#endif
+}
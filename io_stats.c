@@ -0,0 +1,215 @@
+//
+// Transfer statistics, per socket and process-wide.
+// The transfer paths bump counters with relaxed atomic adds and readers
+// load them one by one, so neither side ever waits for the other.
+// Per-socket counters live in a fixed open-addressed table keyed by the
+// socket, claimed on first transfer and freed by TCP_close().
+//
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <winsock2.h>
+#else
+    #include <time.h>
+#endif
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+#define STATS_PROBE 8 // slots searched per socket
+
+typedef struct stats_slot {
+    socket_t socket; // INV_SOCKET while free
+    net_stats stats;
+    net_trace_log* trace; // owned by io_trace.c, NULL until the first traced message
+} stats_slot;
+
+net_stats net_totals;
+static stats_slot* stats_slots[NET_STATS_SOCKETS]; // allocated on first claim
+
+#if defined(__GNUC__)
+#define stats_load(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define stats_store(p, v) __atomic_store_n(p, v, __ATOMIC_RELAXED)
+#define stats_cas(p, expected, desired) \
+    __atomic_compare_exchange_n(p, &(expected), desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#elif defined(_WIN32)
+#define stats_load(p) (*(p)) // aligned loads are atomic on Windows targets
+#define stats_store(p, v) (*(p) = (v))
+static bool stats_cas_ptr(void* volatile* p, void* expected, void* desired)
+{
+    return InterlockedCompareExchangePointer(p, desired, expected) == expected;
+}
+#define stats_cas(p, expected, desired) stats_cas_ptr((void* volatile*)(p), (void*)(expected), (void*)(desired))
+#endif
+
+static inline size_t stats_hash(socket_t socket)
+{
+    return (size_t)(((uint64_t)socket * 0x9e3779b97f4a7c15ull) >> 40) % NET_STATS_SOCKETS;
+}
+
+// Slot of socket without claiming one, NULL if it has none.
+static stats_slot* stats_lookup(socket_t socket)
+{
+    size_t h = stats_hash(socket);
+    for (int i = 0; i < STATS_PROBE; i++) {
+        stats_slot* slot = stats_load(&stats_slots[(h + i) % NET_STATS_SOCKETS]);
+        if (slot && stats_load(&slot->socket) == socket) return slot;
+    }
+    return NULL;
+}
+
+net_stats* net_stats_find(socket_t socket)
+{
+    if (socket == INV_SOCKET) return NULL;
+    stats_slot* slot = stats_lookup(socket);
+    if (slot) return &slot->stats;
+
+    // claim a free slot, or allocate an empty one
+    size_t h = stats_hash(socket);
+    for (int i = 0; i < STATS_PROBE; i++) {
+        stats_slot** p = &stats_slots[(h + i) % NET_STATS_SOCKETS];
+        slot = stats_load(p);
+        if (slot) {
+            socket_t expected = INV_SOCKET;
+            if (stats_load(&slot->socket) != INV_SOCKET || !stats_cas(&slot->socket, expected, socket)) continue;
+            memset(&slot->stats, 0, sizeof(slot->stats));
+            return &slot->stats;
+        }
+        slot = (stats_slot*)calloc(1, sizeof(stats_slot));
+        if (!slot) return NULL;
+        slot->socket = socket;
+        stats_slot* empty = NULL;
+        if (stats_cas(p, empty, slot)) return &slot->stats;
+        free(slot);
+        i--; // lost the race, look at the winner
+    }
+    return NULL;
+}
+
+void net_stats_release(socket_t socket)
+{
+    stats_slot* slot = stats_lookup(socket);
+    if (!slot) return;
+    free(slot->trace);
+    slot->trace = NULL;
+    stats_store(&slot->socket, INV_SOCKET);
+}
+
+net_trace_log** net_stats_trace(socket_t socket, bool create)
+{
+    if (!create) {
+        stats_slot* slot = stats_lookup(socket);
+        return slot ? &slot->trace : NULL;
+    }
+    net_stats* stats = net_stats_find(socket);
+    // slot holding stats
+    return stats ? &((stats_slot*)((char*)stats - offsetof(stats_slot, stats)))->trace : NULL;
+}
+
+uint64_t net_now_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+    if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (uint64_t)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static inline int hist_bucket(uint64_t value)
+{
+    if (value < 2) return 0;
+#if defined(__GNUC__)
+    int bucket = 63 - __builtin_clzll(value);
+#else
+    int bucket = 0;
+    while (value >>= 1) bucket++;
+#endif
+    return MIN(bucket, NET_HIST_BUCKETS - 1);
+}
+
+static void count_msg(net_dir_stats* dir, int latency, int throughput)
+{
+    net_stat_add(&dir->messages, 1);
+    if (latency < 0) return;
+    net_stat_add(&dir->latency_us[latency], 1);
+    net_stat_add(&dir->throughput_mbs[throughput], 1);
+}
+
+void net_count_msg(net_stats* stats, bool recv, uint64_t bytes, uint64_t start_ns)
+{
+    int latency = -1, throughput = -1;
+    if (start_ns) {
+        uint64_t ns = net_now_ns() - start_ns;
+        latency = hist_bucket(ns / 1000);
+        // bytes per ns * 1000 = MB/s
+        throughput = hist_bucket(bytes * 1000 / (ns ? ns : 1));
+    }
+    count_msg(recv ? &net_totals.recv : &net_totals.send, latency, throughput);
+    if (stats) count_msg(recv ? &stats->recv : &stats->send, latency, throughput);
+}
+
+int TCP_get_stats(socket_t socket, net_stats* stats)
+{
+    if (!stats) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    const net_stats* src = &net_totals;
+    if (socket != INV_SOCKET) {
+        stats_slot* slot = stats_lookup(socket);
+        if (!slot) return -1;
+        src = &slot->stats;
+    }
+    // all fields are uint64_t
+    const uint64_t* from = (const uint64_t*)src;
+    uint64_t* to = (uint64_t*)stats;
+    for (size_t i = 0; i < sizeof(net_stats) / sizeof(uint64_t); i++) to[i] = stats_load(from + i);
+    return 0;
+}
+
+void TCP_reset_stats(socket_t socket)
+{
+    net_stats* dst = &net_totals;
+    if (socket != INV_SOCKET) {
+        stats_slot* slot = stats_lookup(socket);
+        if (!slot) return;
+        dst = &slot->stats;
+    }
+    uint64_t* to = (uint64_t*)dst;
+    for (size_t i = 0; i < sizeof(net_stats) / sizeof(uint64_t); i++) stats_store(to + i, 0);
+}
+
+uint64_t TCP_syscall_count(void)
+{
+    return stats_load(&net_totals.syscalls);
+}
+
+uint64_t TCP_hist_percentile(const uint64_t* hist, double p)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < NET_HIST_BUCKETS; i++) total += hist[i];
+    if (!total) return 0;
+    // rank of the sample, rounded up
+    double want = p * (double)total;
+    uint64_t rank = (uint64_t)want;
+    if ((double)rank < want) rank++;
+    rank = MAX(rank, 1);
+    uint64_t seen = 0;
+    for (int i = 0; i < NET_HIST_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen >= rank) return (uint64_t)2 << i;
+    }
+    return (uint64_t)2 << (NET_HIST_BUCKETS - 1);
+}
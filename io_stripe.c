@@ -0,0 +1,322 @@
+//
+// Striped bulk transfers over parallel connections.
+// A payload is cut into chunks dealt round-robin over N connections, each
+// driven by its own thread, so neither one flow's congestion window nor one
+// core's send/recv loop caps throughput. The receiver lands every chunk
+// straight at its offset in the destination buffer.
+//
+// Each connection opens with NET_MSG_STRIPE_HELLO (group id, index, count).
+// A transfer is one NET_MSG_STRIPE message per connection: a 16-byte prefix
+//   total(8) chunk_size(4) index(2) count(2)
+// followed by that connection's chunks in order.
+//
+
+#if defined(__MINGW32__) && !defined(_WIN32_WINNT)
+// mingw bug. for ws2tcpip.h
+#define _WIN32_WINNT 0x501
+#endif
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <unistd.h>
+    #include <sys/socket.h>
+    #include <netdb.h>
+    #include <errno.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+#define NET_STRIPE_HELLO 16
+#define NET_STRIPE_PREFIX 16
+#define NET_STRIPE_CHUNK (1024 * 1024) // default chunk size
+
+struct net_stripe {
+    int count;
+    socket_t sockets[NET_STRIPE_MAX];
+};
+
+// One connection's share of a transfer.
+typedef struct stripe_job {
+    net_stripe* stripe;
+    int index;
+    char* data;
+    uint64_t total;
+    size_t chunk_size;
+    bool send;
+} stripe_job;
+
+// Bytes carried by connection index.
+static uint64_t stripe_share(uint64_t total, size_t chunk_size, int index, int count)
+{
+    uint64_t chunks = (total + chunk_size - 1) / chunk_size;
+    uint64_t own = chunks / count + ((uint64_t)index < chunks % count ? 1 : 0);
+    uint64_t bytes = own * chunk_size;
+    // the last chunk may be short
+    if (chunks && (uint64_t)index == (chunks - 1) % count) bytes -= chunks * chunk_size - total;
+    return bytes;
+}
+
+static int send_share(stripe_job* job)
+{
+    net_stripe* stripe = job->stripe;
+    socket_t socket = stripe->sockets[job->index];
+    uint64_t share = stripe_share(job->total, job->chunk_size, job->index, stripe->count);
+
+    net_header header;
+    memset(&header, 0, sizeof(header));
+    header.type = NET_MSG_STRIPE;
+    header.seq = net_next_seq();
+    header.length = NET_STRIPE_PREFIX + share;
+    char buffer[NET_MAXHEADER + NET_STRIPE_PREFIX];
+    int header_len = net_encode_frame(buffer, &header);
+    if (header_len == -1) return -1;
+    unsigned char* p = (unsigned char*)buffer + header_len;
+    put_le64(p, job->total);
+    put_le32(p + 8, (uint32_t)job->chunk_size);
+    put_le16(p + 12, (uint16_t)job->index);
+    put_le16(p + 14, (uint16_t)stripe->count);
+
+    // header and prefix ride along with the first chunk
+    net_iovec iov[2] = { { buffer, (size_t)header_len + NET_STRIPE_PREFIX }, { NULL, 0 } };
+    int first = 0;
+    uint64_t step = (uint64_t)job->chunk_size * stripe->count;
+    for (uint64_t offset = (uint64_t)job->index * job->chunk_size; offset < job->total; offset += step) {
+        iov[1].base = job->data + offset;
+        iov[1].len = (size_t)MIN((uint64_t)job->chunk_size, job->total - offset);
+        if (sendv_data(socket, iov + first, 2 - first, 0, "Stripe") == -1) return -1;
+        first = 1;
+    }
+    if (!first && sendv_data(socket, iov, 1, 0, "Stripe") == -1) return -1;
+    return 0;
+}
+
+static int recv_share(stripe_job* job)
+{
+    net_stripe* stripe = job->stripe;
+    socket_t socket = stripe->sockets[job->index];
+    uint64_t step = (uint64_t)job->chunk_size * stripe->count;
+    for (uint64_t offset = (uint64_t)job->index * job->chunk_size; offset < job->total; offset += step) {
+        size_t len = (size_t)MIN((uint64_t)job->chunk_size, job->total - offset);
+        if (recv_data(socket, job->data + offset, len, "Stripe") == -1) return -1;
+    }
+    return 0;
+}
+
+static int job_run(void* arg)
+{
+    stripe_job* job = (stripe_job*)arg;
+    int ret = job->send ? send_share(job) : recv_share(job);
+    // the failed call closed the socket, only this job touches its slot
+    if (ret == -1) job->stripe->sockets[job->index] = INV_SOCKET;
+    return ret;
+}
+
+static net_stripe* stripe_alloc(void)
+{
+    net_stripe* stripe = (net_stripe*)calloc(1, sizeof(net_stripe));
+    if (!stripe) {
+        fprintf(stderr, "ERROR: Out of memory!\n");
+        return NULL;
+    }
+    for (int i = 0; i < NET_STRIPE_MAX; i++) stripe->sockets[i] = INV_SOCKET;
+    return stripe;
+}
+
+void TCP_stripe_close(net_stripe* stripe)
+{
+    if (!stripe) return;
+    for (int i = 0; i < NET_STRIPE_MAX; i++) {
+        if (stripe->sockets[i] != INV_SOCKET) TCP_close(stripe->sockets[i]);
+    }
+    free(stripe);
+}
+
+// Close the connections a failed transfer left behind, they are out of sync.
+static void stripe_fail(net_stripe* stripe)
+{
+    for (int i = 0; i < stripe->count; i++) {
+        if (stripe->sockets[i] != INV_SOCKET) TCP_close(stripe->sockets[i]);
+        stripe->sockets[i] = INV_SOCKET;
+    }
+    stripe->count = 0;
+}
+
+net_stripe* TCP_stripe_connect(const char* addr, const char* port, int count, const net_sockopts* opts)
+{
+    if (count <= 0 || count > NET_STRIPE_MAX) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return NULL;
+    }
+    struct addrinfo* server_info;
+    if (net_resolve(addr, port, &server_info) == -1) return NULL;
+    net_stripe* stripe = stripe_alloc();
+    if (!stripe) {
+        freeaddrinfo(server_info);
+        return NULL;
+    }
+
+    // tells this group's connections apart from other clients' at the server
+    uint64_t group = ((uint64_t)time(NULL) << 32) ^ ((uint64_t)net_next_seq() << 16) ^ (uint64_t)(uintptr_t)stripe;
+    for (int i = 0; i < count; i++) {
+        stripe->sockets[i] = net_connect_addrinfo(server_info, opts, false);
+        if (stripe->sockets[i] == INV_SOCKET) break;
+        stripe->count++;
+
+        char hello[NET_STRIPE_HELLO];
+        memset(hello, 0, sizeof(hello));
+        put_le64((unsigned char*)hello, group);
+        put_le16((unsigned char*)hello + 8, (uint16_t)i);
+        put_le16((unsigned char*)hello + 10, (uint16_t)count);
+        net_header header;
+        memset(&header, 0, sizeof(header));
+        header.type = NET_MSG_STRIPE_HELLO;
+        header.seq = net_next_seq();
+        header.length = NET_STRIPE_HELLO;
+        if (TCP_send_msg(stripe->sockets[i], &header, hello) == -1) {
+            stripe->sockets[i] = INV_SOCKET;
+            break;
+        }
+    }
+    freeaddrinfo(server_info);
+    if (stripe->count != count) {
+        TCP_stripe_close(stripe);
+        return NULL;
+    }
+    return stripe;
+}
+
+net_stripe* TCP_stripe_accept(socket_t listen_socket, const net_sockopts* opts)
+{
+    net_stripe* stripe = stripe_alloc();
+    if (!stripe) return NULL;
+
+    net_buffer hello;
+    net_buffer_init(&hello);
+    uint64_t group = 0;
+    int count = 0, joined = 0;
+    // connections of other groups (e.g. a concurrent client) are turned away
+    while (!count || joined < count) {
+        socket_t socket = TCP_accept3(listen_socket, opts, false);
+        if (socket == INV_SOCKET) break;
+        if (TCP_recv_buffer(socket, &hello) == -1) continue;
+
+        const unsigned char* p = (const unsigned char*)hello.data;
+        int index = hello.size == NET_STRIPE_HELLO ? get_le16(p + 8) : -1;
+        int n = hello.size == NET_STRIPE_HELLO ? get_le16(p + 10) : 0;
+        bool valid = hello.header.type == NET_MSG_STRIPE_HELLO && n > 0 && n <= NET_STRIPE_MAX && index < n;
+        if (valid && count) valid = get_le64(p) == group && n == count && stripe->sockets[index] == INV_SOCKET;
+        if (!valid) {
+            fprintf(stderr, "WARNING: Rejected connection outside the stripe group!\n");
+            TCP_close(socket);
+            continue;
+        }
+        if (!count) {
+            group = get_le64(p);
+            count = n;
+        }
+        stripe->sockets[index] = socket;
+        joined++;
+    }
+    net_buffer_free(&hello);
+    if (!count || joined != count) {
+        TCP_stripe_close(stripe);
+        return NULL;
+    }
+    stripe->count = count;
+    return stripe;
+}
+
+int TCP_stripe_count(const net_stripe* stripe)
+{
+    return stripe->count;
+}
+
+int64_t TCP_stripe_send(net_stripe* stripe, const char* data, uint64_t total_size, size_t chunk_size)
+{
+    if (!stripe || !stripe->count || (total_size && !data) || total_size > (uint64_t)(SIZE_MAX >> 1) ||
+        (chunk_size & ~(size_t)0x7fffffff)) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    if (!chunk_size) chunk_size = NET_STRIPE_CHUNK;
+
+    stripe_job jobs[NET_STRIPE_MAX];
+    memset(jobs, 0, sizeof(jobs));
+    for (int i = 0; i < stripe->count; i++) {
+        jobs[i].stripe = stripe;
+        jobs[i].index = i;
+        jobs[i].data = (char*)data;
+        jobs[i].total = total_size;
+        jobs[i].chunk_size = chunk_size;
+        jobs[i].send = true;
+    }
+    if (net_run_jobs(jobs, sizeof(stripe_job), stripe->count, job_run, false) == -1) {
+        stripe_fail(stripe);
+        return -1;
+    }
+    return (int64_t)total_size;
+}
+
+int64_t TCP_stripe_recv(net_stripe* stripe, net_buffer* buf)
+{
+    if (!stripe || !stripe->count || !buf) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    buf->size = 0;
+
+    // every connection states the transfer up front, check they agree
+    stripe_job jobs[NET_STRIPE_MAX];
+    memset(jobs, 0, sizeof(jobs));
+    for (int i = 0; i < stripe->count; i++) {
+        net_header header;
+        unsigned char prefix[NET_STRIPE_PREFIX] = { 0 };
+        if (recv_header(stripe->sockets[i], &header) == -1 ||
+            (header.length >= NET_STRIPE_PREFIX &&
+                recv_data(stripe->sockets[i], (char*)prefix, NET_STRIPE_PREFIX, "Stripe") == -1)) {
+            stripe->sockets[i] = INV_SOCKET;
+            stripe_fail(stripe);
+            return -1;
+        }
+        jobs[i].stripe = stripe;
+        jobs[i].index = i;
+        jobs[i].total = get_le64(prefix);
+        jobs[i].chunk_size = get_le32(prefix + 8);
+        bool valid = header.type == NET_MSG_STRIPE && header.length >= NET_STRIPE_PREFIX &&
+            get_le16(prefix + 12) == i && get_le16(prefix + 14) == stripe->count && jobs[i].chunk_size &&
+            jobs[i].total == jobs[0].total && jobs[i].chunk_size == jobs[0].chunk_size &&
+            jobs[i].total <= (uint64_t)(SIZE_MAX >> 1) &&
+            header.length - NET_STRIPE_PREFIX == stripe_share(jobs[i].total, jobs[i].chunk_size, i, stripe->count);
+        if (!valid) {
+            fprintf(stderr, "ERROR: Unexpected stripe message!\n");
+            stripe_fail(stripe);
+            return -1;
+        }
+    }
+    if (!net_buffer_reserve(buf, (size_t)jobs[0].total)) {
+        fprintf(stderr, "ERROR: Out of memory!\n");
+        stripe_fail(stripe);
+        return -1;
+    }
+    for (int i = 0; i < stripe->count; i++) jobs[i].data = buf->data;
+
+    if (net_run_jobs(jobs, sizeof(stripe_job), stripe->count, job_run, false) == -1) {
+        stripe_fail(stripe);
+        return -1;
+    }
+    memset(&buf->header, 0, sizeof(buf->header));
+    buf->header.type = NET_MSG_STRIPE;
+    buf->header.length = jobs[0].total;
+    buf->size = (size_t)jobs[0].total;
+    return (int64_t)buf->size;
+}
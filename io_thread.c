@@ -0,0 +1,83 @@
+//
+// Worker threads for jobs that split one call across cores or connections
+// (PNG row bands, striped transfers).
+//
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <pthread.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+typedef struct net_worker {
+    net_job_fn fn;
+    void* job;
+    int result;
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+} net_worker;
+
+#ifdef _WIN32
+static DWORD WINAPI worker_main(LPVOID arg)
+#else
+static void* worker_main(void* arg)
+#endif
+{
+    net_worker* worker = (net_worker*)arg;
+    worker->result = worker->fn(worker->job);
+    // jobs may have sent on this thread's io_uring ring
+    TCP_thread_cleanup();
+    return 0;
+}
+
+int net_run_jobs(void* jobs, size_t job_size, int count, net_job_fn fn, bool run_unstarted)
+{
+    char* base = (char*)jobs;
+    net_worker* workers = count > 1 ? (net_worker*)calloc(count, sizeof(net_worker)) : NULL;
+    int started = 1;
+    if (workers) {
+        for (; started < count; started++) {
+            net_worker* worker = workers + started;
+            worker->fn = fn;
+            worker->job = base + started * job_size;
+#ifdef _WIN32
+            worker->thread = CreateThread(NULL, 0, worker_main, worker, 0, NULL);
+            if (!worker->thread) break;
+#else
+            if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) break;
+#endif
+        }
+    }
+
+    int ret = -1;
+    if (started == count || run_unstarted) {
+        ret = fn(base);
+        // whatever did not start runs here
+        for (int i = started; i < count; i++) {
+            if (fn(base + i * job_size) == -1) ret = -1;
+        }
+    }
+    else fprintf(stderr, "ERROR: Starting worker thread failed!\n");
+
+    for (int i = 1; i < started; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(workers[i].thread, INFINITE);
+        CloseHandle(workers[i].thread);
+#else
+        pthread_join(workers[i].thread, NULL);
+#endif
+        if (workers[i].result == -1) ret = -1;
+    }
+    free(workers);
+    return ret;
+}
@@ -0,0 +1,220 @@
+//
+// Progressive tile-ordered frame transmission.
+// A frame goes out as one NET_MSG_TILE message per tile, so the receiver
+// can show each tile as it lands instead of waiting for the whole frame.
+//
+// Tile payload: 24-byte little-endian tile header
+//   frame_width(2) frame_height(2) x(2) y(2) width(2) height(2)
+//   channels(1) order(1) reserved(2) index(4) count(4)
+// followed by the tile's pixel rows, packed.
+//
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <winsock2.h>
+#else
+    #include <unistd.h>
+    #include <sys/socket.h>
+    #include <errno.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+#define NET_TILE_HEADER 24
+
+typedef struct tile_key {
+    uint64_t key;
+    uint32_t tx, ty;
+} tile_key;
+
+static int compare_key(const void* a, const void* b)
+{
+    const tile_key* x = (const tile_key*)a;
+    const tile_key* y = (const tile_key*)b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    // ties in row-major order
+    if (x->ty != y->ty) return x->ty < y->ty ? -1 : 1;
+    return (x->tx > y->tx) - (x->tx < y->tx);
+}
+
+// Spread the low 16 bits of v to the even bits.
+static uint32_t morton_spread(uint32_t v)
+{
+    v &= 0xffff;
+    v = (v | (v << 8)) & 0x00ff00ff;
+    v = (v | (v << 4)) & 0x0f0f0f0f;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+// Tiles of a cols x rows grid in sending order.
+static void tile_order(tile_key* keys, uint32_t cols, uint32_t rows, int order)
+{
+    uint32_t n = 0;
+    for (uint32_t ty = 0; ty < rows; ty++) {
+        for (uint32_t tx = 0; tx < cols; tx++, n++) {
+            tile_key* k = keys + n;
+            k->tx = tx;
+            k->ty = ty;
+            if (order == NET_TILES_CENTER_OUT) {
+                // squared distance of tile centres from the frame centre, in half tiles
+                int64_t dx = 2 * (int64_t)tx + 1 - (int64_t)cols;
+                int64_t dy = 2 * (int64_t)ty + 1 - (int64_t)rows;
+                k->key = (uint64_t)(dx * dx + dy * dy);
+            }
+            else if (order == NET_TILES_MORTON) {
+                k->key = morton_spread(tx) | ((uint64_t)morton_spread(ty) << 1);
+            }
+            else k->key = n;
+        }
+    }
+    if (order != NET_TILES_ROW_MAJOR) qsort(keys, n, sizeof(tile_key), compare_key);
+}
+
+int64_t TCP_send_tiles(socket_t socket, const char* frame, int width, int height, int channels, int tile_size, int order)
+{
+    if (!frame || width <= 0 || height <= 0 || width > 0xffff || height > 0xffff || channels <= 0 ||
+        channels > 4 || tile_size <= 0 || order < NET_TILES_ROW_MAJOR || order > NET_TILES_MORTON) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    tile_size = MIN(tile_size, MAX(width, height));
+    uint32_t cols = (uint32_t)(width + tile_size - 1) / tile_size;
+    uint32_t rows = (uint32_t)(height + tile_size - 1) / tile_size;
+    size_t row_bytes = (size_t)width * channels;
+
+    tile_key* keys = (tile_key*)malloc(cols * rows * sizeof(tile_key));
+    char* payload = (char*)malloc(NET_TILE_HEADER + (size_t)tile_size * tile_size * channels);
+    if (!keys || !payload) {
+        fprintf(stderr, "ERROR: Out of memory!\n");
+        free(keys);
+        free(payload);
+        return -1;
+    }
+    tile_order(keys, cols, rows, order);
+
+    net_header header;
+    memset(&header, 0, sizeof(header));
+    header.type = NET_MSG_TILE;
+    for (uint32_t i = 0; i < cols * rows; i++) {
+        uint32_t x = keys[i].tx * tile_size, y = keys[i].ty * tile_size;
+        uint32_t w = MIN((uint32_t)tile_size, (uint32_t)width - x);
+        uint32_t h = MIN((uint32_t)tile_size, (uint32_t)height - y);
+
+        unsigned char* p = (unsigned char*)payload;
+        put_le16(p, (uint16_t)width);
+        put_le16(p + 2, (uint16_t)height);
+        put_le16(p + 4, (uint16_t)x);
+        put_le16(p + 6, (uint16_t)y);
+        put_le16(p + 8, (uint16_t)w);
+        put_le16(p + 10, (uint16_t)h);
+        p[12] = (unsigned char)channels;
+        p[13] = (unsigned char)order;
+        put_le16(p + 14, 0);
+        put_le32(p + 16, i);
+        put_le32(p + 20, cols * rows);
+
+        // pack the tile's rows behind its header
+        size_t tile_row = (size_t)w * channels;
+        const char* src = frame + y * row_bytes + (size_t)x * channels;
+        char* dst = payload + NET_TILE_HEADER;
+        for (uint32_t r = 0; r < h; r++, src += row_bytes, dst += tile_row) memcpy(dst, src, tile_row);
+
+        header.seq = net_next_seq();
+        header.length = NET_TILE_HEADER + tile_row * h;
+        if (TCP_send_msg(socket, &header, payload) == -1) {
+            free(keys);
+            free(payload);
+            return -1;
+        }
+    }
+    free(keys);
+    free(payload);
+    return (int64_t)row_bytes * height;
+}
+
+int64_t TCP_recv_tiles(socket_t socket, net_buffer* frame, net_tile_fn on_tile, void* user)
+{
+    if (!frame) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    frame->size = 0;
+
+    net_buffer buf;
+    net_buffer_init(&buf);
+    net_tile tile;
+    memset(&tile, 0, sizeof(tile));
+    uint32_t received = 0;
+    do {
+        if (TCP_recv_buffer(socket, &buf) == -1) {
+            net_buffer_free(&buf);
+            return -1;
+        }
+        const unsigned char* p = (const unsigned char*)buf.data;
+        bool valid = buf.header.type == NET_MSG_TILE && buf.size >= NET_TILE_HEADER;
+        if (valid) {
+            net_tile t;
+            t.frame_width = get_le16(p);
+            t.frame_height = get_le16(p + 2);
+            t.x = get_le16(p + 4);
+            t.y = get_le16(p + 6);
+            t.width = get_le16(p + 8);
+            t.height = get_le16(p + 10);
+            t.channels = p[12];
+            t.index = get_le32(p + 16);
+            t.count = get_le32(p + 20);
+            // every tile of a frame states the same frame, in order, inside it
+            valid = t.frame_width && t.frame_height && t.channels && t.channels <= 4 && t.count &&
+                t.index == received && t.index < t.count &&
+                (t.x + t.width <= t.frame_width) && (t.y + t.height <= t.frame_height) &&
+                buf.size == NET_TILE_HEADER + (size_t)t.width * t.height * t.channels &&
+                (!received || (t.frame_width == tile.frame_width && t.frame_height == tile.frame_height &&
+                    t.channels == tile.channels && t.count == tile.count));
+            tile = t;
+        }
+        if (!valid) {
+            fprintf(stderr, "ERROR: Unexpected tile message!\n");
+            net_buffer_free(&buf);
+            TCP_close(socket);
+            return -1;
+        }
+
+        size_t row_bytes = (size_t)tile.frame_width * tile.channels;
+        if (!received) {
+            if (!net_buffer_reserve(frame, row_bytes * tile.frame_height)) {
+                fprintf(stderr, "ERROR: Out of memory!\n");
+                net_buffer_free(&buf);
+                TCP_close(socket);
+                return -1;
+            }
+            frame->header = buf.header;
+        }
+
+        size_t tile_row = (size_t)tile.width * tile.channels;
+        const char* src = buf.data + NET_TILE_HEADER;
+        char* dst = frame->data + tile.y * row_bytes + (size_t)tile.x * tile.channels;
+        for (unsigned r = 0; r < tile.height; r++, src += tile_row, dst += row_bytes) memcpy(dst, src, tile_row);
+        received++;
+
+        if (on_tile && on_tile(user, &tile, frame->data) != 0) {
+            // rest of the frame is still queued, the stream is unusable
+            fprintf(stderr, "ERROR: Tile callback aborted receive!\n");
+            net_buffer_free(&buf);
+            TCP_close(socket);
+            return -1;
+        }
+    } while (received < tile.count);
+
+    net_buffer_free(&buf);
+    frame->size = (size_t)tile.frame_width * tile.frame_height * tile.channels;
+    frame->header.length = frame->size;
+    return (int64_t)frame->size;
+}
@@ -0,0 +1,247 @@
+//
+// End-to-end latency tracing.
+// A traced message carries the sender's capture, encode and send stamps
+// after its payload; the receiver adds arrival, completion and consumption
+// stamps and keeps the last NET_TRACE_LOG of them per socket.
+// TCP_clock_sync() measures the offset between the two monotonic clocks,
+// NTP style, so stamps from both ends line up.
+//
+// Trace trailer: capture(8) encode(8) send_start(8) send_end(8), little-endian.
+// Clock payload: stage(8) a(8) b(8) c(8), little-endian.
+//   probe  a = send time
+//   reply  a = probe send time, b = probe receive time, c = reply send time
+//   result a = offset (answering clock minus probing clock), b = round trip
+//
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <winsock2.h>
+#else
+    #include <unistd.h>
+    #include <sys/socket.h>
+    #include <errno.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+#define CLOCK_PROBE 0
+#define CLOCK_REPLY 1
+#define CLOCK_RESULT 2
+#define CLOCK_SIZE 32
+
+struct net_trace_log {
+    bool synced;
+    int64_t offset;   // peer clock - local clock
+    uint32_t count;   // traced messages received
+    net_trace records[NET_TRACE_LOG];
+};
+
+static net_trace_log* trace_log(socket_t socket, bool create)
+{
+    net_trace_log** log = net_stats_trace(socket, create);
+    if (!log) return NULL;
+    if (!*log && create) *log = (net_trace_log*)calloc(1, sizeof(net_trace_log));
+    return *log;
+}
+
+uint64_t TCP_clock_ns(void)
+{
+    return net_now_ns();
+}
+
+static int clock_send(socket_t socket, uint64_t stage, uint64_t a, uint64_t b, uint64_t c)
+{
+    unsigned char payload[CLOCK_SIZE];
+    put_le64(payload, stage);
+    put_le64(payload + 8, a);
+    put_le64(payload + 16, b);
+    put_le64(payload + 24, c);
+    net_header header;
+    memset(&header, 0, sizeof(header));
+    header.type = NET_MSG_CLOCK;
+    header.seq = net_next_seq();
+    // never compressed, so the stamps stay close to the syscall
+    net_iovec iov = { payload, CLOCK_SIZE };
+    return TCP_sendv_msg(socket, &header, &iov, 1) == -1 ? -1 : 0;
+}
+
+// Receive a clock message of the expected stage.
+// returns 0, -1 for error (with socket cleanup)
+static int clock_recv(socket_t socket, uint64_t* fields, uint64_t stage)
+{
+    net_header header;
+    unsigned char payload[CLOCK_SIZE];
+    if (recv_header(socket, &header) == -1) return -1;
+    if (header.type != NET_MSG_CLOCK || header.flags || header.length != CLOCK_SIZE) {
+        fprintf(stderr, "ERROR: Unexpected message during clock sync!\n");
+        TCP_close(socket);
+        return -1;
+    }
+    if (recv_data(socket, (char*)payload, CLOCK_SIZE, "Clock") == -1) return -1;
+    for (int i = 0; i < 4; i++) fields[i] = get_le64(payload + 8 * i);
+    if (fields[0] != stage && !(stage == CLOCK_PROBE && fields[0] == CLOCK_RESULT)) {
+        fprintf(stderr, "ERROR: Unexpected message during clock sync!\n");
+        TCP_close(socket);
+        return -1;
+    }
+    return 0;
+}
+
+int TCP_clock_sync(socket_t socket, int rounds, int64_t* offset_ns)
+{
+    if (rounds < 0) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    net_trace_log* log = trace_log(socket, true);
+    if (!log) {
+        fprintf(stderr, "ERROR: No trace log for socket!\n");
+        return -1;
+    }
+
+    uint64_t f[4];
+    int64_t offset = 0;
+    if (rounds == 0) {
+        // answer probes until the result
+        while (true) {
+            if (clock_recv(socket, f, CLOCK_PROBE) == -1) return -1;
+            uint64_t received = net_now_ns();
+            if (f[0] == CLOCK_RESULT) {
+                offset = -(int64_t)f[1];
+                break;
+            }
+            if (clock_send(socket, CLOCK_REPLY, f[1], received, net_now_ns()) == -1) return -1;
+        }
+    }
+    else {
+        // the sample with the lowest round trip has the least asymmetry
+        int64_t best = INT64_MAX;
+        for (int i = 0; i < rounds; i++) {
+            uint64_t t0 = net_now_ns();
+            if (clock_send(socket, CLOCK_PROBE, t0, 0, 0) == -1) return -1;
+            if (clock_recv(socket, f, CLOCK_REPLY) == -1) return -1;
+            uint64_t t3 = net_now_ns();
+            if (f[1] != t0) {
+                fprintf(stderr, "ERROR: Unexpected message during clock sync!\n");
+                TCP_close(socket);
+                return -1;
+            }
+            int64_t rtt = (int64_t)(t3 - t0) - (int64_t)(f[3] - f[2]);
+            if (rtt < best) {
+                best = rtt;
+                offset = ((int64_t)(f[2] - t0) + (int64_t)(f[3] - t3)) / 2;
+            }
+        }
+        if (clock_send(socket, CLOCK_RESULT, (uint64_t)offset, (uint64_t)best, 0) == -1) return -1;
+    }
+    log->offset = offset;
+    log->synced = true;
+    if (offset_ns) *offset_ns = offset;
+    return 0;
+}
+
+int TCP_send_traced(socket_t socket, const net_header* header, const char* data, uint64_t capture_ns, uint64_t encode_ns)
+{
+    if (!header || (header->length & ~(uint64_t)0x7fffffff) || (header->length && !data)) {
+        fprintf(stderr, "ERROR: Invalid input!\n");
+        return -1;
+    }
+    uint64_t send_start = net_now_ns();
+    net_header h = *header;
+    h.flags |= NET_FLAG_TRACED;
+    // one write, a separate trailer segment would wait out the peer's delayed ACK
+    unsigned char trailer[NET_TRACE_SIZE];
+    put_le64(trailer, capture_ns ? capture_ns : send_start);
+    put_le64(trailer + 8, encode_ns ? encode_ns : send_start);
+    put_le64(trailer + 16, send_start);
+    return net_send_msg(socket, &h, data, trailer);
+}
+
+int net_trace_recv(socket_t socket, const net_header* header, uint64_t arrival_ns)
+{
+    unsigned char trailer[NET_TRACE_SIZE];
+    if (recv_data(socket, (char*)trailer, NET_TRACE_SIZE, "Trace") == -1) return -1;
+    net_trace_record(socket, header, trailer, arrival_ns, net_now_ns());
+    return 0;
+}
+
+void net_trace_record(socket_t socket, const net_header* header, const unsigned char* trailer, uint64_t arrival_ns,
+    uint64_t received_ns)
+{
+    net_trace_log* log = trace_log(socket, true);
+    if (!log) return;
+    net_trace* trace = &log->records[log->count++ % NET_TRACE_LOG];
+    memset(trace, 0, sizeof(*trace));
+    trace->seq = header->seq;
+    trace->type = header->type;
+    trace->synced = log->synced;
+    trace->length = header->length;
+    // local = peer - offset
+    int64_t shift = log->synced ? log->offset : 0;
+    trace->capture = (int64_t)get_le64(trailer) - shift;
+    trace->encode = (int64_t)get_le64(trailer + 8) - shift;
+    trace->send_start = (int64_t)get_le64(trailer + 16) - shift;
+    trace->send_end = (int64_t)get_le64(trailer + 24) - shift;
+    trace->arrival = (int64_t)arrival_ns;
+    trace->received = (int64_t)received_ns;
+}
+
+// Record of seq, newest first, NULL if not logged.
+static net_trace* trace_find(socket_t socket, uint32_t seq)
+{
+    net_trace_log* log = trace_log(socket, false);
+    if (!log) return NULL;
+    uint32_t have = MIN(log->count, (uint32_t)NET_TRACE_LOG);
+    for (uint32_t i = 1; i <= have; i++) {
+        net_trace* trace = &log->records[(log->count - i) % NET_TRACE_LOG];
+        if (trace->seq == seq) return trace;
+    }
+    return NULL;
+}
+
+int TCP_trace_get(socket_t socket, uint32_t seq, net_trace* trace)
+{
+    const net_trace* found = trace_find(socket, seq);
+    if (!found || !trace) return -1;
+    *trace = *found;
+    return 0;
+}
+
+int TCP_trace_last(socket_t socket, net_trace* trace)
+{
+    net_trace_log* log = trace_log(socket, false);
+    if (!log || !log->count || !trace) return -1;
+    *trace = log->records[(log->count - 1) % NET_TRACE_LOG];
+    return 0;
+}
+
+int TCP_trace_consume(socket_t socket, uint32_t seq)
+{
+    net_trace* trace = trace_find(socket, seq);
+    if (!trace) return -1;
+    trace->consumed = (int64_t)net_now_ns();
+    return 0;
+}
+
+// Time from a to b, -1 if either is unknown.
+static int64_t stage(int64_t a, int64_t b, bool known)
+{
+    return known ? MAX(b - a, 0) : -1;
+}
+
+void TCP_trace_breakdown(const net_trace* trace, net_latency* latency)
+{
+    bool consumed = trace->consumed != 0;
+    latency->encode = stage(trace->capture, trace->encode, true);
+    latency->queue = stage(trace->encode, trace->send_start, true);
+    latency->send = stage(trace->send_start, trace->send_end, true);
+    latency->network = stage(trace->send_end, trace->received, trace->synced);
+    latency->consume = stage(trace->received, trace->consumed, consumed);
+    latency->total = stage(trace->capture, trace->consumed, trace->synced && consumed);
+}
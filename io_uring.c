@@ -0,0 +1,497 @@
+//
+// io_uring transport backend (Linux).
+// Raw syscalls, no liburing dependency. Each thread lazily gets its own ring
+// for the blocking TCP_* calls; TCP_server creates a separate ring.
+//
+
+#ifdef NET_HAVE_URING
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1
+#endif
+
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <errno.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+#include "io_internal.h"
+
+#define NET_URING_ENTRIES 64 // per-thread ring for blocking calls
+
+struct net_uring {
+    int fd;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    unsigned sq_entries;
+    unsigned sq_pending; // prepared but not yet submitted
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+
+    void* sq_ptr;
+    size_t sq_size;
+    void* cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+
+    // registered buffers, for matching READ/WRITE_FIXED
+    net_iovec fixed[NET_URING_MAXFIXED];
+    int fixed_count;
+};
+
+static int uring_setup(unsigned entries, struct io_uring_params* p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+net_uring* net_uring_create(unsigned entries)
+{
+    net_uring* ring = (net_uring*)calloc(1, sizeof(net_uring));
+    if (!ring) return NULL;
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ring->fd = uring_setup(entries, &p);
+    if (ring->fd < 0) {
+        free(ring);
+        return NULL;
+    }
+
+    ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) ring->sq_size = ring->cq_size = MAX(ring->sq_size, ring->cq_size);
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) goto fail_sq;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) ring->cq_ptr = ring->sq_ptr;
+    else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) goto fail_cq;
+    }
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) goto fail_sqes;
+
+    char* sq = (char*)ring->sq_ptr;
+    ring->sq_head = (unsigned*)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + p.sq_off.array);
+    ring->sq_entries = p.sq_entries;
+    char* cq = (char*)ring->cq_ptr;
+    ring->cq_head = (unsigned*)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return ring;
+
+fail_sqes:
+    if (ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+fail_cq:
+    munmap(ring->sq_ptr, ring->sq_size);
+fail_sq:
+    close(ring->fd);
+    free(ring);
+    return NULL;
+}
+
+void net_uring_destroy(net_uring* ring)
+{
+    if (!ring) return;
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+    munmap(ring->sq_ptr, ring->sq_size);
+    close(ring->fd);
+    free(ring);
+}
+
+int net_uring_fd(const net_uring* ring)
+{
+    return ring->fd;
+}
+
+struct io_uring_sqe* net_uring_sqe(net_uring* ring)
+{
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *ring->sq_tail + ring->sq_pending;
+    if (tail - head >= ring->sq_entries) {
+        // full: hand the batch to the kernel first
+        if (net_uring_submit(ring, 0) < 0) return NULL;
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        tail = *ring->sq_tail;
+        if (tail - head >= ring->sq_entries) return NULL;
+    }
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    ring->sq_pending++;
+    return sqe;
+}
+
+int net_uring_submit(net_uring* ring, unsigned wait_nr)
+{
+    unsigned to_submit = ring->sq_pending;
+    if (to_submit) {
+        __atomic_store_n(ring->sq_tail, *ring->sq_tail + to_submit, __ATOMIC_RELEASE);
+        ring->sq_pending = 0;
+    }
+    if (!to_submit && !wait_nr) return 0;
+
+    // submit and wait in one syscall
+    while (true) {
+        net_count_syscall(NULL);
+        int ret = uring_enter(ring->fd, to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+        if (ret >= 0) return ret;
+        if (errno != EINTR) return -1;
+    }
+}
+
+bool net_uring_peek(net_uring* ring, uint64_t* user_data, int32_t* res, uint32_t* flags)
+{
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) return false;
+    struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+    *user_data = cqe->user_data;
+    *res = cqe->res;
+    *flags = cqe->flags;
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+int net_uring_register_bufring(net_uring* ring, void* mem, unsigned entries, unsigned group)
+{
+#ifdef IORING_RECV_MULTISHOT
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)mem;
+    reg.ring_entries = entries;
+    reg.bgid = (uint16_t)group;
+    return uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) == 0 ? 0 : -1;
+#else
+    (void)ring; (void)mem; (void)entries; (void)group;
+    return -1;
+#endif
+}
+
+
+// Blocking TCP_* backend, one ring per thread.
+
+static int net_backend = NET_BACKEND_SOCKETS;
+static __thread net_uring* thread_ring;
+static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+
+// A forked child shares the parent's ring memory, give it a fresh one.
+static void atfork_child(void)
+{
+    thread_ring = NULL;
+}
+
+static void register_atfork(void)
+{
+    pthread_atfork(NULL, NULL, atfork_child);
+}
+
+net_uring* net_uring_thread(void)
+{
+    if (!thread_ring) {
+        pthread_once(&atfork_once, register_atfork);
+        thread_ring = net_uring_create(NET_URING_ENTRIES);
+    }
+    return thread_ring;
+}
+
+bool net_uring_active(void)
+{
+    return net_backend == NET_BACKEND_URING && net_uring_thread();
+}
+
+bool TCP_set_backend(int backend)
+{
+    if (backend == NET_BACKEND_URING) {
+        if (!net_uring_thread()) {
+            fprintf(stderr, "WARNING: io_uring unavailable, using socket backend!\n");
+            net_backend = NET_BACKEND_SOCKETS;
+            return false;
+        }
+        net_backend = NET_BACKEND_URING;
+        return true;
+    }
+    net_backend = NET_BACKEND_SOCKETS;
+    TCP_thread_cleanup();
+    return backend == NET_BACKEND_SOCKETS;
+}
+
+int TCP_get_backend(void)
+{
+    return net_backend;
+}
+
+void TCP_thread_cleanup(void)
+{
+    net_uring_destroy(thread_ring);
+    thread_ring = NULL;
+}
+
+bool TCP_register_buffers(const net_iovec* bufs, int count)
+{
+    net_uring* ring = net_uring_thread();
+    if (!ring || count <= 0 || count > NET_URING_MAXFIXED) return false;
+    if (ring->fixed_count) TCP_unregister_buffers();
+
+    struct iovec iov[NET_URING_MAXFIXED];
+    for (int i = 0; i < count; i++) {
+        iov[i].iov_base = (void*)bufs[i].base;
+        iov[i].iov_len = bufs[i].len;
+    }
+    if (uring_register(ring->fd, IORING_REGISTER_BUFFERS, iov, count) != 0) {
+        fprintf(stderr, "WARNING: io_uring buffer registration failed with err %d!\n", errno);
+        return false;
+    }
+    memcpy(ring->fixed, bufs, count * sizeof(net_iovec));
+    ring->fixed_count = count;
+    return true;
+}
+
+void TCP_unregister_buffers(void)
+{
+    net_uring* ring = thread_ring;
+    if (!ring || !ring->fixed_count) return;
+    uring_register(ring->fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+    ring->fixed_count = 0;
+}
+
+// Index of the registered buffer containing [data, data + len), -1 if none.
+static int fixed_index(net_uring* ring, const char* data, size_t len)
+{
+    for (int i = 0; i < ring->fixed_count; i++) {
+        const char* base = (const char*)ring->fixed[i].base;
+        if (data >= base && data + len <= base + ring->fixed[i].len) return i;
+    }
+    return -1;
+}
+
+// SO_RCVTIMEO / SO_SNDTIMEO of socket into ts, false if none is set.
+// Ring ops ignore both, so they get a linked timeout instead.
+static bool socket_timeout(socket_t socket, int name, struct __kernel_timespec* ts)
+{
+    struct timeval timer = { 0, 0 };
+    socklen_t len = sizeof(timer);
+    if (getsockopt(socket, SOL_SOCKET, name, &timer, &len) == -1 || (!timer.tv_sec && !timer.tv_usec)) return false;
+    ts->tv_sec = timer.tv_sec;
+    ts->tv_nsec = (long long)timer.tv_usec * 1000;
+    return true;
+}
+
+// Next sqe for a blocking op, followed by a linked timeout of ts (optional).
+// ts must stay valid until submit_wait(). NULL if the ring is full.
+static struct io_uring_sqe* prepare_op(net_uring* ring, const struct __kernel_timespec* ts)
+{
+    // both entries have to reach the kernel in one batch
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (*ring->sq_tail + ring->sq_pending + (ts ? 2 : 1) - head > ring->sq_entries) return NULL;
+    struct io_uring_sqe* sqe = net_uring_sqe(ring);
+    if (!sqe || !ts) return sqe;
+    sqe->flags |= IOSQE_IO_LINK;
+    struct io_uring_sqe* timeout = net_uring_sqe(ring);
+    timeout->opcode = IORING_OP_LINK_TIMEOUT;
+    timeout->fd = -1;
+    timeout->addr = (uint64_t)(uintptr_t)ts;
+    timeout->len = 1;
+    timeout->user_data = 1;
+    return sqe;
+}
+
+// Submit the prepared op (and its timeout if linked) and wait for completion.
+// returns cqe result of the op (negative errno on failure, -EAGAIN on timeout)
+static int32_t submit_wait(net_uring* ring, net_stats* stats, bool linked)
+{
+    if (stats) net_stat_add(&stats->syscalls, 1);
+    unsigned want = linked ? 2 : 1;
+    if (net_uring_submit(ring, want) < 0) return -errno;
+    int32_t result = 0;
+    while (want) {
+        uint64_t user_data;
+        int32_t res;
+        uint32_t flags;
+        if (!net_uring_peek(ring, &user_data, &res, &flags)) {
+            if (net_uring_submit(ring, 1) < 0) return -errno;
+            continue;
+        }
+        want--;
+        if (user_data == 0) result = res;
+    }
+    // the timeout fired and cancelled the op, report it like a socket timeout
+    return linked && result == -ECANCELED ? -EAGAIN : result;
+}
+
+int64_t net_uring_sendv(socket_t socket, const net_iovec* iov, int iovcnt, int flags, const char* log_name)
+{
+    net_uring* ring = thread_ring;
+    net_stats* stats = net_stats_find(socket);
+    struct __kernel_timespec ts;
+    bool timed = socket_timeout(socket, SO_SNDTIMEO, &ts);
+    int64_t total_size = 0;
+    int index = 0;
+    size_t offset = 0;
+    while (true) {
+        while (index < iovcnt && offset == iov[index].len) {
+            index++;
+            offset = 0;
+        }
+        if (index == iovcnt) return total_size;
+
+        struct io_uring_sqe* sqe = prepare_op(ring, timed ? &ts : NULL);
+        if (!sqe) {
+            fprintf(stderr, "ERROR: %s message send failed, io_uring queue full\n", log_name);
+            TCP_close(socket);
+            return -1;
+        }
+        int fixed = iovcnt - index == 1 ? fixed_index(ring, (const char*)iov[index].base + offset, iov[index].len - offset) : -1;
+        struct iovec bufs[NET_URING_MAXIOV];
+        struct msghdr msg;
+        uint64_t asked = 0;
+        if (fixed >= 0) {
+            // registered frame buffer: pages already pinned
+            sqe->opcode = IORING_OP_WRITE_FIXED;
+            sqe->addr = (uint64_t)(uintptr_t)((const char*)iov[index].base + offset);
+            sqe->len = (uint32_t)MIN(iov[index].len - offset, (size_t)0x40000000);
+            sqe->buf_index = (uint16_t)fixed;
+            asked = sqe->len;
+        }
+        else {
+            // one SENDMSG op for all fragments, MSG_WAITALL lets the kernel retry short sends
+            memset(&msg, 0, sizeof(msg));
+            for (int i = index; i < iovcnt && msg.msg_iovlen < NET_URING_MAXIOV; i++) {
+                size_t skip = i == index ? offset : 0;
+                bufs[msg.msg_iovlen].iov_base = (char*)iov[i].base + skip;
+                bufs[msg.msg_iovlen].iov_len = iov[i].len - skip;
+                asked += bufs[msg.msg_iovlen].iov_len;
+                msg.msg_iovlen++;
+            }
+            msg.msg_iov = bufs;
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->addr = (uint64_t)(uintptr_t)&msg;
+            sqe->msg_flags = (uint32_t)(flags | MSG_WAITALL);
+        }
+        sqe->fd = socket;
+
+        int32_t send_byte = submit_wait(ring, stats, timed);
+        if (send_byte < 0) {
+            fprintf(stderr, "ERROR: %s message send failed with err %d\n", log_name, -send_byte);
+            TCP_close(socket);
+            return -1;
+        }
+        net_count_bytes(stats, false, send_byte, asked);
+        total_size += send_byte;
+        while (send_byte > 0) {
+            size_t step = (size_t)MIN((int64_t)(iov[index].len - offset), (int64_t)send_byte);
+            offset += step;
+            send_byte -= (int32_t)step;
+            if (offset == iov[index].len) {
+                index++;
+                offset = 0;
+            }
+        }
+    }
+}
+
+int64_t net_uring_recv(socket_t socket, char* data, uint64_t total_size, const char* log_name)
+{
+    net_uring* ring = thread_ring;
+    int fixed = fixed_index(ring, data, (size_t)total_size);
+    net_stats* stats = net_stats_find(socket);
+    struct __kernel_timespec ts;
+    bool timed = socket_timeout(socket, SO_RCVTIMEO, &ts);
+    uint64_t recv_left = total_size;
+    while (recv_left) {
+        struct io_uring_sqe* sqe = prepare_op(ring, timed ? &ts : NULL);
+        if (!sqe) {
+            fprintf(stderr, "ERROR: %s message receive failed, io_uring queue full\n", log_name);
+            TCP_close(socket);
+            return -1;
+        }
+        sqe->fd = socket;
+        sqe->addr = (uint64_t)(uintptr_t)(data + total_size - recv_left);
+        sqe->len = (uint32_t)MIN(recv_left, (uint64_t)0x40000000);
+        if (fixed >= 0) {
+            sqe->opcode = IORING_OP_READ_FIXED;
+            sqe->buf_index = (uint16_t)fixed;
+        }
+        else {
+            sqe->opcode = IORING_OP_RECV;
+            sqe->msg_flags = MSG_WAITALL;
+        }
+
+        int32_t recv_byte = submit_wait(ring, stats, timed);
+        if (recv_byte <= 0) {
+            if (recv_byte == 0) fprintf(stderr, "ERROR: %s message receive failed, connection closed\n", log_name);
+            else fprintf(stderr, "ERROR: %s message receive failed with err %d\n", log_name, -recv_byte);
+            TCP_close(socket);
+            return -1;
+        }
+        net_count_bytes(stats, true, recv_byte, MIN(recv_left, (uint64_t)0x40000000));
+        recv_left -= recv_byte;
+    }
+    return (int64_t)total_size;
+}
+
+#else
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "io.h"
+
+bool TCP_set_backend(int backend)
+{
+    if (backend != NET_BACKEND_SOCKETS)
+        fprintf(stderr, "WARNING: io_uring unavailable, using socket backend!\n");
+    return backend == NET_BACKEND_SOCKETS;
+}
+
+int TCP_get_backend(void)
+{
+    return NET_BACKEND_SOCKETS;
+}
+
+void TCP_thread_cleanup(void)
+{
+}
+
+bool TCP_register_buffers(const net_iovec* bufs, int count)
+{
+    (void)bufs;
+    (void)count;
+    return false;
+}
+
+void TCP_unregister_buffers(void)
+{
+}
+
+#endif